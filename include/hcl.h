@@ -11,11 +11,13 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <hcl/clock/global_clock.h>
+#include <hcl/clock/hybrid_clock.h>
 #include <hcl/communication/rpc_lib.h>
 #include <hcl/unordered_map/unordered_map.h>
 #include <hcl/map/map.h>
 #include <hcl/multimap/multimap.h>
 #include <hcl/priority_queue/priority_queue.h>
 #include <hcl/queue/queue.h>
+#include <hcl/ring_queue/ring_queue.h>
 #include <hcl/sequencer/global_sequence.h>
 #include <hcl/set/set.h>
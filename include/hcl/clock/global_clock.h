@@ -22,20 +22,42 @@
 #include <hcl/common/singleton.h>
 #include <hcl/common/data_structures.h>
 #include <hcl/common/typedefs.h>
+#include <hcl/common/constants.h>
 #include <hcl/communication/rpc_lib.h>
 #include <hcl/common/debug.h>
 #include <hcl/communication/rpc_factory.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace bip = boost::interprocess;
 
 namespace hcl {
+/**
+ * Microsecond clock kept by the servers. Each server counts from its own
+ * construction, so GetTimeServer readings of different servers are not
+ * comparable; GetGlobalTime converts this process's clock to the timescale
+ * of server 0 instead, using offsets measured by SyncClocks.
+ */
 class global_clock {
+  public:
+    /* A server's clock relative to this process's steady clock. */
+    struct ClockOffset {
+        int64_t offset;       /* server time minus local time, in microseconds */
+        int64_t uncertainty;  /* bound on the error of offset, in microseconds */
+    };
+
   private:
     typedef std::chrono::high_resolution_clock::time_point chrono_time;
     chrono_time *start;
+    /* Copy of *start; it never changes after the server constructs it. */
+    chrono_time epoch;
     bool is_server;
     bip::interprocess_mutex* mutex;
     really_long memory_allocated;
@@ -44,8 +66,48 @@ class global_clock {
     bip::managed_mapped_file segment;
     std::string name, func_prefix;
     std::shared_ptr<RPC> rpc;
+    RPCProcedureCache rpc_procedures;
     bool server_on_node;
     CharStruct backed_file;
+    /* Offsets per server, written by SyncClocks; server 0's is also kept
+     * in reference_offset so GetGlobalTime reads it without a lock. */
+    std::mutex sync_mutex;
+    std::vector<ClockOffset> offsets;
+    std::atomic<int64_t> reference_offset;
+    std::atomic<bool> synced;
+    /* Resyncs every HCL_CONF->CLOCK_SYNC_INTERVAL_MS once started. */
+    std::condition_variable sync_wakeup;
+    bool stop_sync;
+    std::thread sync_thread;
+
+    static int64_t LocalNow() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * Cristian's algorithm: the server's reading is taken to be from the
+     * middle of the round trip, so its error is at most half the round trip.
+     * The probe with the shortest round trip wins.
+     */
+    ClockOffset MeasureOffset(uint16_t server, uint16_t probes) {
+        if (my_server == server && server_on_node) {
+            /* Both clocks are on this node; nothing travels. */
+            HTime server_time = LocalGetTime();
+            return ClockOffset{static_cast<int64_t>(server_time) - LocalNow(), 1};
+        }
+        ClockOffset best{0, -1};
+        for (uint16_t probe = 0; probe < probes; ++probe) {
+            int64_t sent = LocalNow();
+            HTime server_time = RPC_CALL_WRAPPER1("_GetTime", server, HTime);
+            int64_t received = LocalNow();
+            int64_t half_trip = (received - sent + 1) / 2;
+            if (best.uncertainty < 0 || half_trip < best.uncertainty) {
+                best = ClockOffset{static_cast<int64_t>(server_time) - (sent + half_trip), half_trip};
+            }
+        }
+        return best;
+    }
 
   public:
     /*
@@ -53,6 +115,12 @@ class global_clock {
      */
     ~global_clock() {
         AutoTrace trace = AutoTrace("hcl::~global_clock", NULL);
+        {
+            std::lock_guard<std::mutex> lock(sync_mutex);
+            stop_sync = true;
+        }
+        sync_wakeup.notify_all();
+        if (sync_thread.joinable()) sync_thread.join();
         if (is_server) bip::file_mapping::remove(backed_file.c_str());
     }
 
@@ -63,7 +131,9 @@ class global_clock {
               name(name_), segment(),
               func_prefix(name_),
               backed_file(HCL_CONF->BACKED_FILE_DIR + PATH_SEPARATOR + name_),
-              server_on_node(HCL_CONF->SERVER_ON_NODE) {
+              server_on_node(HCL_CONF->SERVER_ON_NODE),
+              sync_mutex(), offsets(), reference_offset(0), synced(false),
+              sync_wakeup(), stop_sync(false), sync_thread() {
         AutoTrace trace = AutoTrace("hcl::global_clock");
         MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
         MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
@@ -103,6 +173,7 @@ class global_clock {
                     std::chrono::high_resolution_clock::now());
             mutex = segment.construct<boost::interprocess::interprocess_mutex>(
                     "mtx")();
+            epoch = *start;
         }else if (!is_server && server_on_node) {
             segment = bip::managed_mapped_file(bip::open_only, backed_file.c_str());
             std::pair<chrono_time*, bip::managed_mapped_file::size_type> res;
@@ -112,6 +183,7 @@ class global_clock {
                     bip::managed_mapped_file::size_type> res2;
             res2 = segment.find<bip::interprocess_mutex>("mtx");
             mutex = res2.first;
+            epoch = *start;
         }
     }
     chrono_time * data(){
@@ -154,18 +226,77 @@ class global_clock {
 
     /*
      * GetTime() returns the time locally within a node using chrono
-     * high_resolution_clock
+     * high_resolution_clock. The start time is only written before clients
+     * attach, so the read takes no lock.
      */
     HTime LocalGetTime() {
         AutoTrace trace = AutoTrace("hcl::global_clock::GetTime", NULL);
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-                lock(*mutex);
         auto t2 = std::chrono::high_resolution_clock::now();
         auto t =  std::chrono::duration_cast<std::chrono::microseconds>(
-                t2 - *start).count();
+                t2 - epoch).count();
         return t;
     }
 
+    /**
+     * Measures the offset of every server's clock from this process's clock
+     * by probing its _GetTime. With HCL_CONF->CLOCK_SYNC_INTERVAL_MS set, the
+     * first call also starts a thread that repeats this at that interval, so
+     * the offsets follow the drift of the clocks.
+     * @param probes, round trips per server; the shortest is used
+     */
+    void SyncClocks(uint16_t probes = CLOCK_SYNC_PROBES) {
+        AutoTrace trace = AutoTrace("hcl::global_clock::SyncClocks", probes);
+        std::vector<ClockOffset> measured;
+        measured.reserve(num_servers);
+        for (uint16_t server = 0; server < num_servers; ++server) {
+            measured.push_back(MeasureOffset(server, probes));
+        }
+        std::lock_guard<std::mutex> lock(sync_mutex);
+        offsets.swap(measured);
+        reference_offset.store(offsets[0].offset, std::memory_order_relaxed);
+        synced.store(true, std::memory_order_release);
+        if (HCL_CONF->CLOCK_SYNC_INTERVAL_MS > 0 && !sync_thread.joinable() && !stop_sync) {
+            sync_thread = std::thread([this, probes]() {
+                std::unique_lock<std::mutex> lock(sync_mutex);
+                auto interval = std::chrono::milliseconds(HCL_CONF->CLOCK_SYNC_INTERVAL_MS);
+                while (!sync_wakeup.wait_for(lock, interval, [this]() { return stop_sync; })) {
+                    lock.unlock();
+                    SyncClocks(probes);
+                    lock.lock();
+                }
+            });
+        }
+    }
+
+    /*
+     * Synced() tells whether offsets were measured, that is whether
+     * GetGlobalTime can answer without an RPC
+     */
+    bool Synced() {
+        return synced.load(std::memory_order_acquire);
+    }
+
+    /*
+     * GetOffset() returns the last measured offset of server's clock, syncing
+     * first if no measurement was taken yet
+     */
+    ClockOffset GetOffset(uint16_t server) {
+        if (!synced.load(std::memory_order_acquire)) SyncClocks();
+        std::lock_guard<std::mutex> lock(sync_mutex);
+        return offsets[server];
+    }
+
+    /*
+     * GetGlobalTime() returns the time on server 0, in microseconds, estimated
+     * from this process's clock without an RPC. Readings of all processes are
+     * comparable to within their offsets' uncertainties; a resync may move
+     * the estimate by about that much.
+     */
+    HTime GetGlobalTime() {
+        if (!synced.load(std::memory_order_acquire)) SyncClocks();
+        return static_cast<HTime>(LocalNow() + reference_offset.load(std::memory_order_relaxed));
+    }
+
 #if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
     THALLIUM_DEFINE1(LocalGetTime)
 #endif
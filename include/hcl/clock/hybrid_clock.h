@@ -0,0 +1,120 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INCLUDE_HCL_CLOCK_HYBRID_CLOCK_H_
+#define INCLUDE_HCL_CLOCK_HYBRID_CLOCK_H_
+
+#include <boost/interprocess/managed_mapped_file.hpp>
+#include <hcl/clock/global_clock.h>
+#include <hcl/common/hlc.h>
+#include <hcl/common/singleton.h>
+#include <hcl/common/typedefs.h>
+#include <hcl/common/debug.h>
+#include <atomic>
+#include <string>
+
+namespace bip = boost::interprocess;
+
+namespace hcl {
+/**
+ * Hybrid logical clock: timestamps follow the global_clock time of server 0
+ * and still order causally related events whose readings are closer than
+ * the clocks' uncertainty. A server keeps its clock in shared memory, which
+ * co-located clients use too, so all processes of a node share one clock;
+ * a process without a server on its node keeps its own.
+ *
+ * Until SyncClocks is called the physical part reads 0 and the clock counts
+ * like a Lamport clock. The piggyback path never syncs by itself, so that a
+ * response is not held up by an RPC of its own.
+ */
+class hybrid_clock : public hlc_source {
+  private:
+    bool is_server;
+    uint16_t my_server;
+    bool server_on_node;
+    CharStruct backed_file;
+    bip::managed_mapped_file segment;
+    std::atomic<uint64_t> local_state;
+    global_clock physical_clock;
+    hlc clock;
+
+    std::atomic<uint64_t> *State() {
+        if (is_server) {
+            bip::file_mapping::remove(backed_file.c_str());
+            segment = bip::managed_mapped_file(bip::create_only, backed_file.c_str(), 65536);
+            return segment.construct<std::atomic<uint64_t>>("HLC")(0);
+        } else if (server_on_node) {
+            segment = bip::managed_mapped_file(bip::open_only, backed_file.c_str());
+            return segment.find<std::atomic<uint64_t>>("HLC").first;
+        }
+        return &local_state;
+    }
+
+    HTime Physical() {
+        return physical_clock.Synced() ? physical_clock.GetGlobalTime() : 0;
+    }
+
+  public:
+    /*
+     * Destructor stops piggybacking this clock and removes shared memory
+     * from the server
+     */
+    ~hybrid_clock() {
+        AutoTrace trace = AutoTrace("hcl::~hybrid_clock", NULL);
+        hlc_source *registered = this;
+        PiggybackClock().compare_exchange_strong(registered, nullptr);
+        if (is_server) bip::file_mapping::remove(backed_file.c_str());
+    }
+
+    hybrid_clock(std::string name_ = "TEST_HYBRID_CLOCK", uint16_t port = HCL_CONF->RPC_PORT)
+            : is_server(HCL_CONF->IS_SERVER), my_server(HCL_CONF->MY_SERVER),
+              server_on_node(HCL_CONF->SERVER_ON_NODE),
+              backed_file(HCL_CONF->BACKED_FILE_DIR + PATH_SEPARATOR + name_ + "_" +
+                          std::to_string(HCL_CONF->MY_SERVER)),
+              segment(), local_state(0), physical_clock(name_ + "_PHYSICAL", port),
+              clock(State()) {
+        AutoTrace trace = AutoTrace("hcl::hybrid_clock");
+        if (HCL_CONF->HLC_PIGGYBACK) PiggybackClock().store(this, std::memory_order_release);
+    }
+
+    /*
+     * Now() returns a timestamp later than every one this node's clock gave
+     * out or received before
+     */
+    HTime Now() override {
+        return clock.Tick(Physical());
+    }
+
+    /*
+     * Update() merges a timestamp received from another process and returns
+     * a timestamp later than both it and this clock
+     */
+    HTime Update(HTime remote) override {
+        return clock.Merge(remote, Physical());
+    }
+
+    /*
+     * SyncClocks() measures the offsets of the physical clock; see
+     * global_clock::SyncClocks
+     */
+    void SyncClocks(uint16_t probes = CLOCK_SYNC_PROBES) {
+        physical_clock.SyncClocks(probes);
+    }
+
+    global_clock &PhysicalClock() {
+        return physical_clock;
+    }
+};
+
+}  // namespace hcl
+
+#endif  // INCLUDE_HCL_CLOCK_HYBRID_CLOCK_H_
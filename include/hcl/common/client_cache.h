@@ -0,0 +1,211 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INCLUDE_HCL_COMMON_CLIENT_CACHE_H_
+#define INCLUDE_HCL_COMMON_CLIENT_CACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hcl {
+/**
+ * Read leases handed out by a server, kept in its segment so co-located
+ * writers honor them too. Leases are tracked per slot (a hash of the key),
+ * so a lease on one key may delay writers of another key in the same slot
+ * but is never missed. While a writer waits on a slot no new lease is
+ * granted on it, so writers wait at most one lease duration.
+ */
+struct lease_table {
+    static const size_t SLOTS = 4096;
+    uint64_t duration_ns;
+    std::atomic<uint64_t> latest_expiry;
+    std::atomic<uint64_t> expiry[SLOTS];
+    std::atomic<uint32_t> writers[SLOTS];
+
+    explicit lease_table(uint64_t duration_ns_) : duration_ns(duration_ns_), latest_expiry(0) {
+        for (size_t i = 0; i < SLOTS; ++i) {
+            expiry[i] = 0;
+            writers[i] = 0;
+        }
+    }
+
+    /* steady_clock counts from boot, so it agrees between processes on a node. */
+    static uint64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static size_t Slot(size_t key_hash) {
+        return (static_cast<uint64_t>(key_hash) * 0x9E3779B97F4A7C15ULL >> 40) % SLOTS;
+    }
+
+    /**
+     * Grants a lease on key_hash unless a writer is waiting for it.
+     * @return the lease duration in nanoseconds, 0 if none was granted
+     */
+    uint64_t Grant(size_t key_hash) {
+        size_t slot = Slot(key_hash);
+        if (writers[slot].load() > 0) return 0;
+        uint64_t until = Now() + duration_ns;
+        uint64_t current = expiry[slot].load();
+        while (current < until && !expiry[slot].compare_exchange_weak(current, until)) {}
+        current = latest_expiry.load();
+        while (current < until && !latest_expiry.compare_exchange_weak(current, until)) {}
+        return duration_ns;
+    }
+
+    bool Expired(size_t slot) const { return Now() >= expiry[slot].load(); }
+
+    static void SleepUntil(uint64_t deadline) {
+        uint64_t now = Now();
+        if (now < deadline) std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - now));
+    }
+
+    /* Waits until every lease granted so far has expired. */
+    void WaitAll() const {
+        uint64_t until;
+        while ((until = latest_expiry.load()) > Now()) SleepUntil(until);
+    }
+};
+
+/**
+ * Writer side of a lease_table: registers the keys about to be updated so
+ * no new leases are granted on them, and takes the data lock only once all
+ * leases on them have run out. A null table makes it a plain lock.
+ */
+class lease_writer {
+  private:
+    lease_table *table;
+    std::vector<size_t> slots;
+  public:
+    explicit lease_writer(lease_table *table_) : table(table_), slots() {}
+    lease_writer(lease_table *table_, size_t key_hash) : table(table_), slots() { Add(key_hash); }
+    lease_writer(const lease_writer &) = delete;
+    lease_writer &operator=(const lease_writer &) = delete;
+    ~lease_writer() {
+        for (size_t slot : slots) table->writers[slot]--;
+    }
+
+    void Add(size_t key_hash) {
+        if (table == nullptr) return;
+        size_t slot = lease_table::Slot(key_hash);
+        table->writers[slot]++;
+        slots.push_back(slot);
+    }
+
+    /**
+     * Locks lock (constructed deferred). Leases granted before the writers
+     * were registered are waited out with the lock released, then checked
+     * again once it is held.
+     */
+    template<typename LockType>
+    void Lock(LockType &lock) {
+        while (true) {
+            for (size_t slot : slots) {
+                while (!table->Expired(slot)) lease_table::SleepUntil(table->expiry[slot].load());
+            }
+            lock.lock();
+            bool clear = true;
+            for (size_t slot : slots) clear = clear && table->Expired(slot);
+            if (clear) return;
+            lock.unlock();
+        }
+    }
+};
+
+/** Counters returned by CacheStats(). */
+struct cache_stats {
+    uint64_t hits;    /* Gets answered from the cache */
+    uint64_t misses;  /* Gets that went to the server */
+    uint64_t size;    /* entries currently cached */
+};
+
+/**
+ * Bounded LRU cache of remote Get results held by a client. An entry is
+ * only used until the lease the server granted with it runs out; the
+ * expiry is counted from when the request was sent, so it never outlives
+ * the server's lease. Results for missing keys are cached too.
+ */
+template<typename KeyType, typename MappedType, typename Hash = std::hash<KeyType>>
+class client_cache {
+  private:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+    struct Entry {
+        KeyType key;
+        std::pair<bool, MappedType> value;
+        TimePoint expiry;
+    };
+    size_t capacity;
+    std::mutex mutex;
+    std::list<Entry> lru;
+    std::unordered_map<KeyType, typename std::list<Entry>::iterator, Hash> index;
+    std::atomic<uint64_t> hits, misses;
+  public:
+    explicit client_cache(size_t capacity_) : capacity(capacity_), mutex(), lru(), index(), hits(0), misses(0) {}
+
+    bool Lookup(const KeyType &key, std::pair<bool, MappedType> &value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = index.find(key);
+        if (iter != index.end()) {
+            if (iter->second->expiry > std::chrono::steady_clock::now()) {
+                lru.splice(lru.begin(), lru, iter->second);
+                value = iter->second->value;
+                hits++;
+                return true;
+            }
+            lru.erase(iter->second);
+            index.erase(iter);
+        }
+        misses++;
+        return false;
+    }
+
+    void Insert(const KeyType &key, const std::pair<bool, MappedType> &value, TimePoint expiry) {
+        if (capacity == 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = index.find(key);
+        if (iter != index.end()) {
+            lru.erase(iter->second);
+            index.erase(iter);
+        }
+        while (lru.size() >= capacity) {
+            index.erase(lru.back().key);
+            lru.pop_back();
+        }
+        lru.push_front(Entry{key, value, expiry});
+        index.emplace(key, lru.begin());
+    }
+
+    /* Drops key so this client reads its own updates. */
+    void Invalidate(const KeyType &key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = index.find(key);
+        if (iter == index.end()) return;
+        lru.erase(iter->second);
+        index.erase(iter);
+    }
+
+    cache_stats Stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cache_stats{hits.load(), misses.load(), lru.size()};
+    }
+};
+}  // namespace hcl
+
+#endif  // INCLUDE_HCL_COMMON_CLIENT_CACHE_H_
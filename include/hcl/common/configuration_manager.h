@@ -36,6 +36,20 @@ namespace hcl{
         CharStruct VERBS_CONF;
         CharStruct VERBS_DOMAIN;
         really_long MEMORY_ALLOCATED;
+        really_long MAX_MEMORY_ALLOCATED;
+        uint16_t NUM_STRIPES;
+        uint16_t NUM_SUB_QUEUES;
+        uint32_t SEQUENCE_LEASE_SIZE;
+        bool READ_WRITE_LOCK;
+        really_long RDMA_THRESHOLD;
+        PartitionerType PARTITIONER;
+        uint16_t VIRTUAL_NODES;
+        uint32_t CLIENT_CACHE_SIZE;
+        uint32_t LEASE_DURATION_MS;
+        uint16_t REPLICATION_FACTOR;
+        bool PERSISTENT;
+        uint32_t CLOCK_SYNC_INTERVAL_MS;
+        bool HLC_PIGGYBACK;
 
         bool IS_SERVER;
         uint16_t MY_SERVER;
@@ -44,13 +58,12 @@ namespace hcl{
         CharStruct SERVER_LIST_PATH;
         std::vector<CharStruct> SERVER_LIST;
         CharStruct BACKED_FILE_DIR;
+        CharStruct CHECKPOINT_DIR;
+        CharStruct JOURNAL_DIR;
 
         bool DYN_CONFIG;  // Does not do anything (yet)
 
       ConfigurationManager():
-              SERVER_LIST(),
-              BACKED_FILE_DIR("/dev/shm"),
-              MEMORY_ALLOCATED(1024ULL * 1024ULL * 128ULL),
               RPC_PORT(9000), RPC_THREADS(1),
 #if defined(HCL_ENABLE_RPCLIB)
               RPC_IMPLEMENTATION(RPCLIB),
@@ -60,8 +73,15 @@ namespace hcl{
         RPC_IMPLEMENTATION(THALLIUM_ROCE),
 #endif
               TCP_CONF("ofi+sockets"), VERBS_CONF("ofi-verbs"), VERBS_DOMAIN("mlx5_0"),
+              MEMORY_ALLOCATED(1024ULL * 1024ULL * 128ULL), MAX_MEMORY_ALLOCATED(0), NUM_STRIPES(1), NUM_SUB_QUEUES(1), SEQUENCE_LEASE_SIZE(0),
+              READ_WRITE_LOCK(false),
+              RDMA_THRESHOLD(64ULL * 1024ULL),
+              PARTITIONER(CONSISTENT_HASH_PARTITIONER), VIRTUAL_NODES(128),
+              CLIENT_CACHE_SIZE(0), LEASE_DURATION_MS(100), REPLICATION_FACTOR(1), PERSISTENT(false),
+              CLOCK_SYNC_INTERVAL_MS(0), HLC_PIGGYBACK(false),
               IS_SERVER(false), MY_SERVER(0), NUM_SERVERS(1),
-              SERVER_ON_NODE(true), SERVER_LIST_PATH("./server_list"), DYN_CONFIG(false) {
+              SERVER_ON_NODE(true), SERVER_LIST_PATH("./server_list"), SERVER_LIST(),
+              BACKED_FILE_DIR("/dev/shm"), CHECKPOINT_DIR(""), JOURNAL_DIR(""), DYN_CONFIG(false) {
           AutoTrace trace = AutoTrace("ConfigurationManager");
           MPI_Comm_size(MPI_COMM_WORLD, &COMM_SIZE);
           MPI_Comm_rank(MPI_COMM_WORLD, &MPI_RANK);
@@ -19,5 +19,36 @@ const uint16_t RPC_PORT = 8080;
 const uint16_t RPC_THREADS = 1;
 const int TEST_REQUEST_SIZE = 1024;
 const CharStruct PATH_SEPARATOR = "/";
+/* Upper bound on servers that can join a running job (see RPC::RefreshServers). */
+const uint16_t MAX_SERVERS = 1024;
+/* Entries moved per step when keys migrate between servers. */
+const size_t MIGRATION_BATCH = 1024;
+/* Attempts at moving a migration batch, and rounds of migration Resize
+ * runs before it gives up, with MIGRATION_RETRY_MS between attempts. */
+const int MIGRATION_ATTEMPTS = 3;
+const uint32_t MIGRATION_RETRY_MS = 100;
+/* How often clients without a server on their node ask it for the
+ * membership of structures that can change their servers. */
+const uint32_t MEMBERSHIP_POLL_MS = 1000;
+/* Upper bound on HCL_CONF->REPLICATION_FACTOR. */
+const uint16_t MAX_REPLICAS = 8;
+/* Milliseconds before updates a replica did not take are sent again. */
+const uint32_t REPLICATION_RETRY_MS = 100;
+/* Probes per server when global_clock measures clock offsets; the one
+ * with the shortest round trip is kept. */
+const uint16_t CLOCK_SYNC_PROBES = 8;
+/* Children per node of the heap behind priority_queue. */
+const size_t HEAP_ARITY = 4;
+/* Random pairs of sub-queues a relaxed priority_queue pop tries before it
+ * looks at all of them in turn. */
+const int RELAXED_POP_ATTEMPTS = 4;
+/* Most elements queue::StealingPop takes from another server at once. */
+const uint32_t STEAL_BATCH = 64;
+/* Size of a cache line; shared counters are padded to it. */
+const size_t CACHE_LINE_SIZE = 64;
+/* Default number of slots of a ring_queue. */
+const uint64_t RING_QUEUE_CAPACITY = 1ULL << 16;
+/* Larger ring_queue elements are stored out of line, by offset. */
+const size_t RING_INLINE_SIZE = 56;
 
 #endif  // INCLUDE_HCL_COMMON_CONSTANTS_H_
@@ -13,24 +13,900 @@
 #ifndef HCL_CONTAINER_H
 #define HCL_CONTAINER_H
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
+#include <future>
 #include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/sharable_lock.hpp>
 #include <hcl/communication/rpc_lib.h>
 #include <hcl/communication/rpc_factory.h>
+#include <hcl/common/partitioner.h>
+#include <hcl/common/client_cache.h>
+#include <hcl/common/replication.h>
+#include <hcl/common/journal.h>
 #include "typedefs.h"
 
 namespace hcl{
+    /**
+     * Lock placed in the shared segment next to the data it guards. In the
+     * default mode every lock is exclusive. In reader-writer mode
+     * (HCL_CONF->READ_WRITE_LOCK on the server) lock_sharable() lets readers
+     * proceed together while writers still get exclusive access. The mode is
+     * fixed when the server constructs the object, so co-located clients that
+     * find it in the segment always follow the server's choice.
+     */
+    class segment_mutex{
+    private:
+        bool read_write;
+        boost::interprocess::interprocess_mutex exclusive_mutex;
+        boost::interprocess::interprocess_sharable_mutex sharable_mutex;
+    public:
+        explicit segment_mutex(bool read_write_ = HCL_CONF->READ_WRITE_LOCK)
+                : read_write(read_write_), exclusive_mutex(), sharable_mutex() {}
+
+        inline bool IsReadWrite() const { return read_write; }
+
+        void lock() {
+            if (read_write) sharable_mutex.lock();
+            else exclusive_mutex.lock();
+        }
+        bool try_lock() {
+            if (read_write) return sharable_mutex.try_lock();
+            return exclusive_mutex.try_lock();
+        }
+        void unlock() {
+            if (read_write) sharable_mutex.unlock();
+            else exclusive_mutex.unlock();
+        }
+
+        void lock_sharable() {
+            if (read_write) sharable_mutex.lock_sharable();
+            else exclusive_mutex.lock();
+        }
+        bool try_lock_sharable() {
+            if (read_write) return sharable_mutex.try_lock_sharable();
+            return exclusive_mutex.try_lock();
+        }
+        void unlock_sharable() {
+            if (read_write) sharable_mutex.unlock_sharable();
+            else exclusive_mutex.unlock();
+        }
+    };
+
+    /**
+     * Keys a migration step is handing over to their next owner, sorted by
+     * hash, with a flag every write to one of them sets. Guarded by mutex;
+     * count is also read without it so that requests skip the lookup while
+     * no handover runs. A batch never runs more than a bucket or a key over
+     * MIGRATION_BATCH, so twice that always fits.
+     */
+    struct handover_keys{
+        boost::interprocess::interprocess_mutex mutex;
+        std::atomic<size_t> count;
+        size_t hashes[2 * MIGRATION_BATCH];
+        bool written[2 * MIGRATION_BATCH];
+        handover_keys() : mutex(), count(0) {}
+    };
+
+    /**
+     * Capacity bookkeeping kept in the segment, so the server and co-located
+     * clients share it. max_size is fixed by the server; 0 means the segment
+     * keeps the size it was created with.
+     */
+    struct segment_info{
+        really_long max_size;
+        std::atomic<really_long> high_water_mark;
+        std::atomic<uint32_t> grow_count;
+        /* membership::Pack() of the server set this segment's server routes by */
+        std::atomic<uint64_t> membership;
+        /* true while the server moves keys to their owners in the next membership */
+        std::atomic<bool> migrating;
+        /* sequence number of the last journal record applied to this segment */
+        std::atomic<uint64_t> journal_seq;
+        handover_keys handover;
+        segment_info(really_long max_size_, uint64_t membership_)
+                : max_size(max_size_), high_water_mark(0), grow_count(0),
+                  membership(membership_), migrating(false), journal_seq(0), handover() {}
+    };
+
+    /**
+     * The set of servers keys are spread over. epoch is bumped every time
+     * servers join or leave; while they do, next_num_servers is the server
+     * count being moved to (0 otherwise). Packed in one word so co-located
+     * processes read it from the segment with a single load.
+     */
+    struct membership{
+        uint32_t epoch;
+        uint16_t num_servers;
+        uint16_t next_num_servers;
+        uint64_t Pack() const {
+            return ((uint64_t)epoch << 32) | ((uint64_t)num_servers << 16) | next_num_servers;
+        }
+        static membership Unpack(uint64_t word) {
+            return membership{(uint32_t)(word >> 32), (uint16_t)(word >> 16), (uint16_t)word};
+        }
+    };
+
+    /* What a server's _MigrationDone reports. */
+    const uint8_t MIGRATION_RUNNING = 0;
+    const uint8_t MIGRATION_DONE = 1;
+    const uint8_t MIGRATION_FAILED = 2;
+
+    /** Snapshot returned by container::SegmentUsage. */
+    struct segment_usage{
+        really_long size;             /* bytes currently managed */
+        really_long used;             /* bytes currently allocated */
+        really_long high_water_mark;  /* most bytes ever seen allocated */
+        really_long max_size;         /* growth limit, 0 if fixed */
+        uint32_t grow_count;
+    };
+
+    /**
+     * Read handle returned by GetView. For a key owned by the co-located
+     * server it pins the value in the segment: the handle holds the shared
+     * lock that guards it and points at the stored value, so nothing is
+     * copied. For a remote key it owns the copy fetched over RPC. Writers to
+     * the pinned data wait until the handle is destroyed, so keep it short
+     * lived and never update the same container while holding it.
+     */
+    template<typename MappedType>
+    class value_view{
+    private:
+        boost::interprocess::sharable_lock<segment_mutex> lock;
+        const MappedType *value;
+        std::unique_ptr<MappedType> copy;
+    public:
+        value_view(): lock(), value(nullptr), copy() {}
+        value_view(boost::interprocess::sharable_lock<segment_mutex> &&lock_, const MappedType *value_)
+                : lock(std::move(lock_)), value(value_), copy() {}
+        explicit value_view(std::pair<bool, MappedType> &&result): lock(), value(nullptr), copy() {
+            if (result.first) {
+                copy = std::make_unique<MappedType>(std::move(result.second));
+                value = copy.get();
+            }
+        }
+        value_view(value_view &&other)
+                : lock(std::move(other.lock)), value(other.value), copy(std::move(other.copy)) {
+            other.value = nullptr;
+        }
+        value_view &operator=(value_view &&other) {
+            lock = std::move(other.lock);
+            value = other.value;
+            copy = std::move(other.copy);
+            other.value = nullptr;
+            return *this;
+        }
+
+        bool found() const { return value != nullptr; }
+        explicit operator bool() const { return found(); }
+        const MappedType &operator*() const { return *value; }
+        const MappedType *operator->() const { return value; }
+    };
+
     class container{
     protected:
-        int comm_size, my_rank, num_servers;
+        int comm_size, my_rank;
+        std::atomic<int> num_servers;
         uint16_t  my_server;
         std::shared_ptr<RPC> rpc;
         really_long memory_allocated;
         bool is_server;
         boost::interprocess::managed_mapped_file segment;
         CharStruct name, func_prefix;
-        boost::interprocess::interprocess_mutex* mutex;
+        RPCProcedureCache rpc_procedures;
+        std::shared_ptr<partitioner> key_partitioner;
+        /* Placement for the current and, while servers join or leave, the
+         * next membership. Tables are kept alive in routing_tables. */
+        std::atomic<const partitioner *> routing, next_routing;
+        std::atomic<uint64_t> seen_membership;
+        /* Steady clock time (ns) at which a client without the segment next
+         * asks its server for the membership; never, unless WatchMembership
+         * was called. */
+        std::atomic<int64_t> membership_poll_due;
+        std::mutex routing_mutex;
+        std::vector<std::shared_ptr<partitioner>> routing_tables;
+        std::thread migration_thread;
+        /* Set once MigrationLoop finished; migration_failed if some entries
+         * could not be moved and are still here. */
+        std::atomic<bool> migration_done, migration_failed;
+        segment_mutex* mutex;
+        segment_info* info;
+        /* Read leases of clients caching this structure, null if unused. */
+        lease_table* leases;
+        /* Servers holding each key (HCL_CONF->REPLICATION_FACTOR, capped by
+         * the server count) and this process's unanswered reads per server. */
+        uint16_t replication_factor;
+        std::unique_ptr<std::atomic<uint32_t>[]> in_flight;
         CharStruct backed_file;
+        /* HCL_CONF->PERSISTENT: the backing file outlives the server, and
+         * reopened is set when the server found one from an earlier run. */
+        bool persistent, reopened;
+        /* Where Checkpoint copies the segment, empty to only flush it. */
+        CharStruct checkpoint_file;
+        /* HCL_CONF->JOURNAL_DIR is set; oplog is the server's open journal. */
+        bool journaled;
+        CharStruct journal_file;
+        std::unique_ptr<journal> oplog;
+
+        /**
+         * Copies the segment file from to to, leaving holes where from has
+         * them so a sparsely reserved segment stays sparse. The copy is
+         * written under a temporary name and renamed once it is on disk, so
+         * to always holds a complete segment.
+         * @return bool, false on any I/O error
+         */
+        static bool CopySegmentFile(const char *from, const char *to) {
+            std::string temp = std::string(to) + ".tmp";
+            int in = open(from, O_RDONLY);
+            if (in < 0) return false;
+            int out = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (out < 0) {
+                close(in);
+                return false;
+            }
+            off_t size = lseek(in, 0, SEEK_END);
+            bool copied = size >= 0 && ftruncate(out, size) == 0;
+            std::vector<char> buffer(1 << 20);
+            off_t data = lseek(in, 0, SEEK_DATA);
+            /* Without hole support the whole file counts as data. */
+            if (data < 0 && errno != ENXIO) data = 0;
+            while (copied && data >= 0 && data < size) {
+                off_t hole = lseek(in, data, SEEK_HOLE);
+                if (hole < 0) hole = size;
+                while (copied && data < hole) {
+                    ssize_t length = pread(in, buffer.data(), std::min<off_t>(buffer.size(), hole - data), data);
+                    copied = length > 0 && pwrite(out, buffer.data(), length, data) == length;
+                    data += length;
+                }
+                data = lseek(in, hole, SEEK_DATA);
+            }
+            copied = copied && fsync(out) == 0;
+            close(in);
+            close(out);
+            copied = copied && rename(temp.c_str(), to) == 0;
+            if (!copied) unlink(temp.c_str());
+            return copied;
+        }
+
+        /**
+         * Persistent mode: maps the segment an earlier run of this server
+         * left in its backing file or, if that is gone (/dev/shm does not
+         * survive a reboot), the last checkpoint copied back into place.
+         * @return bool, false if there was nothing usable to reopen
+         */
+        bool ReopenSegment() {
+            if (access(backed_file.c_str(), F_OK) != 0) {
+                if (checkpoint_file.size() == 0 || access(checkpoint_file.c_str(), F_OK) != 0) return false;
+                if (!CopySegmentFile(checkpoint_file.c_str(), backed_file.c_str())) {
+                    printf("Error: Can't restore %s from %s\n", backed_file.c_str(), checkpoint_file.c_str());
+                    return false;
+                }
+            }
+            try {
+                segment = boost::interprocess::managed_mapped_file(
+                        boost::interprocess::open_only, backed_file.c_str());
+            } catch (boost::interprocess::interprocess_exception &e) {
+                printf("Error: Can't reopen %s: %s\n", backed_file.c_str(), e.what());
+                return false;
+            }
+            if (segment.find<segment_info>("info").first != nullptr) return true;
+            boost::interprocess::managed_mapped_file closed;
+            segment.swap(closed);
+            return false;
+        }
+
+        /**
+         * Locks in a reopened segment may still look held by processes of the
+         * earlier run, or by the checkpoint that was taken under them, so the
+         * server reinitializes them before it serves. Containers with locks
+         * besides mutex call this once they have found their objects.
+         */
+        void ResetLocks() {
+            if (!reopened) return;
+            for (auto *lock : AllocationLocks()) new (lock) segment_mutex(lock->IsReadWrite());
+        }
+
+        /* Applies one journaled update during recovery. */
+        virtual void ReplayRecord(journal_reader &) {}
+
+        /**
+         * Replays the journal on top of the segment restored from the last
+         * checkpoint, then opens it for the updates that follow. The server
+         * calls this once its objects are in place; supported says whether
+         * the structure's types have a journal_codec.
+         */
+        void OpenJournal(bool supported) {
+            if (!journaled) return;
+            if (!supported) {
+                printf("Error: %s has types without a journal_codec and is not journaled\n", name.c_str());
+                return;
+            }
+            /* Records the checkpoint holds already are skipped; queue pushes
+             * and pops would not survive being applied twice. */
+            uint64_t last = journal::Replay(journal_file.string(), info->journal_seq.load(),
+                                            [this](journal_reader &record) { ReplayRecord(record); });
+            oplog = std::make_unique<journal>(journal_file.string(), last);
+        }
+
+        /* Logs an applied update; called with its data locked. Updates
+         * commit it through a journal_commit declared before their locks. */
+        inline void Journal(const journal_record &record) {
+            if (oplog != nullptr) oplog->Append(record);
+        }
+
+        /**
+         * With HCL_CONF->MAX_MEMORY_ALLOCATED set, the server extends the
+         * backing file (sparsely) to the maximum size before anyone maps it,
+         * while the segment manager still only manages memory_allocated
+         * bytes. Every process then maps the whole range up front, so growing
+         * the segment later never moves it and nobody has to remap.
+         */
+        really_long ReserveSegment(really_long max_size) {
+            really_long overhead = memory_allocated - segment.get_size();
+            {
+                boost::interprocess::managed_mapped_file closed;
+                segment.swap(closed);
+            }
+            if (truncate(backed_file.c_str(), max_size + overhead) != 0) {
+                printf("Error: Can't reserve %llu bytes for %s, segment will not grow\n",
+                       (unsigned long long)max_size, backed_file.c_str());
+                max_size = 0;
+            }
+            segment = boost::interprocess::managed_mapped_file(
+                    boost::interprocess::open_only, backed_file.c_str());
+            return max_size;
+        }
+
+        /**
+         * Every allocation in the segment happens under one of these locks,
+         * so holding all of them excludes allocators in every process.
+         */
+        virtual std::vector<segment_mutex *> AllocationLocks() {
+            return std::vector<segment_mutex *>(1, mutex);
+        }
+
+        /**
+         * Doubles the managed size (up to max_size) with all allocation locks
+         * held. seen_size is the size the failed allocation ran against; if it
+         * changed, another thread or process already grew the segment.
+         * @return bool, false if the segment cannot grow any further
+         */
+        bool GrowSegment(really_long seen_size) {
+            if (info->max_size == 0) return false;
+            std::vector<segment_mutex *> locks = AllocationLocks();
+            for (auto *lock : locks) lock->lock();
+            bool grown = true;
+            really_long size = segment.get_size();
+            if (size == seen_size) {
+                really_long room = size < info->max_size ? info->max_size - size : 0;
+                really_long extra = std::min(size, room);
+                if (extra == 0) {
+                    grown = false;
+                } else {
+                    segment.get_segment_manager()->grow(extra);
+                    info->grow_count++;
+                }
+            }
+            for (auto lock = locks.rbegin(); lock != locks.rend(); ++lock) (*lock)->unlock();
+            return grown;
+        }
+
+        void NoteUsage() {
+            really_long used = segment.get_size() - segment.get_free_memory();
+            really_long peak = info->high_water_mark.load(std::memory_order_relaxed);
+            while (used > peak && !info->high_water_mark.compare_exchange_weak(peak, used)) {}
+        }
+
+        /**
+         * Runs an operation that allocates in the segment. When the segment
+         * is full the operation's locks have been released by the time
+         * bad_alloc reaches here; the segment is grown and the operation
+         * retried, so it must be safe to repeat.
+         */
+        template<typename Op>
+        auto GrowOnBadAlloc(Op op) -> decltype(op()) {
+            while (true) {
+                really_long seen_size = segment.get_size();
+                try {
+                    auto result = op();
+                    NoteUsage();
+                    return result;
+                } catch (boost::interprocess::bad_alloc &) {
+                    if (!GrowSegment(seen_size)) throw;
+                }
+            }
+        }
+        const partitioner *RoutingTable(uint16_t servers) {
+            for (auto &table : routing_tables) {
+                if (table->NumServers() == servers) return table.get();
+            }
+            std::shared_ptr<partitioner> table = key_partitioner->Resize(servers);
+            if (table == nullptr) table = std::make_shared<modulo_partitioner>(servers);
+            routing_tables.push_back(table);
+            return table.get();
+        }
+
+        void AdoptMembership(uint64_t word) {
+            std::lock_guard<std::mutex> lock(routing_mutex);
+            if (word == seen_membership.load()) return;
+            membership state = membership::Unpack(word);
+            /* A reply that raced with a newer one is out of date. */
+            if (state.epoch < membership::Unpack(seen_membership.load()).epoch) return;
+            routing.store(RoutingTable(state.num_servers));
+            next_routing.store(state.next_num_servers > 0 ? RoutingTable(state.next_num_servers) : nullptr);
+            num_servers = state.num_servers;
+            seen_membership.store(word);
+        }
+
+        /**
+         * Clients without the server's segment ask their server for the
+         * membership every MEMBERSHIP_POLL_MS, so after a resize they stop
+         * routing through the old owners by themselves. Whoever finds the
+         * poll due first makes the call; other threads go on meanwhile.
+         */
+        void PollMembership() {
+            int64_t due = membership_poll_due.load(std::memory_order_relaxed);
+            if (due == INT64_MAX) return;
+            int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+            if (now < due || !membership_poll_due.compare_exchange_strong(
+                    due, now + (int64_t)MEMBERSHIP_POLL_MS * 1000000)) return;
+            try {
+                uint16_t server = my_server;
+                uint64_t word = RPC_CALL_WRAPPER1("_Membership", server, uint64_t);
+                AdoptMembership(word);
+            } catch (std::exception &e) {
+                /* Keep the current routing; the old owners still forward. */
+            }
+        }
+
+        /* Called by structures that bind the membership RPCs. */
+        void WatchMembership() {
+            if (info == nullptr) membership_poll_due = 0;
+        }
+
+        /* Picks up membership changes made by the server in the segment. */
+        inline void SyncMembership() {
+            if (info == nullptr) {
+                PollMembership();
+                return;
+            }
+            uint64_t word = info->membership.load(std::memory_order_acquire);
+            if (word != seen_membership.load(std::memory_order_relaxed)) AdoptMembership(word);
+        }
+
+        /* The placement clients route by. */
+        inline const partitioner *Routing() {
+            SyncMembership();
+            return routing.load();
+        }
+
+        inline uint16_t GetServer(size_t key_hash) {
+            return Routing()->GetServer(key_hash);
+        }
+
+        /**
+         * Server side of elastic membership, used by the Local operations.
+         * A key stays with this server if it belongs here in the current or,
+         * while servers join or leave, the next membership; once this server
+         * is migrating, only the next membership counts. Requests for keys
+         * that do not stay and are not held here are forwarded to Owner, so
+         * clients routing by an older epoch still reach the data.
+         */
+        bool Stays(size_t key_hash) {
+            SyncMembership();
+            const partitioner *next = next_routing.load();
+            /* Until the first resize every request is for a key placed here. */
+            if (next == nullptr && seen_membership.load(std::memory_order_relaxed) >> 32 == 0) return true;
+            if (next != nullptr) {
+                if (next->GetServer(key_hash) == my_server) return true;
+                if (info->migrating.load()) return HandingOver(key_hash);
+            }
+            return routing.load()->GetServer(key_hash) == my_server;
+        }
+
+        uint16_t Owner(size_t key_hash) {
+            SyncMembership();
+            const partitioner *next = next_routing.load();
+            if (next != nullptr && info->migrating.load()) return next->GetServer(key_hash);
+            return routing.load()->GetServer(key_hash);
+        }
+
+        /* Places the lease table in the segment (server) or finds it (co-located client). */
+        void ConstructLeases() {
+            if (HCL_CONF->LEASE_DURATION_MS == 0) return;
+            leases = segment.find_or_construct<lease_table>("leases")(HCL_CONF->LEASE_DURATION_MS * 1000000ULL);
+            if (reopened) new (leases) lease_table(HCL_CONF->LEASE_DURATION_MS * 1000000ULL);
+        }
+        void OpenLeases() {
+            leases = segment.find<lease_table>("leases").first;
+        }
+
+        /**
+         * Lease for a client that wants to cache key_hash, in nanoseconds.
+         * None are granted while servers join or leave.
+         * @return 0 if no lease was granted
+         */
+        uint64_t GrantLease(size_t key_hash) {
+            if (leases == nullptr) return 0;
+            uint64_t duration = leases->Grant(key_hash);
+            if (membership::Unpack(info->membership.load()).next_num_servers != 0) return 0;
+            return duration;
+        }
+
+        /* The servers holding key_hash, its owner first. */
+        inline uint16_t Replicas(size_t key_hash, uint16_t *servers) {
+            return Routing()->GetReplicas(key_hash, replication_factor, servers);
+        }
+
+        /* Whether the co-located server holds a copy of key_hash. */
+        bool HoldsReplica(size_t key_hash) {
+            if (!server_on_node) return false;
+            uint16_t servers[MAX_REPLICAS];
+            uint16_t count = Replicas(key_hash, servers);
+            return std::find(servers, servers + count, my_server) != servers + count;
+        }
+
+        /* Queues op for every replica of key_hash but the owner. Called by the
+         * owner with the lock of the updated data held. */
+        template<typename Op>
+        void QueueReplicas(replication_queue<Op> *queue, size_t key_hash, const Op &op) {
+            if (queue == nullptr) return;
+            uint16_t servers[MAX_REPLICAS];
+            uint16_t count = Replicas(key_hash, servers);
+            for (uint16_t i = 1; i < count; ++i) queue->Push(servers[i], op);
+        }
+
+        /**
+         * Sends a read to the replica of key_hash with the fewest reads this
+         * process is waiting on, rotating among equally loaded ones. If the
+         * call fails the next replica is tried, so reads survive a server
+         * restart.
+         */
+        template<typename Ret, typename... Args>
+        Ret ReplicaRead(size_t key_hash, const char *funcname, Args &... args) {
+            static thread_local uint32_t turn = 0;
+            uint16_t servers[MAX_REPLICAS];
+            uint16_t count = Replicas(key_hash, servers);
+            std::rotate(servers, servers + (turn++ % count), servers + count);
+            std::stable_sort(servers, servers + count, [this](uint16_t a, uint16_t b) {
+                return in_flight[a].load(std::memory_order_relaxed) < in_flight[b].load(std::memory_order_relaxed);
+            });
+            for (uint16_t i = 0; ; ++i) {
+                uint16_t server = servers[i];
+                in_flight[server]++;
+                try {
+                    Ret result = RPC_CALL_WRAPPER(funcname, server, Ret, args...);
+                    in_flight[server]--;
+                    return result;
+                } catch (std::exception &) {
+                    in_flight[server]--;
+                    if (i + 1 == count) throw;
+                }
+            }
+        }
+
+        /* Re-issues a request at the server that owns key_hash. */
+        template<typename Ret, typename... Args>
+        Ret Forward(size_t key_hash, const char *funcname, Args &... args) {
+            uint16_t owner = Owner(key_hash);
+            return RPC_CALL_WRAPPER(funcname, owner, Ret, args...);
+        }
+
+        /**
+         * Moves one batch of entries that belong elsewhere in the next
+         * membership to their owners. Returns false once nothing is left.
+         */
+        virtual bool MigrateStep() { return false; }
+
+        /**
+         * Names the keys being handed over, replacing the earlier ones.
+         * MigrateStep calls this with the keys' data locked; from then on
+         * they stay with this server, present or not, until the new owner
+         * holds their last state, so nothing is forwarded there meanwhile.
+         */
+        void StartHandover(std::vector<size_t> hashes) {
+            std::sort(hashes.begin(), hashes.end());
+            hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+            handover_keys &handover = info->handover;
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(handover.mutex);
+            std::copy(hashes.begin(), hashes.end(), handover.hashes);
+            std::fill(handover.written, handover.written + hashes.size(), false);
+            handover.count = hashes.size();
+        }
+
+        /* Index of key_hash among the keys handed over, or -1; with handover.mutex held. */
+        static ptrdiff_t HandoverIndex(handover_keys &handover, size_t key_hash) {
+            size_t *end = handover.hashes + handover.count.load();
+            size_t *found = std::lower_bound(handover.hashes, end, key_hash);
+            return found != end && *found == key_hash ? found - handover.hashes : -1;
+        }
+
+        bool HandingOver(size_t key_hash) {
+            handover_keys &handover = info->handover;
+            if (handover.count.load() == 0) return false;
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(handover.mutex);
+            return HandoverIndex(handover, key_hash) >= 0;
+        }
+
+        /* Called by every update, with the updated key's data locked. */
+        void NoteWrite(size_t key_hash) {
+            handover_keys &handover = info->handover;
+            if (handover.count.load() == 0) return;
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(handover.mutex);
+            ptrdiff_t index = HandoverIndex(handover, key_hash);
+            if (index >= 0) handover.written[index] = true;
+        }
+
+        /* Whether a key handed over was written to since StartHandover. */
+        bool Written(size_t key_hash) {
+            handover_keys &handover = info->handover;
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(handover.mutex);
+            ptrdiff_t index = HandoverIndex(handover, key_hash);
+            return index >= 0 && handover.written[index];
+        }
+
+        /* One server's share of a migration batch: its keys, their hashes
+         * and the entries to store there. */
+        template<typename Key, typename Entry>
+        struct handover_batch {
+            std::vector<Key> keys;
+            std::vector<size_t> hashes;
+            std::vector<Entry> entries;
+        };
+
+        /* Erases keys at server through its _Erase; false if a call failed. */
+        template<typename Ret, typename Key>
+        bool DropEntries(uint16_t server, std::vector<Key> &keys) {
+            try {
+                for (auto &key : keys) {
+                    Ret dropped = RPC_CALL_WRAPPER("_Erase", server, Ret, key);
+                    (void) dropped;
+                }
+                return true;
+            } catch (std::exception &e) {
+                printf("Error: %s could not drop %zu stale entries at server %d: %s\n",
+                       name.c_str(), keys.size(), server, e.what());
+                migration_failed = true;
+                return false;
+            }
+        }
+
+        /**
+         * Moves a migration batch to the new owners without holding the
+         * batch's lock across the RPCs, so requests are served meanwhile and
+         * two servers can move keys to each other. MigrateStep copies the
+         * entries into outgoing and calls StartHandover under lock. Once the
+         * entries arrived, the keys nobody wrote to meanwhile are erased
+         * here; the others are dropped at their new owner and sent again as
+         * they are now. Keys still written to after MIGRATION_ATTEMPTS
+         * rounds stay here, their copies are dropped and the migration
+         * fails, so Resize runs another round for them.
+         * @param lock, the lock of the batch's data
+         * @param reload, reload(key, entries) appends the key's entries here
+         * to entries, with lock held
+         * @param erase_here, erase_here(key) erases the key here if it is
+         * present, with lock held
+         */
+        template<typename DropRet, typename Key, typename Entry, typename Reload, typename EraseHere>
+        void HandOver(segment_mutex &lock, std::vector<handover_batch<Key, Entry>> &outgoing,
+                      Reload reload, EraseHere erase_here) {
+            for (int round = 0;; ++round) {
+                /* The last round only drops the stale copies. */
+                bool last = round == MIGRATION_ATTEMPTS;
+                std::vector<bool> sent(outgoing.size(), false);
+                for (uint16_t server = 0; server < outgoing.size(); ++server) {
+                    auto &batch = outgoing[server];
+                    if (batch.keys.empty()) continue;
+                    sent[server] = (round == 0 || DropEntries<DropRet>(server, batch.keys)) &&
+                                   (last || batch.entries.empty() || MoveEntries(server, batch.entries));
+                }
+                std::vector<size_t> pending;
+                size_t kept = 0;
+                {
+                    boost::interprocess::scoped_lock<segment_mutex> guard(lock);
+                    for (uint16_t server = 0; server < outgoing.size(); ++server) {
+                        auto &batch = outgoing[server];
+                        handover_batch<Key, Entry> written;
+                        for (size_t i = 0; i < batch.keys.size(); ++i) {
+                            if (last) kept++;
+                            /* Keys that did not arrive stay here; MoveEntries failed the migration. */
+                            if (!sent[server] || last) continue;
+                            if (!Written(batch.hashes[i])) {
+                                erase_here(batch.keys[i]);
+                                continue;
+                            }
+                            written.keys.push_back(batch.keys[i]);
+                            written.hashes.push_back(batch.hashes[i]);
+                            reload(batch.keys[i], written.entries);
+                        }
+                        pending.insert(pending.end(), written.hashes.begin(), written.hashes.end());
+                        batch = std::move(written);
+                    }
+                    StartHandover(pending);
+                }
+                if (kept > 0) {
+                    printf("Error: %s kept %zu keys that were written to while they moved\n", name.c_str(), kept);
+                    migration_failed = true;
+                }
+                if (pending.empty()) return;
+            }
+        }
+
+        /**
+         * Stores a batch of migrating entries at their new owner through its
+         * _MultiPut, trying MIGRATION_ATTEMPTS times. A batch that still
+         * fails fails the migration; the caller keeps the entries.
+         * @return bool, true if the new owner stored every entry
+         */
+        template<typename Entries>
+        bool MoveEntries(uint16_t server, Entries &entries) {
+            std::string error = "not stored";
+            for (int attempt = 0; attempt < MIGRATION_ATTEMPTS; ++attempt) {
+                if (attempt > 0) usleep(MIGRATION_RETRY_MS * 1000);
+                try {
+                    bool stored = RPC_CALL_WRAPPER("_MultiPut", server, bool, entries);
+                    if (stored) return true;
+                } catch (std::exception &e) {
+                    error = e.what();
+                }
+            }
+            printf("Error: %s could not move %zu entries to server %d: %s\n",
+                   name.c_str(), entries.size(), server, error.c_str());
+            migration_failed = true;
+            return false;
+        }
+
+        void MigrationLoop() {
+            try {
+                while (MigrateStep()) {}
+            } catch (std::exception &e) {
+                printf("Error: %s stopped migrating: %s\n", name.c_str(), e.what());
+                migration_failed = true;
+            }
+            migration_done = true;
+        }
+
+        /* Derived destructors call this before their data goes away. */
+        void WaitForMigration() {
+            if (migration_thread.joinable()) migration_thread.join();
+        }
+
+        bool LocalPrepareMembership(uint32_t epoch, uint16_t servers, uint16_t next_servers) {
+            rpc->RefreshServers();
+            migration_done = false;
+            info->membership.store(membership{epoch, servers, next_servers}.Pack());
+            SyncMembership();
+            /* Migration moves keys without waiting for leases, so let the
+             * outstanding ones run out first; GrantLease stops granting. */
+            if (leases != nullptr) leases->WaitAll();
+            return true;
+        }
+        bool LocalStartMigration() {
+            WaitForMigration();
+            StartHandover(std::vector<size_t>());
+            info->migrating = true;
+            migration_done = false;
+            migration_failed = false;
+            migration_thread = std::thread(&container::MigrationLoop, this);
+            return true;
+        }
+        /* MIGRATION_RUNNING, MIGRATION_DONE or MIGRATION_FAILED. */
+        uint8_t LocalMigrationDone() {
+            if (!migration_done.load()) return MIGRATION_RUNNING;
+            return migration_failed.load() ? MIGRATION_FAILED : MIGRATION_DONE;
+        }
+        bool LocalCommitMembership(uint32_t epoch, uint16_t servers) {
+            info->membership.store(membership{epoch, servers, 0}.Pack());
+            info->migrating = false;
+            SyncMembership();
+            return true;
+        }
+        uint64_t LocalMembership() {
+            return info->membership.load();
+        }
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+        THALLIUM_DEFINE(LocalPrepareMembership, (epoch, servers, next_servers),
+                        uint32_t epoch, uint16_t servers, uint16_t next_servers)
+        THALLIUM_DEFINE1(LocalStartMigration)
+        THALLIUM_DEFINE1(LocalMigrationDone)
+        THALLIUM_DEFINE(LocalCommitMembership, (epoch, servers), uint32_t epoch, uint16_t servers)
+        THALLIUM_DEFINE1(LocalMembership)
+        THALLIUM_DEFINE1(LocalCheckpoint)
+#endif
+
+        /* Binds the Checkpoint RPC; called by every container. */
+        void bind_checkpoint_functions() {
+            switch (HCL_CONF->RPC_IMPLEMENTATION) {
+#ifdef HCL_ENABLE_RPCLIB
+                case RPCLIB: {
+                    std::function<bool(void)> checkpointFunc(std::bind(&container::LocalCheckpoint, this));
+                    rpc->bind(func_prefix+"_Checkpoint", checkpointFunc);
+                    break;
+                }
+#endif
+#ifdef HCL_ENABLE_THALLIUM_TCP
+                case THALLIUM_TCP:
+#endif
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+                case THALLIUM_ROCE:
+#endif
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+                {
+                    std::function<void(const tl::request &)> checkpointFunc(
+                            std::bind(&container::ThalliumLocalCheckpoint, this, std::placeholders::_1));
+                    rpc->bind(func_prefix+"_Checkpoint", checkpointFunc);
+                    break;
+                }
+#endif
+            }
+        }
+
+        /* Binds the membership RPCs; called by containers that place keys. */
+        void bind_membership_functions() {
+            switch (HCL_CONF->RPC_IMPLEMENTATION) {
+#ifdef HCL_ENABLE_RPCLIB
+                case RPCLIB: {
+                    std::function<bool(uint32_t, uint16_t, uint16_t)> prepareFunc(
+                            std::bind(&container::LocalPrepareMembership, this, std::placeholders::_1,
+                                      std::placeholders::_2, std::placeholders::_3));
+                    std::function<bool(void)> startFunc(std::bind(&container::LocalStartMigration, this));
+                    std::function<uint8_t(void)> doneFunc(std::bind(&container::LocalMigrationDone, this));
+                    std::function<bool(uint32_t, uint16_t)> commitFunc(
+                            std::bind(&container::LocalCommitMembership, this, std::placeholders::_1,
+                                      std::placeholders::_2));
+                    std::function<uint64_t(void)> membershipFunc(std::bind(&container::LocalMembership, this));
+                    rpc->bind(func_prefix+"_PrepareMembership", prepareFunc);
+                    rpc->bind(func_prefix+"_StartMigration", startFunc);
+                    rpc->bind(func_prefix+"_MigrationDone", doneFunc);
+                    rpc->bind(func_prefix+"_CommitMembership", commitFunc);
+                    rpc->bind(func_prefix+"_Membership", membershipFunc);
+                    break;
+                }
+#endif
+#ifdef HCL_ENABLE_THALLIUM_TCP
+                case THALLIUM_TCP:
+#endif
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+                case THALLIUM_ROCE:
+#endif
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+                {
+                    std::function<void(const tl::request &, uint32_t, uint16_t, uint16_t)> prepareFunc(
+                            std::bind(&container::ThalliumLocalPrepareMembership, this, std::placeholders::_1,
+                                      std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+                    std::function<void(const tl::request &)> startFunc(
+                            std::bind(&container::ThalliumLocalStartMigration, this, std::placeholders::_1));
+                    std::function<void(const tl::request &)> doneFunc(
+                            std::bind(&container::ThalliumLocalMigrationDone, this, std::placeholders::_1));
+                    std::function<void(const tl::request &, uint32_t, uint16_t)> commitFunc(
+                            std::bind(&container::ThalliumLocalCommitMembership, this, std::placeholders::_1,
+                                      std::placeholders::_2, std::placeholders::_3));
+                    std::function<void(const tl::request &)> membershipFunc(
+                            std::bind(&container::ThalliumLocalMembership, this, std::placeholders::_1));
+                    rpc->bind(func_prefix+"_PrepareMembership", prepareFunc);
+                    rpc->bind(func_prefix+"_StartMigration", startFunc);
+                    rpc->bind(func_prefix+"_MigrationDone", doneFunc);
+                    rpc->bind(func_prefix+"_CommitMembership", commitFunc);
+                    rpc->bind(func_prefix+"_Membership", membershipFunc);
+                    break;
+                }
+#endif
+            }
+        }
     public:
         bool server_on_node;
         virtual void construct_shared_memory() = 0;
@@ -39,11 +915,268 @@ namespace hcl{
 
         inline bool is_local(uint16_t &key_int){ return key_int == my_server && server_on_node;}
         inline bool is_local(){ return server_on_node;}
+        /* With replication or a journal, updates from co-located clients go
+         * through the server, so that one process orders everything sent to
+         * the replicas and only the server writes the journal. */
+        inline bool is_local_write(uint16_t &key_int){
+            return is_local(key_int) && ((replication_factor == 1 && !journaled) || is_server);
+        }
 
+        /**
+         * Replaces the key placement chosen from HCL_CONF->PARTITIONER. Must
+         * be done before the first operation, identically in every process.
+         */
+        void SetPartitioner(std::shared_ptr<partitioner> partitioner_) {
+            std::lock_guard<std::mutex> lock(routing_mutex);
+            key_partitioner = partitioner_;
+            routing_tables.assign(1, partitioner_);
+            routing.store(partitioner_.get());
+        }
+
+        /**
+         * The membership this process routes by, brought up to date first.
+         * Clients on other nodes do not see the server's segment and learn
+         * about servers joining or leaving here or, every
+         * MEMBERSHIP_POLL_MS, on their own; until then their requests reach
+         * the data through the old owners, which forward them.
+         */
+        membership RefreshMembership() {
+            if (info != nullptr) {
+                SyncMembership();
+            } else {
+                uint16_t server = my_server;
+                uint64_t word = RPC_CALL_WRAPPER1("_Membership", server, uint64_t);
+                AdoptMembership(word);
+            }
+            return membership::Unpack(seen_membership.load());
+        }
+
+        /* The membership this process routes by right now. */
+        membership Membership() {
+            return membership::Unpack(seen_membership.load());
+        }
+
+        /**
+         * Moves this structure to new_num_servers servers while it stays in
+         * use. Servers joining must be listed in the server list file and
+         * have constructed the structure (with HCL_CONF->NUM_SERVERS set to
+         * new_num_servers) before this is called; servers leaving keep
+         * running so they can forward late requests. Any one process calls
+         * it. All servers first learn the next membership, then each moves
+         * the keys it no longer owns to their new owners in batches of
+         * MIGRATION_BATCH while serving requests, and finally the new
+         * membership is committed under the next epoch. Entries that could
+         * not be moved are retried for MIGRATION_ATTEMPTS rounds; after that
+         * the old membership stays in place, still forwarding to the new
+         * owners, until Resize is called again with the same count.
+         * @return bool, false if the placement cannot be resized, another
+         * resize is in progress or some entries could not be moved
+         */
+        bool Resize(uint16_t new_num_servers) {
+            if (replication_factor > 1) {
+                printf("Error: %s is replicated and can't change its servers\n", name.c_str());
+                return false;
+            }
+            if (new_num_servers == 0 || key_partitioner->Resize(new_num_servers) == nullptr) {
+                printf("Error: %s can't move to %d servers with this partitioner\n",
+                       name.c_str(), new_num_servers);
+                return false;
+            }
+            if (rpc->RefreshServers() < new_num_servers) {
+                printf("Error: server list has fewer than %d servers\n", new_num_servers);
+                return false;
+            }
+            uint16_t server = my_server;
+            uint64_t word = RPC_CALL_WRAPPER1("_Membership", server, uint64_t);
+            membership current = membership::Unpack(word);
+            /* A resize that gave up is resumed by asking for the same count. */
+            if (current.next_num_servers != 0 && current.next_num_servers != new_num_servers) {
+                printf("Error: %s is already moving to %d servers\n", name.c_str(), current.next_num_servers);
+                return false;
+            }
+            uint16_t involved = std::max(current.num_servers, new_num_servers);
+            std::vector<std::future<bool>> replies;
+            for (server = 0; server < involved; ++server) {
+                auto reply = RPC_CALL_WRAPPER_ASYNC("_PrepareMembership", server, bool,
+                                                    current.epoch, current.num_servers, new_num_servers);
+                replies.push_back(std::move(reply));
+            }
+            for (auto &reply : replies) reply.get();
+            /* Entries a server could not move stay with it; running the
+             * migration again retries just those. */
+            for (int round = 1; ; ++round) {
+                replies.clear();
+                for (server = 0; server < involved; ++server) {
+                    auto reply = RPC_CALL_WRAPPER_ASYNC1("_StartMigration", server, bool);
+                    replies.push_back(std::move(reply));
+                }
+                for (auto &reply : replies) reply.get();
+                bool failed = false;
+                for (server = 0; server < involved; ++server) {
+                    uint8_t state = MIGRATION_RUNNING;
+                    while (state == MIGRATION_RUNNING) {
+                        state = RPC_CALL_WRAPPER1("_MigrationDone", server, uint8_t);
+                        if (state == MIGRATION_RUNNING) usleep(1000);
+                    }
+                    failed = failed || state == MIGRATION_FAILED;
+                }
+                if (!failed) break;
+                if (round == MIGRATION_ATTEMPTS) {
+                    printf("Error: %s could not move all entries to %d servers; call Resize again to retry\n",
+                           name.c_str(), new_num_servers);
+                    return false;
+                }
+                usleep(MIGRATION_RETRY_MS * 1000);
+            }
+            replies.clear();
+            uint32_t epoch = current.epoch + 1;
+            for (server = 0; server < involved; ++server) {
+                auto reply = RPC_CALL_WRAPPER_ASYNC("_CommitMembership", server, bool,
+                                                    epoch, new_num_servers);
+                replies.push_back(std::move(reply));
+            }
+            for (auto &reply : replies) reply.get();
+            RefreshMembership();
+            return true;
+        }
+
+        /**
+         * Writes this server's segment to durable storage: flushes the
+         * mapping and, with HCL_CONF->CHECKPOINT_DIR set, copies the file
+         * there. Every allocation lock is held meanwhile, so the image is
+         * consistent; updates wait until it has been written.
+         * @return bool, true if the checkpoint was written
+         */
+        bool LocalCheckpoint() {
+            AutoTrace trace = AutoTrace("hcl::container::Checkpoint(local)", name);
+            if (!persistent && !journaled) {
+                printf("Error: %s is not persistent, set HCL_CONF->PERSISTENT to checkpoint it\n", name.c_str());
+                return false;
+            }
+            std::vector<segment_mutex *> locks = AllocationLocks();
+            for (auto *lock : locks) lock->lock();
+            /* The copy names the last record it holds, so if the server dies
+             * before the journal is truncated, replay skips those records. */
+            if (oplog != nullptr) info->journal_seq = oplog->Appended();
+            bool written = segment.flush();
+            if (written && checkpoint_file.size() > 0) {
+                written = CopySegmentFile(backed_file.c_str(), checkpoint_file.c_str());
+                /* Recovery starts from this copy, so older records are done with. */
+                if (written && oplog != nullptr) oplog->Truncate();
+            }
+            for (auto lock = locks.rbegin(); lock != locks.rend(); ++lock) (*lock)->unlock();
+            if (!written) printf("Error: Can't checkpoint %s\n", backed_file.c_str());
+            return written;
+        }
+
+        /**
+         * Checkpoints the segments of all servers at once (see
+         * LocalCheckpoint), so it takes as long as the largest one. Servers
+         * restarted in persistent mode then map their files again instead
+         * of being repopulated.
+         * @return bool, true if every server wrote its checkpoint
+         */
+        bool Checkpoint() {
+            std::vector<bool> written = FanOut<bool>([this](uint16_t server) -> std::future<bool> {
+                if (is_local(server)) return ReadyFuture(LocalCheckpoint());
+                auto reply = RPC_CALL_WRAPPER_ASYNC1("_Checkpoint", server, bool);
+                return reply;
+            });
+            return std::all_of(written.begin(), written.end(), [](bool ok) { return ok; });
+        }
+
+        /**
+         * Scatter-gather helper: issue(server) must start the request for one
+         * server and return a future for its reply. All requests are issued
+         * before any reply is awaited, so they are in flight together; the
+         * per-server results are returned indexed by server.
+         */
+        template<typename Result, typename Issue>
+        std::vector<Result> FanOut(Issue issue) {
+            uint16_t servers = Routing()->NumServers();
+            std::vector<std::future<Result>> pending;
+            pending.reserve(servers);
+            for (uint16_t server = 0; server < servers; ++server) {
+                pending.push_back(issue(server));
+            }
+            std::vector<Result> results;
+            results.reserve(servers);
+            for (auto &reply : pending) results.push_back(reply.get());
+            return results;
+        }
+
+        /* Wraps a value computed on the local path in an already-satisfied future. */
+        template<typename T>
+        static std::future<T> ReadyFuture(T value) {
+            std::promise<T> promise;
+            promise.set_value(std::move(value));
+            return promise.get_future();
+        }
+
+        /**
+         * k-way merge of runs that are each sorted by less. Ties keep the order
+         * of the runs, so merging per-server results stays deterministic.
+         */
+        template<typename T, typename Less>
+        static std::vector<T> MergeSorted(std::vector<std::vector<T>> &runs, Less less) {
+            size_t total = 0;
+            for (auto &run : runs) total += run.size();
+            std::vector<T> merged;
+            merged.reserve(total);
+            /* cursor = (run, position in run) */
+            typedef std::pair<size_t, size_t> Cursor;
+            auto after = [&runs, &less](const Cursor &a, const Cursor &b) {
+                const T &x = runs[a.first][a.second];
+                const T &y = runs[b.first][b.second];
+                if (less(y, x)) return true;
+                if (less(x, y)) return false;
+                return a.first > b.first;
+            };
+            std::priority_queue<Cursor, std::vector<Cursor>, decltype(after)> heap(after);
+            for (size_t i = 0; i < runs.size(); ++i) {
+                if (!runs[i].empty()) heap.emplace(i, 0);
+            }
+            while (!heap.empty()) {
+                Cursor cursor = heap.top();
+                heap.pop();
+                merged.push_back(std::move(runs[cursor.first][cursor.second]));
+                if (++cursor.second < runs[cursor.first].size()) heap.push(cursor);
+            }
+            return merged;
+        }
+
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        /**
+         * Values of at least HCL_CONF->RDMA_THRESHOLD bytes are not serialized
+         * into the RPC over RoCE: the client exposes its buffer and the server
+         * pulls or pushes the bytes straight into or out of the segment. Only
+         * trivially copyable values stored as-is (no SharedType) qualify.
+         */
+        template<typename Allocator, typename MappedType>
+        bool UseBulk() {
+            return std::is_trivially_copyable<MappedType>::value &&
+                   std::is_same<Allocator, nullptr_t>::value &&
+                   HCL_CONF->RPC_IMPLEMENTATION == THALLIUM_ROCE &&
+                   sizeof(MappedType) >= HCL_CONF->RDMA_THRESHOLD;
+        }
+
+        /* Calls funcname with the exposed value appended as a tl::bulk argument. */
+        template<typename Ret, typename MappedType, typename... Args>
+        Ret BulkCall(uint16_t server, const char *funcname, MappedType &value,
+                     tl::bulk_mode mode, Args... args) {
+            tl::bulk bulk_handle = rpc->prep_rdma_client(&value, sizeof(MappedType), mode);
+            return hcl::ReadResponse<Ret>(rpc->call<tl::packed_response>(server,
+                    rpc_procedures.Get(rpc, func_prefix.c_str(), funcname),
+                    args..., bulk_handle));
+        }
+#endif
+
+        /* Without an Allocator values are stored as-is: hand back the caller's
+         * object so a Put retried by GrowOnBadAlloc still sees the data. */
         template<typename Allocator, typename MappedType, typename SharedType>
-        typename std::enable_if_t<std::is_same<Allocator, nullptr_t>::value,MappedType>
+        typename std::enable_if_t<std::is_same<Allocator, nullptr_t>::value,MappedType &>
         GetData(MappedType & data){
-            return std::move(data);
+            return data;
         }
 
         template<typename Allocator, typename MappedType, typename SharedType>
@@ -56,14 +1189,25 @@ namespace hcl{
         }
 
         ~container(){
-            if (is_server)
+            WaitForMigration();
+            if (is_server && persistent)
+                segment.flush();
+            else if (is_server)
                 boost::interprocess::file_mapping::remove(backed_file.c_str());
         }
         container(CharStruct name_, uint16_t port): is_server(HCL_CONF->IS_SERVER), my_server(HCL_CONF->MY_SERVER),
                                                      num_servers(HCL_CONF->NUM_SERVERS),
                                                      comm_size(1), my_rank(0), memory_allocated(HCL_CONF->MEMORY_ALLOCATED),
                                                      name(name_), segment(), func_prefix(name_),
+                                                     routing(nullptr), next_routing(nullptr), seen_membership(0), membership_poll_due(INT64_MAX),
+                                                     migration_done(true), migration_failed(false), mutex(nullptr), info(nullptr), leases(nullptr),
+                                                     replication_factor(std::max<uint16_t>(1, std::min<uint16_t>(
+                                                             HCL_CONF->REPLICATION_FACTOR,
+                                                             std::min<uint16_t>(HCL_CONF->NUM_SERVERS, MAX_REPLICAS)))),
+                                                     in_flight(),
                                                      backed_file(HCL_CONF->BACKED_FILE_DIR + PATH_SEPARATOR + name_+"_"+std::to_string(my_server)),
+                                                     persistent(HCL_CONF->PERSISTENT), reopened(false), checkpoint_file(),
+                                                     journaled(HCL_CONF->JOURNAL_DIR.size() > 0), journal_file(), oplog(),
                                                      server_on_node(HCL_CONF->SERVER_ON_NODE){
             AutoTrace trace = AutoTrace("hcl::container");
             /* Initialize MPI rank and size of world */
@@ -72,24 +1216,72 @@ namespace hcl{
             /* create per server name for shared memory. Needed if multiple servers are
                spawned on one node*/
             this->name += "_" + std::to_string(my_server);
+            SetPartitioner(CreatePartitioner(HCL_CONF->PARTITIONER, num_servers,
+                                             HCL_CONF->VIRTUAL_NODES));
+            uint64_t initial_membership = membership{0, (uint16_t)num_servers, 0}.Pack();
+            seen_membership = initial_membership;
             /* if current rank is a server */
             rpc = hcl::Singleton<RPCFactory>::GetInstance()->GetRPC(port);
+            if (replication_factor > 1) {
+                in_flight.reset(new std::atomic<uint32_t>[num_servers]);
+                for (int server = 0; server < num_servers; ++server) in_flight[server] = 0;
+            }
+            if (HCL_CONF->CHECKPOINT_DIR.size() > 0)
+                checkpoint_file = HCL_CONF->CHECKPOINT_DIR + PATH_SEPARATOR + name_ + "_" + std::to_string(my_server);
+            if (journaled)
+                journal_file = HCL_CONF->JOURNAL_DIR + PATH_SEPARATOR + name_ + "_" + std::to_string(my_server) + ".journal";
             if (is_server) {
-                /* Delete existing instance of shared memory space*/
-                boost::interprocess::file_mapping::remove(backed_file.c_str());
-                /* allocate new shared memory space */
-                segment = boost::interprocess::managed_mapped_file(boost::interprocess::create_only, backed_file.c_str(), memory_allocated);
-                mutex = segment.construct<boost::interprocess::interprocess_mutex>("mtx")();
+                /* With a journal the state is rebuilt from the last checkpoint
+                 * and the log; the backing file may hold a torn update. */
+                if (journaled) boost::interprocess::file_mapping::remove(backed_file.c_str());
+                reopened = (persistent || journaled) && ReopenSegment();
+                really_long max_size = 0;
+                if (!reopened) {
+                    /* Delete existing instance of shared memory space*/
+                    boost::interprocess::file_mapping::remove(backed_file.c_str());
+                    /* allocate new shared memory space */
+                    segment = boost::interprocess::managed_mapped_file(boost::interprocess::create_only, backed_file.c_str(), memory_allocated);
+                    if (HCL_CONF->MAX_MEMORY_ALLOCATED > memory_allocated)
+                        max_size = ReserveSegment(HCL_CONF->MAX_MEMORY_ALLOCATED);
+                }
+                /* Structures find their objects in a reopened segment instead
+                 * of constructing them. */
+                mutex = segment.find_or_construct<segment_mutex>("mtx")(HCL_CONF->READ_WRITE_LOCK);
+                info = segment.find_or_construct<segment_info>("info")(max_size, initial_membership);
+                if (reopened) {
+                    new (mutex) segment_mutex(mutex->IsReadWrite());
+                    new (&info->handover) handover_keys();
+                    /* A restarted server starts over from the configured servers. */
+                    info->membership = initial_membership;
+                    info->migrating = false;
+                }
             }else if (!is_server && server_on_node) {
                 /* Map the clients to their respective memory pools */
                 segment = boost::interprocess::managed_mapped_file(
                         boost::interprocess::open_only, backed_file.c_str());
-                std::pair<boost::interprocess::interprocess_mutex *,
+                std::pair<segment_mutex *,
                         boost::interprocess::managed_mapped_file::size_type> res2;
-                res2 = segment.find<boost::interprocess::interprocess_mutex>("mtx");
+                res2 = segment.find<segment_mutex>("mtx");
                 mutex = res2.first;
+                info = segment.find<segment_info>("info").first;
             }
         }
+
+        /**
+         * Capacity statistics of this node's segment, for capacity planning.
+         * Only meaningful on the server and co-located clients.
+         */
+        segment_usage SegmentUsage() {
+            segment_usage usage = segment_usage();
+            if (!(server_on_node || is_server)) return usage;
+            NoteUsage();
+            usage.size = segment.get_size();
+            usage.used = usage.size - segment.get_free_memory();
+            usage.high_water_mark = info->high_water_mark.load();
+            usage.max_size = info->max_size;
+            usage.grow_count = info->grow_count.load();
+            return usage;
+        }
         void lock() {
             if (server_on_node || is_server) mutex->lock();
         }
@@ -0,0 +1,158 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INCLUDE_HCL_COMMON_DARY_HEAP_H_
+#define INCLUDE_HCL_COMMON_DARY_HEAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hcl {
+/* Whether T has the operator== that dary_heap::update searches with. */
+template<typename T, typename Enable = void>
+struct is_equality_comparable : std::false_type {};
+template<typename T>
+struct is_equality_comparable<T, decltype(void(std::declval<const T &>() == std::declval<const T &>()))>
+        : std::true_type {};
+
+/**
+ * Array-backed heap in which every node has Arity children. The top is
+ * ordered by Compare as in std::priority_queue: with std::less it is the
+ * largest element. A wider node makes the tree shallower, so a push or an
+ * increased priority climbs fewer levels, and the children a sift-down
+ * compares lie next to each other in memory. The storage takes an
+ * allocator, so the heap can be constructed in a shared segment.
+ */
+template<typename T, typename Compare, typename Allocator, size_t Arity>
+class dary_heap {
+    static_assert(Arity >= 2, "a heap node needs at least two children");
+  public:
+    typedef std::vector<T, Allocator> container_type;
+  private:
+    container_type heap;
+    Compare comp;
+
+    static size_t Parent(size_t i) { return (i - 1) / Arity; }
+    static size_t FirstChild(size_t i) { return i * Arity + 1; }
+
+    void SiftUp(size_t i) {
+        T value = std::move(heap[i]);
+        while (i > 0 && comp(heap[Parent(i)], value)) {
+            heap[i] = std::move(heap[Parent(i)]);
+            i = Parent(i);
+        }
+        heap[i] = std::move(value);
+    }
+
+    void SiftDown(size_t i) {
+        size_t size = heap.size();
+        T value = std::move(heap[i]);
+        for (size_t first = FirstChild(i); first < size; first = FirstChild(i)) {
+            size_t last = std::min(first + Arity, size);
+            size_t best = first;
+            for (size_t child = first + 1; child < last; ++child) {
+                if (comp(heap[best], heap[child])) best = child;
+            }
+            if (!comp(value, heap[best])) break;
+            heap[i] = std::move(heap[best]);
+            i = best;
+        }
+        heap[i] = std::move(value);
+    }
+
+  public:
+    dary_heap(const Compare &comp_, const Allocator &allocator) : heap(allocator), comp(comp_) {}
+
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+    const T &top() const { return heap.front(); }
+    const Compare &comparator() const { return comp; }
+
+    void reserve(size_t capacity) { heap.reserve(capacity); }
+
+    void push(const T &value) {
+        heap.push_back(value);
+        SiftUp(heap.size() - 1);
+    }
+
+    void pop() {
+        if (heap.size() > 1) heap.front() = std::move(heap.back());
+        heap.pop_back();
+        if (!heap.empty()) SiftDown(0);
+    }
+
+    /**
+     * Bulk insert in two steps: append adds a value without ordering it and
+     * restore then orders the last count values, either by sifting each of
+     * them up or, when that would cost more, by rebuilding the whole heap.
+     */
+    void append(const T &value) { heap.push_back(value); }
+
+    void restore(size_t count) {
+        size_t size = heap.size();
+        if (count == 0) return;
+        /* A rebuild costs about Arity/(Arity-1) * size comparisons, a sift-up
+         * up to the depth of the tree. */
+        size_t depth = 1;
+        for (size_t level = size; level > Arity; level /= Arity) depth++;
+        if (count * depth > 2 * size) {
+            for (size_t i = Parent(size - 1) + 1; i-- > 0;) SiftDown(i);
+        } else {
+            for (size_t i = size - count; i < size; ++i) SiftUp(i);
+        }
+    }
+
+    /**
+     * The first count elements in pop order, without removing them. Only
+     * the nodes whose parent was taken are candidates, so this visits about
+     * count * Arity nodes whatever the size of the heap.
+     */
+    std::vector<T> peek(size_t count) const {
+        std::vector<T> values;
+        values.reserve(std::min(count, heap.size()));
+        auto lower = [this](size_t a, size_t b) { return comp(heap[a], heap[b]); };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(lower)> frontier(lower);
+        if (!heap.empty()) frontier.push(0);
+        while (values.size() < count && !frontier.empty()) {
+            size_t i = frontier.top();
+            frontier.pop();
+            values.push_back(heap[i]);
+            size_t first = FirstChild(i);
+            size_t last = std::min(first + Arity, heap.size());
+            for (size_t child = first; child < last; ++child) frontier.push(child);
+        }
+        return values;
+    }
+
+    /**
+     * Replaces the first element equal to old_value by new_value and moves
+     * it up or down to its new place. Finding it is a linear scan, and
+     * only types with operator== (see is_equality_comparable) support it.
+     * @return bool, false if no element equals old_value
+     */
+    bool update(const T &old_value, const T &new_value) {
+        auto found = std::find(heap.begin(), heap.end(), old_value);
+        if (found == heap.end()) return false;
+        size_t i = found - heap.begin();
+        heap[i] = new_value;
+        if (comp(old_value, new_value)) SiftUp(i);
+        else SiftDown(i);
+        return true;
+    }
+};
+}  // namespace hcl
+
+#endif  // INCLUDE_HCL_COMMON_DARY_HEAP_H_
@@ -32,6 +32,9 @@
 #endif
 
 #include <string>
+#include <string_view>
+#include <cstring>
+#include <type_traits>
 #include <vector>
 #include <cstdint>
 #include <chrono>
@@ -40,93 +43,149 @@
 
 namespace bip = boost::interprocess;
 
-typedef struct CharStruct {
+/**
+ * A string of at most Capacity characters kept inline, so it can live in a
+ * shared memory segment and be used as a key. The length is stored next to
+ * the characters, so size(), comparisons, copies and hashing only touch the
+ * bytes in use; the buffer stays NUL terminated for c_str(). Input longer
+ * than Capacity is truncated.
+ */
+template<size_t Capacity>
+struct FixedString {
+  public:
+    typedef typename std::conditional<(Capacity <= UINT8_MAX), uint8_t,
+            typename std::conditional<(Capacity <= UINT16_MAX), uint16_t,
+                                      uint32_t>::type>::type size_type;
   private:
-    char value[256];
-    void Set(char* data_, size_t size) {
-        snprintf(this->value, size+1, "%s", data_);
+    size_type length;
+    char value[Capacity + 1];
+    void Set(const char* data_, size_t size) {
+        length = static_cast<size_type>(size < Capacity ? size : Capacity);
+        memcpy(value, data_, length);
+        value[length] = '\0';
     }
-    void Set(std::string data_) {
-        snprintf(this->value, data_.length()+1, "%s", data_.c_str());
+    void Append(const char* data_, size_t size) {
+        size_t room = Capacity - length;
+        if (size > room) size = room;
+        memcpy(value + length, data_, size);
+        length = static_cast<size_type>(length + size);
+        value[length] = '\0';
+    }
+    int Compare(const FixedString &o) const {
+        int result = memcmp(value, o.value,
+                            length < o.length ? length : o.length);
+        if (result != 0) return result;
+        return length < o.length ? -1 : (length > o.length ? 1 : 0);
     }
   public:
-    CharStruct() {}
-    CharStruct(const CharStruct &other) : CharStruct(other.value) {} /* copy constructor*/
-    CharStruct(CharStruct &&other) :CharStruct(other.value){} /* move constructor*/
+    FixedString() : length(0) { value[0] = '\0'; }
+    FixedString(const FixedString &other) { Set(other.value, other.length); } /* copy constructor*/
+    FixedString(FixedString &&other) { Set(other.value, other.length); } /* move constructor*/
 
+    FixedString(const char* data_) { Set(data_, strlen(data_)); }
+    FixedString(const std::string &data_) { Set(data_.data(), data_.size()); }
 
-    CharStruct(const char* data_) {
-        snprintf(this->value, strlen(data_)+1, "%s", data_);
-    }
-    CharStruct(std::string data_):CharStruct(data_.c_str()) {}
-
-    CharStruct(char* data_, size_t size) {
-        snprintf(this->value, size, "%s", data_);
+    /* Takes at most size-1 characters of data_, stopping at a NUL. */
+    FixedString(const char* data_, size_t size) {
+        Set(data_, size == 0 ? 0 : strnlen(data_, size - 1));
     }
     const char* c_str() const {
         return value;
     }
-  std::string string() const {
-    return std::string(value);
+    std::string string() const {
+        return std::string(value, length);
     }
 
     char* data() {
         return value;
     }
-    const size_t size() const {
-        return strlen(value);
+    const char* data() const {
+        return value;
+    }
+    size_t size() const {
+        return length;
+    }
+    static constexpr size_t capacity() {
+        return Capacity;
+    }
+    void assign(const char* data_, size_t size) {
+        Set(data_, size);
     }
     /**
    * Operators
    */
-    CharStruct &operator=(const CharStruct &other) {
-        strcpy(value,other.c_str());
+    FixedString &operator=(const FixedString &other) {
+        if (this != &other) Set(other.value, other.length);
         return *this;
     }
     /* equal operator for comparing two Chars. */
-    bool operator==(const CharStruct &o) const {
-        return strcmp(value, o.value) == 0;
+    bool operator==(const FixedString &o) const {
+        return length == o.length && memcmp(value, o.value, length) == 0;
+    }
+    bool operator!=(const FixedString &o) const {
+        return !(*this == o);
     }
-    CharStruct operator+(const CharStruct& o){
-        std::string added=std::string(this->c_str())+std::string(o.c_str());
-        return CharStruct(added);
+    FixedString operator+(const FixedString& o) const {
+        FixedString added(*this);
+        added.Append(o.value, o.length);
+        return added;
     }
-    CharStruct operator+(std::string &o)
-    {
-        std::string added=std::string(this->c_str())+o;
-        return CharStruct(added);
+    FixedString operator+(const std::string &o) const {
+        FixedString added(*this);
+        added.Append(o.data(), o.size());
+        return added;
     }
-    CharStruct& operator+=(const CharStruct& rhs){
-        std::string added=std::string(this->c_str())+std::string(rhs.c_str());
-        Set(added);
+    FixedString operator+(const char* o) const {
+        FixedString added(*this);
+        added.Append(o, strlen(o));
+        return added;
+    }
+    FixedString& operator+=(const FixedString& rhs){
+        Append(rhs.value, rhs.length);
         return *this;
     }
-    bool operator>(const CharStruct &o) const {
-        return  strcmp(this->value,o.c_str()) > 0;
+    bool operator>(const FixedString &o) const {
+        return Compare(o) > 0;
+    }
+    bool operator>=(const FixedString &o) const {
+        return Compare(o) >= 0;
     }
-    bool operator>=(const CharStruct &o) const {
-        return strcmp(this->value,o.c_str()) >= 0;
+    bool operator<(const FixedString &o) const {
+        return Compare(o) < 0;
     }
-    bool operator<(const CharStruct &o) const {
-        return strcmp(this->value,o.c_str()) < 0;
+    bool operator<=(const FixedString &o) const {
+        return Compare(o) <= 0;
     }
-    bool operator<=(const CharStruct &o) const {
-        return strcmp(this->value,o.c_str()) <= 0;
+
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+    /* Only the used characters go on the wire. */
+    template<typename A>
+    void save(A &ar) const {
+        ar.write(&length);
+        ar.write(value, length);
+    }
+    template<typename A>
+    void load(A &ar) {
+        ar.read(&length);
+        if (length > Capacity) length = static_cast<size_type>(Capacity);
+        ar.read(value, length);
+        value[length] = '\0';
     }
+#endif
+};
 
-} CharStruct;
+typedef FixedString<255> CharStruct;
 
-static CharStruct operator+(const std::string& a1, const CharStruct& a2) {
-    std::string added=a1+std::string(a2.c_str());
-    return CharStruct(added);
+template<size_t Capacity>
+FixedString<Capacity> operator+(const std::string& a1, const FixedString<Capacity>& a2) {
+    return FixedString<Capacity>(a1) + a2;
 }
 
 namespace std {
-template<>
-struct hash<CharStruct> {
-    size_t operator()(const CharStruct &k) const {
-        std::string val(k.c_str());
-        return std::hash<std::string>()(val);
+template<size_t Capacity>
+struct hash<FixedString<Capacity>> {
+    size_t operator()(const FixedString<Capacity> &k) const {
+        return std::hash<std::string_view>()(std::string_view(k.data(), k.size()));
     }
 };
 }
@@ -136,22 +195,20 @@ namespace clmdep_msgpack {
 MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
     namespace adaptor {
     namespace mv1 = clmdep_msgpack::v1;
-    template<>
-    struct convert<CharStruct> {
+    template<size_t Capacity>
+    struct convert<FixedString<Capacity>> {
         mv1::object const &operator()(mv1::object const &o,
-                                      CharStruct &input) const {
-            std::string v = std::string();
-            v.assign(o.via.str.ptr, o.via.str.size);
-            input = CharStruct(v);
+                                      FixedString<Capacity> &input) const {
+            input.assign(o.via.str.ptr, o.via.str.size);
             return o;
         }
     };
 
-    template<>
-    struct pack<CharStruct> {
+    template<size_t Capacity>
+    struct pack<FixedString<Capacity>> {
         template<typename Stream>
         packer <Stream> &operator()(mv1::packer <Stream> &o,
-                                    CharStruct const &input) const {
+                                    FixedString<Capacity> const &input) const {
             uint32_t size = checked_get_container_size(input.size());
             o.pack_str(size);
             o.pack_str_body(input.c_str(), size);
@@ -159,10 +216,10 @@ MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
         }
     };
 
-    template<>
-    struct object_with_zone<CharStruct> {
+    template<size_t Capacity>
+    struct object_with_zone<FixedString<Capacity>> {
         void operator()(mv1::object::with_zone &o,
-                        CharStruct const &input) const {
+                        FixedString<Capacity> const &input) const {
             uint32_t size = checked_get_container_size(input.size());
             o.type = clmdep_msgpack::type::STR;
             char *ptr = static_cast<char *>(
@@ -195,7 +252,8 @@ std::ostream &operator<<(std::ostream &os, uint8_t const &m) {
     return os << std::to_string(m);
 }
 
-std::ostream &operator<<(std::ostream &os, CharStruct const &m){
+template<size_t Capacity>
+std::ostream &operator<<(std::ostream &os, FixedString<Capacity> const &m){
     return os   << "{TYPE:CharStruct," << "value:" << m.c_str()<<"}";
 }
 
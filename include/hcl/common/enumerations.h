@@ -19,4 +19,18 @@ typedef enum RPCImplementation {
   THALLIUM_ROCE = 2
 } RPCImplementation;
 
+typedef enum PartitionerType {
+  MODULO_PARTITIONER = 0,
+  CONSISTENT_HASH_PARTITIONER = 1
+} PartitionerType;
+
+/* Operation codes of journal records. */
+typedef enum JournalOp {
+  JOURNAL_PUT = 1,
+  JOURNAL_ERASE = 2,
+  JOURNAL_PUSH = 3,
+  JOURNAL_POP = 4,
+  JOURNAL_UPDATE = 5
+} JournalOp;
+
 #endif //INCLUDE_HCL_COMMON_ENUMERATIONS_H
@@ -0,0 +1,88 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INCLUDE_HCL_COMMON_HLC_H_
+#define INCLUDE_HCL_COMMON_HLC_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <hcl/common/typedefs.h>
+
+namespace hcl {
+/* A hybrid logical clock timestamp keeps microseconds of physical time in
+ * its upper bits and a logical counter in the lower HLC_LOGICAL_BITS. */
+const int HLC_LOGICAL_BITS = 16;
+
+/**
+ * Hybrid logical clock (Kulkarni et al.) kept in one 64-bit word, which may
+ * live in a shared segment so that all processes of a node share it. With
+ * both parts in one word, a timestamp is taken with a single compare-and-swap
+ * and timestamps compare as integers. A full logical counter carries into
+ * the physical part, which keeps the order.
+ */
+class hlc {
+  private:
+    std::atomic<uint64_t> *state;
+  public:
+    explicit hlc(std::atomic<uint64_t> *state_) : state(state_) {}
+
+    /* Local or send event: later than every timestamp this clock gave out. */
+    HTime Tick(HTime physical) { return Merge(0, physical); }
+
+    /* Receive event: later than both this clock and the remote timestamp. */
+    HTime Merge(HTime remote, HTime physical) {
+        uint64_t floor = physical << HLC_LOGICAL_BITS;
+        uint64_t current = state->load(std::memory_order_relaxed), next;
+        do {
+            uint64_t latest = std::max<uint64_t>(current, remote);
+            next = latest >= floor ? latest + 1 : floor;
+        } while (!state->compare_exchange_weak(current, next, std::memory_order_acq_rel,
+                                               std::memory_order_relaxed));
+        return next;
+    }
+
+    static HTime Physical(HTime timestamp) { return timestamp >> HLC_LOGICAL_BITS; }
+    static HTime Logical(HTime timestamp) { return timestamp & ((HTime(1) << HLC_LOGICAL_BITS) - 1); }
+};
+
+/**
+ * With HCL_CONF->HLC_PIGGYBACK set, every RPC response carries a timestamp
+ * of the responder's clock, which the caller merges into its own clock, so
+ * that anything a process does after a call is ordered after what the
+ * server did before answering. A process registers the clock to use;
+ * without one, responses carry 0 and nothing is merged.
+ */
+class hlc_source {
+  public:
+    virtual ~hlc_source() {}
+    virtual HTime Now() = 0;
+    virtual HTime Update(HTime remote) = 0;
+};
+
+inline std::atomic<hlc_source *> &PiggybackClock() {
+    static std::atomic<hlc_source *> clock(nullptr);
+    return clock;
+}
+
+inline HTime PiggybackStamp() {
+    hlc_source *clock = PiggybackClock().load(std::memory_order_acquire);
+    return clock == nullptr ? 0 : clock->Now();
+}
+
+inline void PiggybackMerge(HTime stamp) {
+    hlc_source *clock = PiggybackClock().load(std::memory_order_acquire);
+    if (clock != nullptr && stamp != 0) clock->Update(stamp);
+}
+}  // namespace hcl
+
+#endif  // INCLUDE_HCL_COMMON_HLC_H_
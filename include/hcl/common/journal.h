@@ -0,0 +1,368 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INCLUDE_HCL_COMMON_JOURNAL_H_
+#define INCLUDE_HCL_COMMON_JOURNAL_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <hcl/common/data_structures.h>
+
+namespace hcl {
+/**
+ * How a type is written into journal records. Trivially copyable types are
+ * copied byte for byte and strings are stored with their length; other
+ * types can be journaled by specializing journal_codec for them. Containers
+ * whose key or value type has no codec cannot be journaled.
+ */
+template<typename T, typename Enable = void>
+struct journal_codec {
+    static const bool supported = false;
+};
+
+template<typename T>
+struct journal_codec<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> {
+    static const bool supported = true;
+    static void Encode(std::vector<char> &out, const T &value) {
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+    static bool Decode(const char *&in, const char *end, T &value) {
+        if (end - in < static_cast<ptrdiff_t>(sizeof(T))) return false;
+        memcpy(reinterpret_cast<void *>(&value), in, sizeof(T));
+        in += sizeof(T);
+        return true;
+    }
+};
+
+/* Strings: a 32-bit length followed by the characters. */
+template<typename String>
+struct journal_string_codec {
+    static const bool supported = true;
+    static void Encode(std::vector<char> &out, const String &value) {
+        journal_codec<uint32_t>::Encode(out, static_cast<uint32_t>(value.size()));
+        out.insert(out.end(), value.data(), value.data() + value.size());
+    }
+    static bool Decode(const char *&in, const char *end, String &value) {
+        uint32_t length;
+        if (!journal_codec<uint32_t>::Decode(in, end, length) || end - in < static_cast<ptrdiff_t>(length)) return false;
+        value.assign(in, length);
+        in += length;
+        return true;
+    }
+};
+template<>
+struct journal_codec<std::string> : journal_string_codec<std::string> {};
+template<size_t Capacity>
+struct journal_codec<FixedString<Capacity>> : journal_string_codec<FixedString<Capacity>> {};
+
+/* Builds one record: an operation code followed by its operands. */
+class journal_record {
+  private:
+    std::vector<char> bytes;
+  public:
+    explicit journal_record(uint8_t op) : bytes(1, static_cast<char>(op)) {}
+    template<typename T>
+    journal_record &operator<<(const T &value) {
+        journal_codec<T>::Encode(bytes, value);
+        return *this;
+    }
+    const std::vector<char> &Bytes() const { return bytes; }
+};
+
+/* Reads back the operands of a record in the order they were written. */
+class journal_reader {
+  private:
+    const char *position, *end;
+    bool valid;
+  public:
+    journal_reader(const char *data, size_t size) : position(data), end(data + size), valid(size > 0) {}
+    uint8_t Op() {
+        uint8_t op = 0;
+        valid = valid && journal_codec<uint8_t>::Decode(position, end, op);
+        return op;
+    }
+    template<typename T>
+    journal_reader &operator>>(T &value) {
+        valid = valid && journal_codec<T>::Decode(position, end, value);
+        return *this;
+    }
+    /* False if any operand ran past the end of the record. */
+    bool Valid() const { return valid; }
+};
+
+/**
+ * Per-server operation log with group commit. Updates append a record while
+ * they hold the lock of the data they changed, so the log has the order in
+ * which updates were applied, and call Commit once the lock is released.
+ * The first committer writes every record appended so far and makes them
+ * durable with a single fdatasync; committers arriving meanwhile wait for
+ * that sync or lead the next one, so under load one sync covers the updates
+ * of many handler threads. Each record is framed with its length, a
+ * checksum so a record torn by a crash is detected and dropped on replay,
+ * and a sequence number that keeps counting across truncations, so replay
+ * can skip the records a checkpoint already holds.
+ * A batch that cannot be written is cut off the file again and its
+ * committers are told, so nothing after it is lost on replay and no update
+ * is acknowledged that is not on disk.
+ */
+class journal {
+  private:
+    std::string path;
+    int fd;
+    std::mutex mutex;
+    std::condition_variable synced;
+    std::vector<char> pending;
+    /* The thread that appended each pending record, and its number. */
+    std::vector<std::pair<std::thread::id, uint64_t>> writers;
+    /* Records up to flushed were written or refused. */
+    std::atomic<uint64_t> appended;
+    uint64_t flushed;
+    /* The last refused record of each thread that had one. */
+    std::unordered_map<std::thread::id, uint64_t> refused;
+    /* Length of the intact log; a failed write is cut back to it. */
+    off_t file_size;
+    /* Set if a torn batch could not be cut off: nothing more is written. */
+    bool broken;
+    bool flushing;
+
+    /* Header written in front of every record. */
+    struct Frame {
+        uint32_t size;
+        uint32_t checksum;
+        uint64_t seq;
+    };
+
+    static uint32_t Checksum(const char *data, size_t size, uint32_t hash = 2166136261u) {
+        for (size_t i = 0; i < size; ++i) hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+        return hash;
+    }
+
+    /* The journal this thread appended to last, and that record's number. */
+    struct Tail {
+        const journal *log;
+        uint64_t seq;
+    };
+    static Tail &LastAppended() {
+        static thread_local Tail tail{nullptr, 0};
+        return tail;
+    }
+
+    static bool WriteAll(int fd, const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t written = write(fd, data, size);
+            if (written <= 0) return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+  public:
+    /* Records are numbered on from first_seq, see Replay. */
+    explicit journal(const std::string &path_, uint64_t first_seq = 0)
+            : path(path_), fd(-1), mutex(), synced(), pending(), writers(), appended(first_seq), flushed(first_seq),
+              refused(), file_size(0), broken(false), flushing(false) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) printf("Error: Can't open journal %s, updates are not logged\n", path.c_str());
+        else file_size = lseek(fd, 0, SEEK_END);
+    }
+    journal(const journal &) = delete;
+    journal &operator=(const journal &) = delete;
+    ~journal() {
+        Flush(appended);
+        if (fd >= 0) close(fd);
+    }
+
+    void Append(const journal_record &record) {
+        const std::vector<char> &bytes = record.Bytes();
+        Frame frame = {static_cast<uint32_t>(bytes.size()), Checksum(bytes.data(), bytes.size()), 0};
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fd < 0) return;
+        frame.seq = ++appended;
+        frame.checksum = Checksum(reinterpret_cast<const char *>(&frame.seq), sizeof(frame.seq), frame.checksum);
+        const char *header = reinterpret_cast<const char *>(&frame);
+        pending.insert(pending.end(), header, header + sizeof(frame));
+        pending.insert(pending.end(), bytes.begin(), bytes.end());
+        writers.emplace_back(std::this_thread::get_id(), frame.seq);
+        LastAppended() = Tail{this, frame.seq};
+    }
+
+    /* Sequence number of the last record appended. */
+    uint64_t Appended() {
+        return appended.load();
+    }
+
+    /**
+     * Returns once the records this thread appended are on disk.
+     * @param since, records up to this one belong to earlier operations and
+     * are not reported, see journal_commit
+     * @return bool, false if one appended after since could not be written
+     */
+    bool Commit(uint64_t since) {
+        Tail tail = LastAppended();
+        if (tail.log != this || tail.seq <= since) return true;
+        Flush(tail.seq);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto last_refused = refused.find(std::this_thread::get_id());
+        return last_refused == refused.end() || last_refused->second <= since;
+    }
+
+    /* Returns once the first target records were written or refused. */
+    void Flush(uint64_t target) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (flushed < target) {
+            if (flushing) {
+                synced.wait(lock);
+                continue;
+            }
+            flushing = true;
+            std::vector<char> batch;
+            std::vector<std::pair<std::thread::id, uint64_t>> batch_writers;
+            batch.swap(pending);
+            batch_writers.swap(writers);
+            uint64_t batch_start = flushed, batch_end = appended;
+            lock.unlock();
+            bool written = !broken && WriteAll(fd, batch.data(), batch.size()) && fdatasync(fd) == 0;
+            if (written) {
+                file_size += batch.size();
+            } else if (!broken) {
+                printf("Error: Can't write journal %s, the last %zu updates are refused\n",
+                       path.c_str(), static_cast<size_t>(batch_end - batch_start));
+                /* Without the torn frame, later batches replay after the
+                 * intact ones instead of being cut off with it. */
+                if (ftruncate(fd, file_size) != 0 || fdatasync(fd) != 0) {
+                    printf("Error: Can't cut journal %s back, refusing all further updates\n", path.c_str());
+                    broken = true;
+                }
+            }
+            lock.lock();
+            if (!written) {
+                for (auto &writer : batch_writers) {
+                    uint64_t &last_refused = refused[writer.first];
+                    last_refused = std::max(last_refused, writer.second);
+                }
+            }
+            flushed = batch_end;
+            flushing = false;
+            synced.notify_all();
+        }
+    }
+
+    /**
+     * Drops every record, once a checkpoint holds their effects. Callers
+     * hold the locks of all logged data, so nothing is appended meanwhile.
+     * Sequence numbers go on from where they were.
+     */
+    void Truncate() {
+        std::unique_lock<std::mutex> lock(mutex);
+        synced.wait(lock, [this]() { return !flushing; });
+        pending.clear();
+        writers.clear();
+        /* The checkpoint holds the effects of refused records too. */
+        flushed = appended;
+        refused.clear();
+        if (fd >= 0 && (ftruncate(fd, 0) != 0 || fdatasync(fd) != 0)) {
+            printf("Error: Can't truncate journal %s\n", path.c_str());
+        } else {
+            file_size = 0;
+            broken = false;
+        }
+        synced.notify_all();
+    }
+
+    /**
+     * Calls apply(journal_reader &) for every intact record in the log at
+     * path numbered after covered, oldest first, and cuts the log off
+     * before a torn tail.
+     * @return uint64_t, the last sequence number in the log or covered,
+     * whichever is larger; the journal reopened on path numbers on from it
+     */
+    template<typename Apply>
+    static uint64_t Replay(const std::string &path, uint64_t covered, Apply apply) {
+        int in = open(path.c_str(), O_RDWR);
+        if (in < 0) return covered;
+        std::vector<char> log;
+        char buffer[1 << 16];
+        ssize_t length;
+        while ((length = read(in, buffer, sizeof(buffer))) > 0) log.insert(log.end(), buffer, buffer + length);
+        size_t offset = 0;
+        uint64_t last = covered;
+        while (log.size() - offset >= sizeof(Frame)) {
+            Frame frame;
+            memcpy(&frame, log.data() + offset, sizeof(frame));
+            const char *record = log.data() + offset + sizeof(frame);
+            if (log.size() - offset - sizeof(frame) < frame.size) break;
+            uint32_t checksum = Checksum(reinterpret_cast<const char *>(&frame.seq), sizeof(frame.seq),
+                                         Checksum(record, frame.size));
+            if (checksum != frame.checksum) break;
+            if (frame.seq > covered) {
+                journal_reader reader(record, frame.size);
+                apply(reader);
+            }
+            last = std::max(last, frame.seq);
+            offset += sizeof(frame) + frame.size;
+        }
+        if (offset < log.size()) {
+            printf("Error: Dropping %zu bytes of torn records at the end of journal %s\n",
+                   log.size() - offset, path.c_str());
+            if (ftruncate(in, offset) != 0) printf("Error: Can't truncate journal %s\n", path.c_str());
+        }
+        close(in);
+        return last;
+    }
+};
+/**
+ * Commits what the calling thread appended to a journal when it goes out of
+ * scope. Updates declare it before taking their locks, so the sync happens
+ * after the locks are released but before the reply is sent. Updates that
+ * can report a failure call Done once their locks are released and answer
+ * as if they had failed when it returns false; their change stays in
+ * memory but is gone after a restart. Only records appended after it was
+ * declared count, so a refused record of an earlier update is not reported
+ * again.
+ */
+class journal_commit {
+  private:
+    journal *log;
+    uint64_t since;
+  public:
+    explicit journal_commit(journal *log_) : log(log_), since(log_ == nullptr ? 0 : log_->Appended()) {}
+    journal_commit(const journal_commit &) = delete;
+    journal_commit &operator=(const journal_commit &) = delete;
+    ~journal_commit() {
+        if (log != nullptr) log->Commit(since);
+    }
+
+    /* Commits now; false if the updates are not on disk. */
+    bool Done() {
+        journal *committing = log;
+        log = nullptr;
+        return committing == nullptr || committing->Commit(since);
+    }
+};
+}  // namespace hcl
+
+#endif  // INCLUDE_HCL_COMMON_JOURNAL_H_
@@ -18,19 +18,19 @@
 # define EXPAND_ARGS(...) __VA_ARGS__
 #define HCL_CONF hcl::Singleton<hcl::ConfigurationManager>::GetInstance()
 
-#define THALLIUM_DEFINE(name, args,args_t...) void Thallium##name(const tl::request &thallium_req, args_t) { thallium_req.respond(name args ); }
+#define THALLIUM_DEFINE(name, args,args_t...) void Thallium##name(const tl::request &thallium_req, args_t) { hcl::SendResponse(thallium_req, name args ); }
 
-#define THALLIUM_DEFINE1(name) void Thallium##name(const tl::request &thallium_req) { thallium_req.respond(name()); }
+#define THALLIUM_DEFINE1(name) void Thallium##name(const tl::request &thallium_req) { hcl::SendResponse(thallium_req, name()); }
 
 #ifdef HCL_ENABLE_RPCLIB
 #define RPC_CALL_WRAPPER_RPCLIB1(funcname, serverVar,ret) \
  case RPCLIB: {								\
-    return rpc->call<RPCLIB_MSGPACK::object_handle>( serverVar , func_prefix + std::string(funcname) ).template as< ret >(); \
+    return hcl::ReadResponse< ret >(rpc->call<RPCLIB_MSGPACK::object_handle>( serverVar , rpc_procedures.Get(rpc, func_prefix.c_str(), funcname) )); \
     break;\
   }
 #define RPC_CALL_WRAPPER_RPCLIB(funcname, serverVar,ret,args...)			\
  case RPCLIB: {								\
-  return rpc->call<RPCLIB_MSGPACK::object_handle>( serverVar , func_prefix + std::string(funcname) ,args).template as< ret >(); \
+  return hcl::ReadResponse< ret >(rpc->call<RPCLIB_MSGPACK::object_handle>( serverVar , rpc_procedures.Get(rpc, func_prefix.c_str(), funcname) ,args)); \
     break;\
   }
 #else
@@ -40,12 +40,12 @@
 #ifdef HCL_ENABLE_RPCLIB
 #define RPC_CALL_WRAPPER_RPCLIB1_CB(funcname, serverVar,ret) \
  case RPCLIB: {								\
-    return rpc->call<RPCLIB_MSGPACK::object_handle>( serverVar , funcname , std::forward< CB_Args >( cb_args )...).template as< ret >();\
+    return hcl::ReadResponse< ret >(rpc->call<RPCLIB_MSGPACK::object_handle>( serverVar , funcname , std::forward< CB_Args >( cb_args )...));\
     break;\
   }
 #define RPC_CALL_WRAPPER_RPCLIB_CB(funcname, serverVar,ret, ...)			\
  case RPCLIB: {								\
-  return rpc->call<RPCLIB_MSGPACK::object_handle>( serverVar , funcname , __VA_ARGS__ , std::forward< CB_Args >( cb_args )...).template as< ret >();\
+  return hcl::ReadResponse< ret >(rpc->call<RPCLIB_MSGPACK::object_handle>( serverVar , funcname , __VA_ARGS__ , std::forward< CB_Args >( cb_args )...));\
     break;\
   }
 #else
@@ -66,12 +66,12 @@
 #if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
 #define RPC_CALL_WRAPPER_THALLIUM1(funcname, serverVar,ret)\
 {\
- return rpc->call<tl::packed_response>( serverVar , func_prefix + funcname ).template as< ret >(); \
+ return hcl::ReadResponse< ret >(rpc->call<tl::packed_response>( serverVar , rpc_procedures.Get(rpc, func_prefix.c_str(), funcname) )); \
  break;\
  }
 #define RPC_CALL_WRAPPER_THALLIUM(funcname, serverVar,ret,args...)	\
 {\
- return rpc->call<tl::packed_response>( serverVar , func_prefix + funcname ,args ).template as< ret >(); \
+ return hcl::ReadResponse< ret >(rpc->call<tl::packed_response>( serverVar , rpc_procedures.Get(rpc, func_prefix.c_str(), funcname) ,args )); \
  break;\
  }
 #else
@@ -80,6 +80,43 @@
 #endif
 
 
+/* Asynchronous variants: the request is sent immediately and the returned
+ * std::future< ret > blocks on the reply only when get() is called. */
+#ifdef HCL_ENABLE_RPCLIB
+#define RPC_CALL_WRAPPER_ASYNC_RPCLIB1(funcname, serverVar,ret) \
+ case RPCLIB: {								\
+    auto pending = rpc->async_call<RPCLIB_MSGPACK::object_handle>( serverVar , rpc_procedures.Get(rpc, func_prefix.c_str(), funcname) ); \
+    return std::async(std::launch::deferred, [](std::future<RPCLIB_MSGPACK::object_handle> reply) -> ret { \
+        return hcl::ReadResponse< ret >(reply.get()); }, std::move(pending)); \
+  }
+#define RPC_CALL_WRAPPER_ASYNC_RPCLIB(funcname, serverVar,ret,args...)	\
+ case RPCLIB: {								\
+    auto pending = rpc->async_call<RPCLIB_MSGPACK::object_handle>( serverVar , rpc_procedures.Get(rpc, func_prefix.c_str(), funcname) ,args); \
+    return std::async(std::launch::deferred, [](std::future<RPCLIB_MSGPACK::object_handle> reply) -> ret { \
+        return hcl::ReadResponse< ret >(reply.get()); }, std::move(pending)); \
+  }
+#else
+#define RPC_CALL_WRAPPER_ASYNC_RPCLIB1(funcname, serverVar,ret)
+#define RPC_CALL_WRAPPER_ASYNC_RPCLIB(funcname, serverVar,ret,args...)
+#endif
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+#define RPC_CALL_WRAPPER_ASYNC_THALLIUM1(funcname, serverVar,ret)\
+{\
+ auto pending = rpc->async_call<tl::packed_response>( serverVar , rpc_procedures.Get(rpc, func_prefix.c_str(), funcname) ); \
+ return std::async(std::launch::deferred, [](std::future<tl::packed_response> reply) -> ret { \
+     return hcl::ReadResponse< ret >(reply.get()); }, std::move(pending)); \
+ }
+#define RPC_CALL_WRAPPER_ASYNC_THALLIUM(funcname, serverVar,ret,args...)	\
+{\
+ auto pending = rpc->async_call<tl::packed_response>( serverVar , rpc_procedures.Get(rpc, func_prefix.c_str(), funcname) ,args ); \
+ return std::async(std::launch::deferred, [](std::future<tl::packed_response> reply) -> ret { \
+     return hcl::ReadResponse< ret >(reply.get()); }, std::move(pending)); \
+ }
+#else
+#define RPC_CALL_WRAPPER_ASYNC_THALLIUM1(funcname, serverVar,ret)
+#define RPC_CALL_WRAPPER_ASYNC_THALLIUM(funcname, serverVar,ret,args...)
+#endif
+
 #define RPC_CALL_WRAPPER1(funcname, serverVar,ret) [& ]()-> ret { \
 switch (HCL_CONF->RPC_IMPLEMENTATION) {\
 RPC_CALL_WRAPPER_RPCLIB1(funcname, serverVar,ret) \
@@ -96,6 +133,22 @@ RPC_CALL_WRAPPER_THALLIUM_ROCE()\
     RPC_CALL_WRAPPER_THALLIUM(funcname, serverVar,ret,args)	\
 }\
   }();
+#define RPC_CALL_WRAPPER_ASYNC1(funcname, serverVar,ret) [& ]()-> std::future< ret > { \
+switch (HCL_CONF->RPC_IMPLEMENTATION) {\
+RPC_CALL_WRAPPER_ASYNC_RPCLIB1(funcname, serverVar,ret) \
+RPC_CALL_WRAPPER_THALLIUM_TCP()\
+RPC_CALL_WRAPPER_THALLIUM_ROCE()\
+RPC_CALL_WRAPPER_ASYNC_THALLIUM1(funcname, serverVar,ret)\
+ }\
+}();
+#define RPC_CALL_WRAPPER_ASYNC(funcname, serverVar,ret, args...) [& ]()-> std::future< ret > { \
+switch (HCL_CONF->RPC_IMPLEMENTATION) {\
+  RPC_CALL_WRAPPER_ASYNC_RPCLIB(funcname, serverVar,ret,args)	\
+RPC_CALL_WRAPPER_THALLIUM_TCP()\
+RPC_CALL_WRAPPER_THALLIUM_ROCE()\
+    RPC_CALL_WRAPPER_ASYNC_THALLIUM(funcname, serverVar,ret,args)	\
+}\
+  }();
 #define RPC_CALL_WRAPPER1_CB(funcname, serverVar,ret) [&]()-> ret { \
 switch (HCL_CONF->RPC_IMPLEMENTATION) {\
 RPC_CALL_WRAPPER_RPCLIB1(funcname, serverVar,ret) \
@@ -0,0 +1,146 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INCLUDE_HCL_COMMON_PARTITIONER_H_
+#define INCLUDE_HCL_COMMON_PARTITIONER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <hcl/common/enumerations.h>
+
+namespace hcl {
+/**
+ * Maps a key's hash to the server that owns the key. Every process must use
+ * the same partitioner for a container, so it is chosen from HCL_CONF when
+ * the container is built.
+ */
+class partitioner {
+  public:
+    virtual ~partitioner() {}
+    virtual uint16_t GetServer(size_t key_hash) const = 0;
+    virtual uint16_t NumServers() const = 0;
+    /**
+     * The same placement over a different number of servers, used when
+     * servers join or leave. Returns nullptr if the scheme moves too many
+     * keys on a resize to support it.
+     */
+    virtual std::shared_ptr<partitioner> Resize(uint16_t) const {
+        return nullptr;
+    }
+    /**
+     * The servers holding copies of a key, its owner first: up to count
+     * distinct servers are written to servers.
+     * @return how many servers were written
+     */
+    virtual uint16_t GetReplicas(size_t key_hash, uint16_t count, uint16_t *servers) const {
+        uint16_t total = NumServers();
+        uint16_t found = std::min(count, total);
+        uint16_t owner = GetServer(key_hash);
+        for (uint16_t i = 0; i < found; ++i) servers[i] = static_cast<uint16_t>((owner + i) % total);
+        return found;
+    }
+
+    /* splitmix64 finalizer: spreads every input bit over the whole word. */
+    static inline uint64_t Mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+    }
+};
+
+/* The original placement, key_hash % num_servers. */
+class modulo_partitioner : public partitioner {
+  private:
+    uint16_t num_servers;
+  public:
+    explicit modulo_partitioner(uint16_t num_servers_) : num_servers(num_servers_) {}
+    uint16_t GetServer(size_t key_hash) const override {
+        return static_cast<uint16_t>(key_hash % num_servers);
+    }
+    uint16_t NumServers() const override { return num_servers; }
+};
+
+/**
+ * Consistent-hash ring. Each server owns virtual_nodes points on a 64-bit
+ * ring, and a key belongs to the first point at or after its mixed hash. A
+ * server's points depend only on its index, so going from N to N+1 servers
+ * only moves the keys the new server's points take over, about 1/(N+1) of
+ * them. More virtual nodes give a more even split at the cost of a larger
+ * table to search.
+ */
+class consistent_hash_partitioner : public partitioner {
+  private:
+    uint16_t num_servers, virtual_nodes;
+    std::vector<uint64_t> points;
+    std::vector<uint16_t> owners;
+  public:
+    consistent_hash_partitioner(uint16_t num_servers_, uint16_t virtual_nodes_)
+            : num_servers(num_servers_), virtual_nodes(virtual_nodes_ > 0 ? virtual_nodes_ : 1) {
+        std::vector<std::pair<uint64_t, uint16_t>> ring;
+        ring.reserve((size_t)num_servers * virtual_nodes);
+        for (uint16_t server = 0; server < num_servers; ++server) {
+            for (uint16_t node = 0; node < virtual_nodes; ++node) {
+                uint64_t seed = ((uint64_t)server << 32) | node;
+                ring.emplace_back(Mix(seed ^ 0x9E3779B97F4A7C15ULL), server);
+            }
+        }
+        std::sort(ring.begin(), ring.end());
+        points.reserve(ring.size());
+        owners.reserve(ring.size());
+        for (auto &point : ring) {
+            points.push_back(point.first);
+            owners.push_back(point.second);
+        }
+    }
+    uint16_t GetServer(size_t key_hash) const override {
+        if (num_servers <= 1 || points.empty()) return 0;
+        auto it = std::lower_bound(points.begin(), points.end(), Mix(key_hash));
+        if (it == points.end()) it = points.begin();
+        return owners[it - points.begin()];
+    }
+    uint16_t NumServers() const override { return num_servers; }
+    /* Replicas are the next distinct servers clockwise from the key. */
+    uint16_t GetReplicas(size_t key_hash, uint16_t count, uint16_t *servers) const override {
+        uint16_t wanted = std::min(count, num_servers);
+        if (num_servers <= 1 || points.empty()) {
+            servers[0] = 0;
+            return wanted > 0 ? 1 : 0;
+        }
+        size_t start = std::lower_bound(points.begin(), points.end(), Mix(key_hash)) - points.begin();
+        uint16_t found = 0;
+        for (size_t step = 0; step < points.size() && found < wanted; ++step) {
+            uint16_t server = owners[(start + step) % points.size()];
+            if (std::find(servers, servers + found, server) == servers + found) servers[found++] = server;
+        }
+        return found;
+    }
+    std::shared_ptr<partitioner> Resize(uint16_t num_servers_) const override {
+        return std::make_shared<consistent_hash_partitioner>(num_servers_, virtual_nodes);
+    }
+};
+
+inline std::shared_ptr<partitioner> CreatePartitioner(PartitionerType type,
+                                                      uint16_t num_servers,
+                                                      uint16_t virtual_nodes) {
+    if (type == MODULO_PARTITIONER)
+        return std::make_shared<modulo_partitioner>(num_servers);
+    return std::make_shared<consistent_hash_partitioner>(num_servers, virtual_nodes);
+}
+}  // namespace hcl
+
+#endif  // INCLUDE_HCL_COMMON_PARTITIONER_H_
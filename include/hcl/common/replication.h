@@ -0,0 +1,160 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INCLUDE_HCL_COMMON_REPLICATION_H_
+#define INCLUDE_HCL_COMMON_REPLICATION_H_
+
+#include <hcl/common/constants.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace hcl {
+/**
+ * Updates a primary server still has to send to its replicas. Writers push
+ * an operation per replica while holding the lock of the data they changed,
+ * so each replica's queue is in the order the updates were applied. A
+ * background thread sends everything queued for a replica in one call;
+ * while a batch is in flight the next one accumulates.
+ *
+ * A batch a replica did not take goes back in front of its queue and is
+ * sent again every REPLICATION_RETRY_MS, so a replica that was down gets
+ * every update it missed, in order. Updates are only given up when the
+ * queue is destroyed while its replica is still unreachable.
+ */
+template<typename Op>
+class replication_queue {
+  public:
+    /* Sends a batch to one replica and returns whether it was applied;
+     * called from the background thread. */
+    typedef std::function<bool(uint16_t, std::vector<Op> &)> Sender;
+  private:
+    typedef std::chrono::steady_clock clock;
+    Sender send;
+    std::mutex mutex;
+    std::condition_variable ready, drained;
+    std::vector<std::vector<Op>> pending;
+    /* Per replica: when its failed batch is sent again, and whether the
+     * last send failed, so a failure is reported once until it recovers. */
+    std::vector<clock::time_point> retry_at;
+    std::vector<bool> failing;
+    size_t queued;
+    bool sending, stop;
+    std::thread worker;
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            /* Take what is queued for every replica not waiting to retry;
+             * once stopping, failed batches get one last attempt. */
+            clock::time_point now = clock::now(), wake = clock::time_point::max();
+            std::vector<std::vector<Op>> batch(pending.size());
+            bool any = false;
+            for (uint16_t server = 0; server < pending.size(); ++server) {
+                if (pending[server].empty()) continue;
+                if (stop || retry_at[server] <= now) {
+                    batch[server].swap(pending[server]);
+                    queued -= batch[server].size();
+                    any = true;
+                } else {
+                    wake = std::min(wake, retry_at[server]);
+                }
+            }
+            if (!any) {
+                if (stop) return;
+                if (wake == clock::time_point::max()) ready.wait(lock);
+                else ready.wait_until(lock, wake);
+                continue;
+            }
+            sending = true;
+            lock.unlock();
+            std::vector<std::string> errors(batch.size());
+            for (uint16_t server = 0; server < batch.size(); ++server) {
+                if (batch[server].empty()) continue;
+                try {
+                    if (!send(server, batch[server])) errors[server] = "not applied";
+                } catch (std::exception &e) {
+                    errors[server] = e.what();
+                    if (errors[server].empty()) errors[server] = "call failed";
+                }
+            }
+            lock.lock();
+            for (uint16_t server = 0; server < batch.size(); ++server) {
+                if (batch[server].empty()) continue;
+                if (errors[server].empty()) {
+                    failing[server] = false;
+                } else if (stop) {
+                    printf("Error: %zu updates for replica %d were lost: %s\n",
+                           batch[server].size(), server, errors[server].c_str());
+                } else {
+                    if (!failing[server])
+                        printf("Error: replica %d did not take %zu updates, retrying: %s\n",
+                               server, batch[server].size(), errors[server].c_str());
+                    failing[server] = true;
+                    retry_at[server] = clock::now() + std::chrono::milliseconds(REPLICATION_RETRY_MS);
+                    queued += batch[server].size();
+                    batch[server].insert(batch[server].end(), pending[server].begin(), pending[server].end());
+                    pending[server].swap(batch[server]);
+                }
+            }
+            sending = false;
+            drained.notify_all();
+        }
+    }
+
+  public:
+    replication_queue(uint16_t num_servers, Sender send_)
+            : send(send_), mutex(), ready(), drained(), pending(num_servers),
+              retry_at(num_servers), failing(num_servers, false),
+              queued(0), sending(false), stop(false), worker() {
+        worker = std::thread(&replication_queue::Run, this);
+    }
+    replication_queue(const replication_queue &) = delete;
+    replication_queue &operator=(const replication_queue &) = delete;
+
+    /* Sends what is still queued before returning, trying unreachable
+     * replicas once more. */
+    ~replication_queue() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        ready.notify_one();
+        worker.join();
+    }
+
+    void Push(uint16_t server, const Op &op) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[server].push_back(op);
+        queued++;
+        ready.notify_one();
+    }
+
+    /* Blocks until the queue is empty and no batch is in flight, which
+     * includes waiting for unreachable replicas to take their updates. */
+    void Flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this]() { return queued == 0 && !sending; });
+    }
+};
+}  // namespace hcl
+
+#endif  // INCLUDE_HCL_COMMON_REPLICATION_H_
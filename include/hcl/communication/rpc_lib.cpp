@@ -18,7 +18,8 @@ void RPC::bind(CharStruct str, F func) {
     switch (HCL_CONF->RPC_IMPLEMENTATION) {
 #ifdef HCL_ENABLE_RPCLIB
         case RPCLIB: {
-            rpclib_server->bind(str.c_str(), func);
+            if (HCL_CONF->HLC_PIGGYBACK) rpclib_server->bind(str.c_str(), hcl::StampedFunction(func));
+            else rpclib_server->bind(str.c_str(), func);
             break;
         }
 #endif
@@ -36,10 +37,77 @@ void RPC::bind(CharStruct str, F func) {
 #endif
     }
 }
+inline size_t RPC::RefreshServers() {
+    std::lock_guard<std::mutex> lock(server_list_mutex);
+    std::vector<CharStruct> servers = HCL_CONF->LoadServers();
+    size_t known = num_known_servers.load(std::memory_order_relaxed);
+    for (; known < servers.size(); ++known) {
+        if (known >= server_list.size()) {
+            printf("Error: Can't add server %s, at most %zu servers are supported\n",
+                   servers[known].c_str(), server_list.size());
+            break;
+        }
+        switch (HCL_CONF->RPC_IMPLEMENTATION) {
+#ifdef HCL_ENABLE_RPCLIB
+            case RPCLIB: {
+                rpclib_clients[known] = std::make_unique<rpc::client>(servers[known].c_str(), server_port + known);
+                break;
+            }
+#endif
+#ifdef HCL_ENABLE_THALLIUM_TCP
+            case THALLIUM_TCP:
+#endif
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+            case THALLIUM_ROCE:
+#endif
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+            {
+                thallium_endpoints[known] = get_endpoint(endpoint_protocol, servers[known], server_port + known);
+                break;
+            }
+#endif
+        }
+        server_list[known] = servers[known];
+    }
+    num_known_servers.store(known, std::memory_order_release);
+    return known;
+}
+
+inline const RPC::Procedure *RPC::RegisterProcedure(CharStruct const &func_name) {
+    std::lock_guard<std::mutex> lock(procedure_mutex);
+    auto iter = procedures.find(func_name.string());
+    if (iter != procedures.end()) return iter->second.get();
+    std::unique_ptr<Procedure> procedure;
+    switch (HCL_CONF->RPC_IMPLEMENTATION) {
+#ifdef HCL_ENABLE_RPCLIB
+        case RPCLIB: {
+            procedure = std::make_unique<Procedure>(func_name);
+            break;
+        }
+#endif
+#ifdef HCL_ENABLE_THALLIUM_TCP
+        case THALLIUM_TCP:
+#endif
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        case THALLIUM_ROCE:
+#endif
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+        {
+            procedure = std::make_unique<Procedure>(func_name);
+            procedure->thallium_procedure = std::make_shared<tl::remote_procedure>(
+                thallium_client->define(func_name.c_str()));
+            break;
+        }
+#endif
+    }
+    return procedures.emplace(func_name.string(), std::move(procedure)).first->second.get();
+}
+
 template <typename Response, typename... Args>
-Response RPC::callWithTimeout(uint16_t server_index, int timeout_ms, CharStruct const &func_name, Args... args) {
-    AutoTrace trace = AutoTrace("RPC::call", server_index, func_name);
+Response RPC::callWithTimeout(uint16_t server_index, int timeout_ms, const Procedure *procedure, Args... args) {
+    AutoTrace trace = AutoTrace("RPC::call", server_index, procedure->name);
     int16_t port = server_port + server_index;
+    CheckServer(server_index);
 
     switch (HCL_CONF->RPC_IMPLEMENTATION) {
 #ifdef HCL_ENABLE_RPCLIB
@@ -50,7 +118,7 @@ Response RPC::callWithTimeout(uint16_t server_index, int timeout_ms, CharStruct
                 client = rpclib_clients[server_index].get();
             }
             client->set_timeout(timeout_ms);
-            Response response = client->call(func_name.c_str(), std::forward<Args>(args)...);
+            Response response = client->call(procedure->name.c_str(), std::forward<Args>(args)...);
             client->clear_timeout();
             return response;
             break;
@@ -58,29 +126,33 @@ Response RPC::callWithTimeout(uint16_t server_index, int timeout_ms, CharStruct
 #endif
 #ifdef HCL_ENABLE_THALLIUM_TCP
         case THALLIUM_TCP: {
-            tl::remote_procedure remote_procedure = thallium_client->define(func_name.c_str());
             // Setup args for RDMA bulk transfer
             // std::vector<std::pair<void*,std::size_t>> segments(num_args);
 
-            return remote_procedure.on(thallium_endpoints[server_index])(std::forward<Args>(args)...);
+            return procedure->thallium_procedure->on(thallium_endpoints[server_index])(std::forward<Args>(args)...);
             break;
         }
 #endif
 #ifdef HCL_ENABLE_THALLIUM_ROCE
         case THALLIUM_ROCE: {
-            tl::remote_procedure remote_procedure = thallium_client->define(func_name.c_str());
-            return remote_procedure.on(thallium_endpoints[server_index])(std::forward<Args>(args)...);
+            return procedure->thallium_procedure->on(thallium_endpoints[server_index])(std::forward<Args>(args)...);
             break;
         }
 #endif
     }
 }
 template <typename Response, typename... Args>
+Response RPC::callWithTimeout(uint16_t server_index, int timeout_ms, CharStruct const &func_name, Args... args) {
+    return callWithTimeout<Response>(server_index, timeout_ms, RegisterProcedure(func_name),
+                                     std::forward<Args>(args)...);
+}
+template <typename Response, typename... Args>
 Response RPC::call(uint16_t server_index,
-                   CharStruct const &func_name,
+                   const Procedure *procedure,
                    Args... args) {
-    AutoTrace trace = AutoTrace("RPC::call", server_index, func_name);
+    AutoTrace trace = AutoTrace("RPC::call", server_index, procedure->name);
     int16_t port = server_port + server_index;
+    CheckServer(server_index);
 
     switch (HCL_CONF->RPC_IMPLEMENTATION) {
 #ifdef HCL_ENABLE_RPCLIB
@@ -91,26 +163,30 @@ Response RPC::call(uint16_t server_index,
                 client = rpclib_clients[server_index].get();
             }
             /*client.set_timeout(5000);*/
-            return client->call(func_name.c_str(), std::forward<Args>(args)...);
+            return client->call(procedure->name.c_str(), std::forward<Args>(args)...);
             break;
         }
 #endif
 #ifdef HCL_ENABLE_THALLIUM_TCP
         case THALLIUM_TCP: {
-            tl::remote_procedure remote_procedure = thallium_client->define(func_name.c_str());
-            return remote_procedure.on(thallium_endpoints[server_index])(std::forward<Args>(args)...);
+            return procedure->thallium_procedure->on(thallium_endpoints[server_index])(std::forward<Args>(args)...);
             break;
         }
 #endif
 #ifdef HCL_ENABLE_THALLIUM_ROCE
         case THALLIUM_ROCE: {
-            tl::remote_procedure remote_procedure = thallium_client->define(func_name.c_str());
-            return remote_procedure.on(thallium_endpoints[server_index])(std::forward<Args>(args)...);
+            return procedure->thallium_procedure->on(thallium_endpoints[server_index])(std::forward<Args>(args)...);
             break;
         }
 #endif
     }
 }
+template <typename Response, typename... Args>
+Response RPC::call(uint16_t server_index,
+                   CharStruct const &func_name,
+                   Args... args) {
+    return call<Response>(server_index, RegisterProcedure(func_name), std::forward<Args>(args)...);
+}
 
 template <typename Response, typename... Args>
 Response RPC::call(CharStruct &server,
@@ -149,10 +225,11 @@ Response RPC::call(CharStruct &server,
 
 template <typename Response, typename... Args>
 std::future<Response> RPC::async_call(uint16_t server_index,
-                                      CharStruct const &func_name,
-                                        Args... args) {
-    AutoTrace trace = AutoTrace("RPC::call", server_index, func_name);
+                                      const Procedure *procedure,
+                                      Args... args) {
+    AutoTrace trace = AutoTrace("RPC::async_call", server_index, procedure->name);
     int16_t port = server_port + server_index;
+    CheckServer(server_index);
 
     switch (HCL_CONF->RPC_IMPLEMENTATION) {
 #ifdef HCL_ENABLE_RPCLIB
@@ -163,25 +240,37 @@ std::future<Response> RPC::async_call(uint16_t server_index,
                 client = rpclib_clients[server_index].get();
             }
             // client.set_timeout(5000);
-            return client->async_call(func_name.c_str(), std::forward<Args>(args)...);
+            return client->async_call(procedure->name.c_str(), std::forward<Args>(args)...);
             break;
         }
 #endif
 #ifdef HCL_ENABLE_THALLIUM_TCP
         case THALLIUM_TCP: {
-            //TODO:NotImplemented error
+            /* The request is forwarded now; the future only waits for the reply. */
+            auto pending = std::make_shared<tl::async_response>(
+                    procedure->thallium_procedure->on(thallium_endpoints[server_index]).async(std::forward<Args>(args)...));
+            return std::async(std::launch::deferred, [pending]() -> Response { return pending->wait(); });
             break;
         }
 #endif
 #ifdef HCL_ENABLE_THALLIUM_ROCE
         case THALLIUM_ROCE: {
-             //TODO:NotImplemented error
+            auto pending = std::make_shared<tl::async_response>(
+                    procedure->thallium_procedure->on(thallium_endpoints[server_index]).async(std::forward<Args>(args)...));
+            return std::async(std::launch::deferred, [pending]() -> Response { return pending->wait(); });
             break;
         }
 #endif
     }
 }
 
+template <typename Response, typename... Args>
+std::future<Response> RPC::async_call(uint16_t server_index,
+                                      CharStruct const &func_name,
+                                      Args... args) {
+    return async_call<Response>(server_index, RegisterProcedure(func_name), std::forward<Args>(args)...);
+}
+
 template <typename Response, typename... Args>
 std::future<Response> RPC::async_call(CharStruct &server,
                                       uint16_t &port,
@@ -200,13 +289,21 @@ std::future<Response> RPC::async_call(CharStruct &server,
 #endif
 #ifdef HCL_ENABLE_THALLIUM_TCP
         case THALLIUM_TCP: {
-            //TODO:NotImplemented error
+            tl::remote_procedure remote_procedure = thallium_client->define(func_name.c_str());
+            auto end_point = get_endpoint(HCL_CONF->TCP_CONF,server,port);
+            auto pending = std::make_shared<tl::async_response>(
+                    remote_procedure.on(end_point).async(std::forward<Args>(args)...));
+            return std::async(std::launch::deferred, [pending]() -> Response { return pending->wait(); });
             break;
         }
 #endif
 #ifdef HCL_ENABLE_THALLIUM_ROCE
         case THALLIUM_ROCE: {
-             //TODO:NotImplemented error
+            tl::remote_procedure remote_procedure = thallium_client->define(func_name.c_str());
+            auto end_point = get_endpoint(HCL_CONF->TCP_CONF,server,port);
+            auto pending = std::make_shared<tl::async_response>(
+                    remote_procedure.on(end_point).async(std::forward<Args>(args)...));
+            return std::async(std::launch::deferred, [pending]() -> Response { return pending->wait(); });
             break;
         }
 #endif
@@ -214,27 +311,23 @@ std::future<Response> RPC::async_call(CharStruct &server,
 }
 
 #ifdef HCL_ENABLE_THALLIUM_ROCE
-// These are still experimental for using RDMA bulk transfers
-template<typename MappedType>
-MappedType RPC::prep_rdma_server(tl::endpoint endpoint, tl::bulk &bulk_handle) {
-    // MappedType buffer;
-    std::string buffer;
-    buffer.resize(1000000, 'a');
-    std::vector<std::pair<void *, size_t>> segments(1);
-    segments[0].first = (void *)(&buffer[0]);
-    segments[0].second = 1000000 + 1;
+inline tl::bulk RPC::prep_rdma_client(void *buffer, std::size_t size, tl::bulk_mode mode) {
+    std::vector<std::pair<void *, std::size_t>> segments(1, std::make_pair(buffer, size));
+    return thallium_client->expose(segments, mode);
+}
+
+inline void RPC::rdma_pull(const tl::request &thallium_req, tl::bulk &bulk_handle,
+                           void *buffer, std::size_t size) {
+    std::vector<std::pair<void *, std::size_t>> segments(1, std::make_pair(buffer, size));
     tl::bulk local = thallium_server->expose(segments, tl::bulk_mode::write_only);
-    bulk_handle.on(endpoint) >> local;
-    return buffer;
+    bulk_handle.on(thallium_req.get_endpoint()) >> local;
 }
 
-template<typename MappedType>
-tl::bulk RPC::prep_rdma_client(MappedType &data) {
-    MappedType my_buffer = data;
-    std::vector<std::pair<void *, std::size_t>> segments(1);
-    segments[0].first = (void *)&my_buffer[0];
-    segments[0].second = 1000000 + 1;
-    return thallium_client->expose(segments, tl::bulk_mode::read_only);
+inline void RPC::rdma_push(const tl::request &thallium_req, tl::bulk &bulk_handle,
+                           void *buffer, std::size_t size) {
+    std::vector<std::pair<void *, std::size_t>> segments(1, std::make_pair(buffer, size));
+    tl::bulk local = thallium_server->expose(segments, tl::bulk_mode::read_only);
+    bulk_handle.on(thallium_req.get_endpoint()) << local;
 }
 #endif
 
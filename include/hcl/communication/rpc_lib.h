@@ -16,10 +16,13 @@
 #include <hcl/common/constants.h>
 #include <hcl/common/data_structures.h>
 #include <hcl/common/debug.h>
+#include <hcl/common/hlc.h>
 #include <hcl/common/macros.h>
 #include <hcl/common/singleton.h>
 #include <hcl/common/typedefs.h>
 #include <mpi.h>
+#include <algorithm>
+#include <mutex>
 
 /** RPC Lib Headers**/
 #ifdef HCL_ENABLE_RPCLIB
@@ -70,14 +73,66 @@
 #include <fstream>
 #include <iostream>
 #include <future>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
 
 namespace bip = boost::interprocess;
 #if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
 namespace tl = thallium;
 #endif
 
+namespace hcl {
+/**
+ * Reads the value of an RPC response. With HCL_CONF->HLC_PIGGYBACK set,
+ * every response is a pair of the value and the responder's hybrid logical
+ * clock, and the timestamp is merged into this process's clock.
+ */
+template<typename Ret, typename Response>
+Ret ReadResponse(Response &&response) {
+    if (!HCL_CONF->HLC_PIGGYBACK) return response.template as<Ret>();
+    auto stamped = response.template as<std::pair<Ret, HTime>>();
+    PiggybackMerge(stamped.second);
+    return std::move(stamped.first);
+}
+
+/* Server side of ReadResponse for a function bound to rpclib. */
+template<typename Ret, typename... Args>
+std::function<std::pair<Ret, HTime>(Args...)> StampedFunction(const std::function<Ret(Args...)> &func) {
+    return [func](Args... args) {
+        Ret value = func(std::forward<Args>(args)...);
+        return std::pair<Ret, HTime>(std::move(value), PiggybackStamp());
+    };
+}
+
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+/* Server side of ReadResponse for a thallium handler. */
+template<typename T>
+void SendResponse(const tl::request &request, T &&value) {
+    if (HCL_CONF->HLC_PIGGYBACK) request.respond(std::make_pair(std::forward<T>(value), PiggybackStamp()));
+    else request.respond(std::forward<T>(value));
+}
+#endif
+}  // namespace hcl
+
 class RPC {
+public:
+    /**
+     * A remote function resolved once by RegisterProcedure. Handles stay
+     * valid for the lifetime of the RPC object.
+     */
+    struct Procedure {
+        CharStruct name;
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+        std::shared_ptr<tl::remote_procedure> thallium_procedure;
+#endif
+        explicit Procedure(CharStruct name_) : name(name_) {}
+    };
 private:
+    std::mutex procedure_mutex;
+    std::unordered_map<std::string, std::unique_ptr<Procedure>> procedures;
     uint16_t server_port;
     std::string name;
 #ifdef HCL_ENABLE_RPCLIB
@@ -100,11 +155,13 @@ private:
         CharStruct lookup_str = protocol + "://" + std::string(ip) + ":" + std::to_string(server_port);
         return thallium_client->lookup(lookup_str.c_str());
     }
+    CharStruct endpoint_protocol;
     void init_engine_and_endpoints(CharStruct protocol) {
+        endpoint_protocol = protocol;
         thallium_client = hcl::Singleton<tl::engine>::GetInstance(protocol.c_str(), MARGO_CLIENT_MODE);
-        thallium_endpoints.reserve(server_list.size());
-        for (std::vector<CharStruct>::size_type i = 0; i < server_list.size(); ++i) {
-            thallium_endpoints.push_back(get_endpoint(protocol,server_list[i],server_port + i));
+        thallium_endpoints.resize(server_list.size());
+        for (size_t i = 0; i < num_known_servers.load(); ++i) {
+            thallium_endpoints[i] = get_endpoint(protocol,server_list[i],server_port + i);
         }
     }
 
@@ -117,7 +174,21 @@ private:
       }*/
 
 #endif
+    /* server_list and the connection tables have MAX_SERVERS slots (or as
+     * many as the list at startup) and are never resized, so calls can read
+     * a slot while RefreshServers fills later ones. The first
+     * num_known_servers slots are filled; the count is published after the
+     * slots it covers. */
+    std::mutex server_list_mutex;
     std::vector<CharStruct> server_list;
+    std::atomic<size_t> num_known_servers;
+
+    /* Called before a server's slot is used: picks up a server that joined
+     * after this process last read the list. */
+    void CheckServer(uint16_t server_index) {
+        if (server_index < NumServers() || server_index < RefreshServers()) return;
+        throw std::out_of_range("server " + std::to_string(server_index) + " is not in the server list");
+    }
   public:
     ~RPC() {
         if (HCL_CONF->IS_SERVER) {
@@ -146,11 +217,14 @@ private:
         }
     }
 
-    RPC() : server_list(),
-             server_port(HCL_CONF->RPC_PORT) {
+    RPC() : server_port(HCL_CONF->RPC_PORT),
+             server_list(), num_known_servers(0) {
     AutoTrace trace = AutoTrace("RPC");
 
     server_list = HCL_CONF->LoadServers();
+    num_known_servers = server_list.size();
+    /* Servers that join later fill the free slots (see RefreshServers). */
+    server_list.resize(std::max<size_t>(server_list.size(), MAX_SERVERS));
 
     /* if current rank is a server */
     if (HCL_CONF->IS_SERVER) {
@@ -184,8 +258,9 @@ private:
         }
     }
 #ifdef HCL_ENABLE_RPCLIB
-    for (std::vector<rpc::client>::size_type i = 0; i < server_list.size(); ++i) {
-        rpclib_clients.push_back(std::make_unique<rpc::client>(server_list[i].c_str(), server_port + i));
+    rpclib_clients.resize(server_list.size());
+    for (size_t i = 0; i < num_known_servers.load(); ++i) {
+        rpclib_clients[i] = std::make_unique<rpc::client>(server_list[i].c_str(), server_port + i);
     }
 #endif
     run(HCL_CONF->RPC_THREADS);
@@ -241,18 +316,48 @@ private:
         }
     }
 
-#ifdef HCL_ENABLE_THALLIUM_ROCE
-    template<typename MappedType>
-    MappedType prep_rdma_server(tl::endpoint endpoint, tl::bulk &bulk_handle);
+    /**
+     * Re-reads the server list and connects to servers appended to it since
+     * startup, so that servers can join a running job. Known servers keep
+     * their index and connection. Up to MAX_SERVERS servers are supported,
+     * as the connection tables must not move while other threads use them.
+     * @return the number of servers now known
+     */
+    size_t RefreshServers();
+
+    /* Servers that can be called: those listed at startup or since added
+     * by RefreshServers. */
+    size_t NumServers() {
+        return num_known_servers.load(std::memory_order_acquire);
+    }
 
-    template<typename MappedType>
-    tl::bulk prep_rdma_client(MappedType &data);
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+    /**
+     * Exposes a client buffer for a bulk transfer driven by the server.
+     * The buffer must stay valid until the RPC carrying the handle returns.
+     */
+    tl::bulk prep_rdma_client(void *buffer, std::size_t size, tl::bulk_mode mode);
+    /** Server side: copies the client's exposed buffer into buffer. */
+    void rdma_pull(const tl::request &thallium_req, tl::bulk &bulk_handle,
+                   void *buffer, std::size_t size);
+    /** Server side: copies buffer into the client's exposed buffer. */
+    void rdma_push(const tl::request &thallium_req, tl::bulk &bulk_handle,
+                   void *buffer, std::size_t size);
 #endif
+    /**
+     * Resolves func_name to a procedure handle, defining it with the
+     * Thallium client the first time it is seen.
+     */
+    const Procedure *RegisterProcedure(CharStruct const &func_name);
     /**
      * Response should be RPCLIB_MSGPACK::object_handle for rpclib and
      * tl::packed_response for thallium/mercury
      */
     template <typename Response, typename... Args>
+    Response call(uint16_t server_index,
+                  const Procedure *procedure,
+                  Args... args);
+    template <typename Response, typename... Args>
     Response call(uint16_t server_index,
                   CharStruct const &func_name,
                   Args... args);
@@ -271,6 +376,14 @@ private:
                   CharStruct const &func_name,
                   Args... args);
     template <typename Response, typename... Args>
+    Response callWithTimeout(uint16_t server_index,
+                  int timeout_ms,
+                  const Procedure *procedure,
+                  Args... args);
+    template <typename Response, typename... Args>
+    std::future<Response> async_call(
+            uint16_t server_index, const Procedure *procedure, Args... args);
+    template <typename Response, typename... Args>
     std::future<Response> async_call(
             uint16_t server_index, CharStruct const &func_name, Args... args);
     template <typename Response, typename... Args>
@@ -279,6 +392,46 @@ private:
 
 };
 
+/**
+ * Maps the function-name literals used at RPC_CALL_WRAPPER call sites to
+ * procedure handles, so a steady-state call is a pointer-compare scan with
+ * no string building or hashing. Entries are only appended; readers do not
+ * take a lock.
+ */
+class RPCProcedureCache {
+    static const size_t MAX_ENTRIES = 64;
+    struct Entry {
+        std::atomic<const char *> funcname;
+        const RPC::Procedure *procedure;
+    };
+    std::array<Entry, MAX_ENTRIES> entries;
+    std::atomic<size_t> num_entries;
+    std::mutex append_mutex;
+
+  public:
+    RPCProcedureCache() : entries(), num_entries(0), append_mutex() {}
+
+    const RPC::Procedure *Get(const std::shared_ptr<RPC> &rpc,
+                              const char *func_prefix,
+                              const char *funcname) {
+        size_t count = num_entries.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            if (entries[i].funcname.load(std::memory_order_relaxed) == funcname)
+                return entries[i].procedure;
+        }
+        const RPC::Procedure *procedure =
+            rpc->RegisterProcedure(std::string(func_prefix) + funcname);
+        std::lock_guard<std::mutex> lock(append_mutex);
+        count = num_entries.load(std::memory_order_relaxed);
+        if (count < MAX_ENTRIES) {
+            entries[count].procedure = procedure;
+            entries[count].funcname.store(funcname, std::memory_order_relaxed);
+            num_entries.store(count + 1, std::memory_order_release);
+        }
+        return procedure;
+    }
+};
+
 #include "rpc_lib.cpp"
 
 #endif  // INCLUDE_HCL_COMMUNICATION_RPC_LIB_H_
@@ -23,10 +23,24 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 bool map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalPut(KeyType &key,
                                                  MappedType &data) {
     AutoTrace trace = AutoTrace("hcl::map::Put(local)", key, data);
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-    auto value = GetData<Allocator, MappedType, SharedType>(data);
-    mymap->insert_or_assign(key, value);
-    return true;
+    journal_commit commit(oplog.get());
+    size_t key_hash = keyHash(key);
+    bool forward = false;
+    lease_writer writer(leases, key_hash);
+    bool result = GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex, boost::interprocess::defer_lock);
+        writer.Lock(lock);
+        if (!Stays(key_hash) && mymap->find(key) == mymap->end()) {
+            forward = true;
+            return false;
+        }
+        auto &&value = GetData<Allocator, MappedType, SharedType>(data);
+        mymap->insert_or_assign(key, value);
+        LogUpdate(key_hash, key, true, data);
+        return true;
+    });
+    if (forward) return Forward<bool>(key_hash, "_Put", key, data);
+    return commit.Done() && result;
 }
 
 /**
@@ -38,12 +52,18 @@ bool map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalPut(KeyType
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
 bool map<KeyType, MappedType, Compare, Allocator , SharedType>::Put(KeyType &key,
                                             MappedType &data) {
+    if (cache != nullptr) cache->Invalidate(key);
     size_t key_hash = keyHash(key);
-    uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
-    if (is_local(key_int)) {
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
         return LocalPut(key, data);
     } else {
         AutoTrace trace = AutoTrace("hcl::map::Put(remote)", key, data);
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        if (UseBulk<Allocator, MappedType>()) {
+            return BulkCall<bool>(key_int, "_BulkPut", data, tl::bulk_mode::read_only, key);
+        }
+#endif
         return RPC_CALL_WRAPPER("_Put", key_int, bool,
                                 key, data);
     }
@@ -59,14 +79,99 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 std::pair<bool, MappedType>
 map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalGet(KeyType &key) {
     AutoTrace trace = AutoTrace("hcl::map::Get(local)", key);
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-            lock(*mutex);
-    typename MyMap::iterator iterator = mymap->find(key);
-    if (iterator != mymap->end()) {
-        return std::pair<bool, MappedType>(true, iterator->second);
-    } else {
-        return std::pair<bool, MappedType>(false, MappedType());
+    size_t key_hash = keyHash(key);
+    {
+        boost::interprocess::sharable_lock<segment_mutex>
+                lock(*mutex);
+        typename MyMap::iterator iterator = mymap->find(key);
+        if (iterator != mymap->end()) {
+            return std::pair<bool, MappedType>(true, iterator->second);
+        }
+        if (Stays(key_hash)) return std::pair<bool, MappedType>(false, MappedType());
+    }
+    typedef std::pair<bool, MappedType> ret_type;
+    return Forward<ret_type>(key_hash, "_Get", key);
+}
+
+/**
+ * LocalGet that also grants the caller a read lease on the key.
+ * @return the lease in nanoseconds (0 if none) and the result of LocalGet
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::pair<uint64_t, std::pair<bool, MappedType>>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalLeasedGet(KeyType &key) {
+    AutoTrace trace = AutoTrace("hcl::map::LeasedGet(local)", key);
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    {
+        boost::interprocess::sharable_lock<segment_mutex>
+                lock(*mutex);
+        typename MyMap::iterator iterator = mymap->find(key);
+        if (iterator != mymap->end()) {
+            return std::pair<uint64_t, ret_type>(GrantLease(key_hash), ret_type(true, iterator->second));
+        }
+        if (Stays(key_hash)) return std::pair<uint64_t, ret_type>(GrantLease(key_hash), ret_type(false, MappedType()));
     }
+    return std::pair<uint64_t, ret_type>(0, Forward<ret_type>(key_hash, "_Get", key));
+}
+
+/**
+ * Applies updates sent by the owners of keys this server holds copies of,
+ * in the order they were made.
+ * @param ops, the updates; a pair with bool false erases the key
+ * @return bool, false if this server keeps no replicas
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalReplicate(std::vector<ReplicaOp> &ops) {
+    AutoTrace trace = AutoTrace("hcl::map::Replicate(local)", ops.size());
+    if (replica_map == nullptr) return false;
+    return GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex> lock(replica_map->mutex);
+        for (auto &op : ops) {
+            if (op.second.first) {
+                auto &&value = GetData<Allocator, MappedType, SharedType>(op.second.second);
+                replica_map->map.insert_or_assign(op.first, value);
+            } else {
+                replica_map->map.erase(op.first);
+            }
+        }
+        return true;
+    });
+}
+
+/**
+ * Get served by any server holding key; a replica's copy may lag the
+ * owner's latest updates, so on a miss the owner is asked.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::pair<bool, MappedType>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalReplicaGet(KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    if (replica_map == nullptr || GetServer(key_hash) == my_server) return LocalGet(key);
+    AutoTrace trace = AutoTrace("hcl::map::ReplicaGet(local)", key);
+    {
+        boost::interprocess::sharable_lock<segment_mutex> lock(replica_map->mutex);
+        typename MyMap::iterator iterator = replica_map->map.find(key);
+        if (iterator != replica_map->map.end()) return ret_type(true, iterator->second);
+    }
+    return Forward<ret_type>(key_hash, "_Get", key);
+}
+
+/**
+ * Remote Get through the client cache; see unordered_map::CachedGet.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::pair<bool, MappedType>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::CachedGet(uint16_t key_int, KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
+    typedef std::pair<uint64_t, ret_type> leased_type;
+    ret_type result;
+    if (cache->Lookup(key, result)) return result;
+    auto sent = std::chrono::steady_clock::now();
+    leased_type leased = RPC_CALL_WRAPPER("_LeasedGet", key_int, leased_type, key);
+    if (leased.first > 0) cache->Insert(key, leased.second, sent + std::chrono::nanoseconds(leased.first));
+    return leased.second;
 }
 
 /**
@@ -78,34 +183,147 @@ map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalGet(KeyType &key
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
 std::pair<bool, MappedType>
 map<KeyType, MappedType, Compare, Allocator , SharedType>::Get(KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
     size_t key_hash = keyHash(key);
-    uint16_t key_int = key_hash % num_servers;
+    /* Cached reads need the owner's lease, so only uncached ones use replicas. */
+    if (replication_factor > 1 && cache == nullptr) {
+        if (HoldsReplica(key_hash)) return LocalReplicaGet(key);
+        AutoTrace trace = AutoTrace("hcl::map::Get(replica)", key);
+        return ReplicaRead<ret_type>(key_hash, "_ReplicaGet", key);
+    }
+    uint16_t key_int = GetServer(key_hash);
     if (is_local(key_int)) {
         return LocalGet(key);
     } else {
         AutoTrace trace = AutoTrace("hcl::map::Get(remote)", key);
-        typedef std::pair<bool, MappedType> ret_type;
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        if (UseBulk<Allocator, MappedType>()) {
+            ret_type result(false, MappedType());
+            result.first = BulkCall<bool>(key_int, "_BulkGet", result.second, tl::bulk_mode::write_only, key);
+            return result;
+        }
+#endif
+        if (cache != nullptr) return CachedGet(key_int, key);
         return RPC_CALL_WRAPPER("_Get", key_int, ret_type,
                                 key);
     }
 }
 
+/**
+ * Get a read handle to the data. For a key held by the co-located server the
+ * handle pins the value in the map node under the shared lock instead of
+ * copying it out; otherwise it owns the value fetched by Get.
+ * @param key, key to get
+ * @return value_view, empty if the key was not found
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+value_view<MappedType>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::GetView(KeyType &key) {
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local(key_int)) {
+        AutoTrace trace = AutoTrace("hcl::map::GetView(local)", key);
+        {
+            boost::interprocess::sharable_lock<segment_mutex>
+                    lock(*mutex);
+            typename MyMap::iterator iterator = mymap->find(key);
+            if (iterator != mymap->end()) return value_view<MappedType>(std::move(lock), &iterator->second);
+            if (Stays(key_hash)) return value_view<MappedType>();
+        }
+        typedef std::pair<bool, MappedType> ret_type;
+        return value_view<MappedType>(Forward<ret_type>(key_hash, "_Get", key));
+    }
+    return value_view<MappedType>(Get(key));
+}
+
+/**
+ * Run visitor(const MappedType &) on the data for key, in place when the key
+ * is held by the co-located server.
+ * @return bool, false if the key was not found and visitor was not called
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+template<typename Visitor>
+bool map<KeyType, MappedType, Compare, Allocator , SharedType>::WithValue(KeyType &key, Visitor visitor) {
+    value_view<MappedType> view = GetView(key);
+    if (!view) return false;
+    visitor(*view);
+    return true;
+}
+
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+/**
+ * Server side of a bulk Put: the value is pulled from the client and then
+ * put as by LocalPut, so a failed transfer leaves the map as it was.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+void map<KeyType, MappedType, Compare, Allocator , SharedType>::ThalliumLocalBulkPut(
+        const tl::request &thallium_req, KeyType &key, tl::bulk &bulk_handle) {
+    AutoTrace trace = AutoTrace("hcl::map::BulkPut(local)", key);
+    MappedType data;
+    try {
+        rpc->rdma_pull(thallium_req, bulk_handle, &data, sizeof(MappedType));
+    } catch (std::exception &e) {
+        printf("Error: %s could not pull a put value: %s\n", name.c_str(), e.what());
+        hcl::SendResponse(thallium_req, false);
+        return;
+    }
+    hcl::SendResponse(thallium_req, LocalPut(key, data));
+}
+
+/**
+ * Server side of a bulk Get: the stored value is pushed into the client's
+ * buffer. Responds whether the key was found.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+void map<KeyType, MappedType, Compare, Allocator , SharedType>::ThalliumLocalBulkGet(
+        const tl::request &thallium_req, KeyType &key, tl::bulk &bulk_handle) {
+    AutoTrace trace = AutoTrace("hcl::map::BulkGet(local)", key);
+    size_t key_hash = keyHash(key);
+    {
+        boost::interprocess::sharable_lock<segment_mutex> lock(*mutex);
+        typename MyMap::iterator iterator = mymap->find(key);
+        bool found = iterator != mymap->end();
+        if (found) rpc->rdma_push(thallium_req, bulk_handle, &iterator->second, sizeof(MappedType));
+        if (found || Stays(key_hash)) {
+            hcl::SendResponse(thallium_req, found);
+            return;
+        }
+    }
+    typedef std::pair<bool, MappedType> ret_type;
+    ret_type result = Forward<ret_type>(key_hash, "_Get", key);
+    if (result.first) rpc->rdma_push(thallium_req, bulk_handle, &result.second, sizeof(MappedType));
+    hcl::SendResponse(thallium_req, result.first);
+}
+#endif
+
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
 std::pair<bool, MappedType>
 map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalErase(KeyType &key) {
     AutoTrace trace = AutoTrace("hcl::map::Erase(local)", key);
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-            lock(*mutex);
-    size_t s = mymap->erase(key);
-    return std::pair<bool, MappedType>(s > 0, MappedType());
+    journal_commit commit(oplog.get());
+    size_t key_hash = keyHash(key);
+    size_t s;
+    {
+        lease_writer writer(leases, key_hash);
+        boost::interprocess::scoped_lock<segment_mutex>
+                lock(*mutex, boost::interprocess::defer_lock);
+        writer.Lock(lock);
+        s = mymap->erase(key);
+        if (s > 0) LogUpdate(key_hash, key, false, MappedType());
+    }
+    if (s > 0) return std::pair<bool, MappedType>(commit.Done(), MappedType());
+    if (Stays(key_hash)) return std::pair<bool, MappedType>(false, MappedType());
+    typedef std::pair<bool, MappedType> ret_type;
+    return Forward<ret_type>(key_hash, "_Erase", key);
 }
 
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
 std::pair<bool, MappedType>
 map<KeyType, MappedType, Compare, Allocator , SharedType>::Erase(KeyType &key) {
+    if (cache != nullptr) cache->Invalidate(key);
     size_t key_hash = keyHash(key);
-    uint16_t key_int = key_hash % num_servers;
-    if (is_local(key_int)) {
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
         return LocalErase(key);
     } else {
         AutoTrace trace = AutoTrace("hcl::map::Erase(remote)", key);
@@ -124,34 +342,34 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 std::vector<std::pair<KeyType, MappedType>>
 map<KeyType, MappedType, Compare, Allocator , SharedType>::Contains(KeyType &key_start,KeyType &key_end) {
     AutoTrace trace = AutoTrace("hcl::map::Contains", key_start,key_end);
-    auto final_values = std::vector<std::pair<KeyType, MappedType>>();
-    auto current_server = ContainsInServer(key_start,key_end);
-    final_values.insert(final_values.end(), current_server.begin(), current_server.end());
-    for (int i = 0; i < num_servers; ++i) {
-        if (i != my_server) {
-            typedef std::vector<std::pair<KeyType, MappedType>> ret_type;
-            auto server = RPC_CALL_WRAPPER("_Contains", i, ret_type, key_start,key_end);
-            final_values.insert(final_values.end(), server.begin(), server.end());
+    typedef std::vector<std::pair<KeyType, MappedType>> ret_type;
+    auto per_server = FanOut<ret_type>([&](uint16_t server) -> std::future<ret_type> {
+        if (server == my_server) {
+            return std::async(std::launch::deferred, [&]() { return ContainsInServer(key_start, key_end); });
         }
-    }
-    return final_values;
+        return RPC_CALL_WRAPPER_ASYNC("_Contains", server, ret_type, key_start, key_end);
+    });
+    return MergeSorted(per_server, [](const std::pair<KeyType, MappedType> &a,
+                                      const std::pair<KeyType, MappedType> &b) {
+        return Compare()(a.first, b.first);
+    });
 }
 
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
 std::vector<std::pair<KeyType, MappedType>>
 map<KeyType, MappedType, Compare, Allocator , SharedType>::GetAllData() {
     AutoTrace trace = AutoTrace("hcl::map::GetAllData");
-    auto final_values = std::vector<std::pair<KeyType, MappedType>>();
-    auto current_server = GetAllDataInServer();
-    final_values.insert(final_values.end(), current_server.begin(), current_server.end());
-    for (int i = 0; i < num_servers ; ++i) {
-        if (i != my_server) {
-            typedef std::vector<std::pair<KeyType, MappedType> > ret_type;
-            auto server = RPC_CALL_WRAPPER1("_GetAllData", i, ret_type);
-            final_values.insert(final_values.end(), server.begin(), server.end());
+    typedef std::vector<std::pair<KeyType, MappedType> > ret_type;
+    auto per_server = FanOut<ret_type>([&](uint16_t server) -> std::future<ret_type> {
+        if (server == my_server) {
+            return std::async(std::launch::deferred, [&]() { return GetAllDataInServer(); });
         }
-    }
-    return final_values;
+        return RPC_CALL_WRAPPER_ASYNC1("_GetAllData", server, ret_type);
+    });
+    return MergeSorted(per_server, [](const std::pair<KeyType, MappedType> &a,
+                                      const std::pair<KeyType, MappedType> &b) {
+        return Compare()(a.first, b.first);
+    });
 }
 
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
@@ -160,7 +378,7 @@ map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalContainsInServer
     AutoTrace trace = AutoTrace("hcl::map::ContainsInServer", key_start,key_end);
     auto final_values = std::vector<std::pair<KeyType, MappedType>>();
     {
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
+        boost::interprocess::sharable_lock<segment_mutex> lock(*mutex);
         typename MyMap::iterator lower_bound;
         size_t size = mymap->size();
         if (size == 0) {
@@ -205,7 +423,7 @@ map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalGetAllDataInServ
     AutoTrace trace = AutoTrace("hcl::map::GetAllDataInServer", NULL);
     auto final_values = std::vector<std::pair<KeyType, MappedType>>();
     {
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
+        boost::interprocess::sharable_lock<segment_mutex> lock(*mutex);
         typename MyMap::iterator lower_bound;
         lower_bound = mymap->begin();
         while (lower_bound != mymap->end()) {
@@ -231,6 +449,347 @@ map<KeyType, MappedType, Compare, Allocator , SharedType>::GetAllDataInServer()
 }
 
 
+/**
+ * Put a batch of key-value pairs into the local map under a single lock
+ * acquisition.
+ * @param entries, the key-value pairs for put
+ * @return bool, true if all the Puts were successful else false.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalMultiPut(std::vector<std::pair<KeyType, MappedType>> &entries) {
+    AutoTrace trace = AutoTrace("hcl::map::MultiPut(local)", entries.size());
+    journal_commit commit(oplog.get());
+    std::vector<size_t> moved;
+    lease_writer writer(leases);
+    for (auto &entry : entries) writer.Add(keyHash(entry.first));
+    GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex, boost::interprocess::defer_lock);
+        writer.Lock(lock);
+        moved.clear();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto &entry = entries[i];
+            if (!Stays(keyHash(entry.first)) && mymap->find(entry.first) == mymap->end()) {
+                moved.push_back(i);
+                continue;
+            }
+            auto &&value = GetData<Allocator, MappedType, SharedType>(entry.second);
+            mymap->insert_or_assign(entry.first, value);
+            LogUpdate(keyHash(entry.first), entry.first, true, entry.second);
+        }
+        return true;
+    });
+    bool result = commit.Done();
+    for (size_t i : moved) {
+        bool moved_result = Forward<bool>(keyHash(entries[i].first), "_Put", entries[i].first, entries[i].second);
+        result = result && moved_result;
+    }
+    return result;
+}
+
+/**
+ * Get a batch of keys from the local map under a single lock acquisition.
+ * @param keys, keys to get
+ * @return one pair of bool and Value per key, in the order of keys.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::vector<std::pair<bool, MappedType>>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalMultiGet(std::vector<KeyType> &keys) {
+    AutoTrace trace = AutoTrace("hcl::map::MultiGet(local)", keys.size());
+    std::vector<std::pair<bool, MappedType>> results;
+    results.reserve(keys.size());
+    std::vector<size_t> moved;
+    {
+        boost::interprocess::sharable_lock<segment_mutex> lock(*mutex);
+        for (auto &key : keys) {
+            typename MyMap::iterator iterator = mymap->find(key);
+            if (iterator != mymap->end()) {
+                results.emplace_back(true, iterator->second);
+            } else {
+                if (!Stays(keyHash(key))) moved.push_back(results.size());
+                results.emplace_back(false, MappedType());
+            }
+        }
+    }
+    typedef std::pair<bool, MappedType> ret_type;
+    for (size_t i : moved) results[i] = Forward<ret_type>(keyHash(keys[i]), "_Get", keys[i]);
+    return results;
+}
+
+/**
+ * Erase a batch of keys from the local map under a single lock acquisition.
+ * @param keys, keys to erase
+ * @return one pair per key, in the order of keys; bool is true if the key
+ * was present.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::vector<std::pair<bool, MappedType>>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::LocalMultiErase(std::vector<KeyType> &keys) {
+    AutoTrace trace = AutoTrace("hcl::map::MultiErase(local)", keys.size());
+    journal_commit commit(oplog.get());
+    std::vector<std::pair<bool, MappedType>> results;
+    results.reserve(keys.size());
+    std::vector<size_t> moved;
+    {
+        lease_writer writer(leases);
+        for (auto &key : keys) writer.Add(keyHash(key));
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex, boost::interprocess::defer_lock);
+        writer.Lock(lock);
+        for (auto &key : keys) {
+            size_t s = mymap->erase(key);
+            if (s > 0) LogUpdate(keyHash(key), key, false, MappedType());
+            if (s == 0 && !Stays(keyHash(key))) moved.push_back(results.size());
+            results.emplace_back(s > 0, MappedType());
+        }
+    }
+    if (!commit.Done()) {
+        for (auto &result : results) result.first = false;
+    }
+    typedef std::pair<bool, MappedType> ret_type;
+    for (size_t i : moved) results[i] = Forward<ret_type>(keyHash(keys[i]), "_Erase", keys[i]);
+    return results;
+}
 
+/**
+ * Moves the entries owned elsewhere in the next membership among the next
+ * MIGRATION_BATCH keys, in key order from where the previous batch stopped.
+ * The map is only locked to copy the batch and to erase what arrived (see
+ * HandOver).
+ * @return bool, false once the end of the map was reached
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool map<KeyType, MappedType, Compare, Allocator , SharedType>::MigrateStep() {
+    journal_commit commit(oplog.get());
+    const partitioner *next = next_routing.load();
+    if (next == nullptr) {
+        migrate_resume = false;
+        return false;
+    }
+    typedef std::pair<KeyType, MappedType> Entry;
+    std::vector<handover_batch<KeyType, Entry>> outgoing(next->NumServers());
+    {
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex);
+        typename MyMap::iterator iterator = migrate_resume ? mymap->lower_bound(migrate_cursor) : mymap->begin();
+        std::vector<size_t> hashes;
+        for (size_t scanned = 0; iterator != mymap->end() && scanned < MIGRATION_BATCH; ++iterator, ++scanned) {
+            size_t key_hash = keyHash(iterator->first);
+            uint16_t owner = next->GetServer(key_hash);
+            if (owner == my_server) continue;
+            outgoing[owner].keys.push_back(iterator->first);
+            outgoing[owner].hashes.push_back(key_hash);
+            outgoing[owner].entries.push_back(Entry(iterator->first, iterator->second));
+            hashes.push_back(key_hash);
+        }
+        migrate_resume = iterator != mymap->end();
+        if (migrate_resume) migrate_cursor = iterator->first;
+        StartHandover(hashes);
+    }
+    typedef std::pair<bool, MappedType> erase_type;
+    HandOver<erase_type>(*mutex, outgoing,
+        [this](KeyType &key, std::vector<Entry> &entries) {
+            typename MyMap::iterator iterator = mymap->find(key);
+            if (iterator != mymap->end()) entries.push_back(Entry(iterator->first, iterator->second));
+        },
+        [this](KeyType &key) {
+            if (mymap->erase(key) > 0) LogUpdate(keyHash(key), key, false, MappedType());
+        });
+    return migrate_resume;
+}
+
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+template<typename Item, typename KeyOf>
+void map<KeyType, MappedType, Compare, Allocator , SharedType>::GroupByServer(std::vector<Item> &items, KeyOf key_of,
+        std::vector<std::vector<size_t>> &positions) {
+    const partitioner *table = Routing();
+    positions.assign(table->NumServers(), std::vector<size_t>());
+    for (size_t i = 0; i < items.size(); ++i) {
+        size_t key_hash = keyHash(key_of(items[i]));
+        positions[table->GetServer(key_hash)].push_back(i);
+    }
+}
+
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+void map<KeyType, MappedType, Compare, Allocator , SharedType>::GroupByServer(std::vector<KeyType> &keys,
+        std::vector<std::vector<size_t>> &positions) {
+    GroupByServer(keys, [](KeyType &key) -> KeyType & { return key; }, positions);
+}
+
+/**
+ * Put a batch of key-value pairs. Entries are grouped by destination server
+ * and each server receives a single RPC carrying all of its entries; entries
+ * owned by the local server skip RPC.
+ * @param entries, the key-value pairs for put
+ * @return bool, true if all the Puts were successful else false.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool map<KeyType, MappedType, Compare, Allocator , SharedType>::MultiPut(std::vector<std::pair<KeyType, MappedType>> &entries) {
+    if (cache != nullptr) {
+        for (auto &entry : entries) cache->Invalidate(entry.first);
+    }
+    std::vector<std::vector<size_t>> positions;
+    GroupByServer(entries, [](std::pair<KeyType, MappedType> &entry) -> KeyType & { return entry.first; },
+                  positions);
+    bool result = true;
+    for (uint16_t key_int = 0; key_int < positions.size(); ++key_int) {
+        if (positions[key_int].empty()) continue;
+        /* Only copy out a sub-batch when the entries span several servers. */
+        std::vector<std::pair<KeyType, MappedType>> sub_batch;
+        if (positions[key_int].size() != entries.size()) {
+            sub_batch.reserve(positions[key_int].size());
+            for (size_t i : positions[key_int]) sub_batch.push_back(entries[i]);
+        }
+        auto &batch = sub_batch.empty() ? entries : sub_batch;
+        bool batch_result;
+        if (is_local_write(key_int)) {
+            batch_result = LocalMultiPut(batch);
+        } else {
+            AutoTrace trace = AutoTrace("hcl::map::MultiPut(remote)", batch.size());
+            batch_result = RPC_CALL_WRAPPER("_MultiPut", key_int, bool, batch);
+        }
+        result = result && batch_result;
+    }
+    return result;
+}
+
+/**
+ * Get a batch of keys with one RPC per destination server.
+ * @param keys, keys to get
+ * @return one pair of bool and Value per key, in the order of keys.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::vector<std::pair<bool, MappedType>>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::MultiGet(std::vector<KeyType> &keys) {
+    typedef std::vector<std::pair<bool, MappedType>> ret_type;
+    std::vector<std::vector<size_t>> positions;
+    GroupByServer(keys, positions);
+    ret_type results;
+    for (uint16_t key_int = 0; key_int < positions.size(); ++key_int) {
+        if (positions[key_int].empty()) continue;
+        bool whole = positions[key_int].size() == keys.size();
+        std::vector<KeyType> sub_batch;
+        if (!whole) {
+            sub_batch.reserve(positions[key_int].size());
+            for (size_t i : positions[key_int]) sub_batch.push_back(keys[i]);
+        }
+        auto &batch = whole ? keys : sub_batch;
+        ret_type batch_results;
+        if (is_local(key_int)) {
+            batch_results = LocalMultiGet(batch);
+        } else {
+            AutoTrace trace = AutoTrace("hcl::map::MultiGet(remote)", batch.size());
+            batch_results = RPC_CALL_WRAPPER("_MultiGet", key_int, ret_type, batch);
+        }
+        /* A single destination already answers in the caller's order. */
+        if (whole) return batch_results;
+        if (results.empty()) results.resize(keys.size());
+        for (size_t i = 0; i < batch_results.size(); ++i) {
+            results[positions[key_int][i]] = std::move(batch_results[i]);
+        }
+    }
+    return results;
+}
+
+/**
+ * Erase a batch of keys with one RPC per destination server.
+ * @param keys, keys to erase
+ * @return one pair per key, in the order of keys; bool is true if the key
+ * was present.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::vector<std::pair<bool, MappedType>>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::MultiErase(std::vector<KeyType> &keys) {
+    if (cache != nullptr) {
+        for (auto &key : keys) cache->Invalidate(key);
+    }
+    typedef std::vector<std::pair<bool, MappedType>> ret_type;
+    std::vector<std::vector<size_t>> positions;
+    GroupByServer(keys, positions);
+    ret_type results;
+    for (uint16_t key_int = 0; key_int < positions.size(); ++key_int) {
+        if (positions[key_int].empty()) continue;
+        bool whole = positions[key_int].size() == keys.size();
+        std::vector<KeyType> sub_batch;
+        if (!whole) {
+            sub_batch.reserve(positions[key_int].size());
+            for (size_t i : positions[key_int]) sub_batch.push_back(keys[i]);
+        }
+        auto &batch = whole ? keys : sub_batch;
+        ret_type batch_results;
+        if (is_local_write(key_int)) {
+            batch_results = LocalMultiErase(batch);
+        } else {
+            AutoTrace trace = AutoTrace("hcl::map::MultiErase(remote)", batch.size());
+            batch_results = RPC_CALL_WRAPPER("_MultiErase", key_int, ret_type, batch);
+        }
+        if (whole) return batch_results;
+        if (results.empty()) results.resize(keys.size());
+        for (size_t i = 0; i < batch_results.size(); ++i) {
+            results[positions[key_int][i]] = std::move(batch_results[i]);
+        }
+    }
+    return results;
+}
+
+/**
+ * Asynchronous Put. The request is sent immediately and the returned future
+ * yields the same result as Put; a key owned by the local server is stored
+ * before returning and the future is already ready.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::future<bool>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::AsyncPut(KeyType &key, MappedType &data) {
+    if (cache != nullptr) cache->Invalidate(key);
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalPut(key, data));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::map::AsyncPut(remote)", key, data);
+        return RPC_CALL_WRAPPER_ASYNC("_Put", key_int, bool, key, data);
+    }
+}
+
+/**
+ * Asynchronous Get; see AsyncPut.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::future<std::pair<bool, MappedType>>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::AsyncGet(KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local(key_int)) {
+        return ReadyFuture(LocalGet(key));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::map::AsyncGet(remote)", key);
+        return RPC_CALL_WRAPPER_ASYNC("_Get", key_int, ret_type, key);
+    }
+}
+
+/**
+ * Asynchronous Erase; see AsyncPut.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::future<std::pair<bool, MappedType>>
+map<KeyType, MappedType, Compare, Allocator , SharedType>::AsyncErase(KeyType &key) {
+    if (cache != nullptr) cache->Invalidate(key);
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalErase(key));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::map::AsyncErase(remote)", key);
+        return RPC_CALL_WRAPPER_ASYNC("_Erase", key_int, ret_type, key);
+    }
+}
+
+/**
+ * Hit and miss counts of the client cache; all zero if it is disabled.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+cache_stats map<KeyType, MappedType, Compare, Allocator , SharedType>::CacheStats() {
+    if (cache == nullptr) return cache_stats();
+    return cache->Stats();
+}
 
 #endif  // INCLUDE_HCL_MAP_MAP_CPP_
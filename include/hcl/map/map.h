@@ -71,25 +71,95 @@ namespace hcl {
         typedef boost::interprocess::allocator <ValueType, boost::interprocess::managed_mapped_file::segment_manager>
                 ShmemAllocator;
         typedef boost::interprocess::map <KeyType, MappedType, Compare, ShmemAllocator> MyMap;
+        /* An update sent to replicas: the key and, if still present, its value. */
+        typedef std::pair<KeyType, std::pair<bool, MappedType>> ReplicaOp;
+        /* Copies of keys owned by other servers, locked apart from mymap. */
+        struct ReplicaMap {
+            segment_mutex mutex;
+            MyMap map;
+            explicit ReplicaMap(const ShmemAllocator &allocator)
+                    : mutex(HCL_CONF->READ_WRITE_LOCK), map(Compare(), allocator) {}
+        };
         /** Class attributes**/
         MyMap *mymap;
         std::hash<KeyType> keyHash;
 
+        /* Migration cursor: the first key the next batch looks at. */
+        KeyType migrate_cursor;
+        bool migrate_resume;
+        /* Remote Get results, when HCL_CONF->CLIENT_CACHE_SIZE is set. */
+        std::unique_ptr<client_cache<KeyType, MappedType>> cache;
+        /* Both null without replication. */
+        ReplicaMap *replica_map;
+        std::unique_ptr<replication_queue<ReplicaOp>> replication;
+        static const bool journal_supported = journal_codec<KeyType>::supported && journal_codec<MappedType>::supported;
+        /* Hands an applied update to the journal and the replicas. Called
+         * with the map locked, so both see updates in order. */
+        void LogUpdate(size_t key_hash, const KeyType &key, bool present, const MappedType &data) {
+            NoteWrite(key_hash);
+            if constexpr (journal_supported) {
+                if (oplog != nullptr) {
+                    journal_record record(present ? JOURNAL_PUT : JOURNAL_ERASE);
+                    record << key;
+                    if (present) record << data;
+                    Journal(record);
+                }
+            }
+            if (replication != nullptr)
+                QueueReplicas(replication.get(), key_hash, ReplicaOp(key, std::pair<bool, MappedType>(present, data)));
+        }
+        void ReplayRecord(journal_reader &record) override {
+            if constexpr (journal_supported) {
+                uint8_t op = record.Op();
+                KeyType key;
+                MappedType data;
+                record >> key;
+                if (op == JOURNAL_PUT) record >> data;
+                if (!record.Valid()) return;
+                if (op == JOURNAL_PUT) LocalPut(key, data);
+                else if (op == JOURNAL_ERASE) LocalErase(key);
+            }
+        }
+        std::vector<segment_mutex *> AllocationLocks() override {
+            std::vector<segment_mutex *> locks(1, mutex);
+            if (replica_map != nullptr) locks.push_back(&replica_map->mutex);
+            return locks;
+        }
+
+        /* Groups item indices by the destination server of key_of(item). */
+        template<typename Item, typename KeyOf>
+        void GroupByServer(std::vector<Item> &items, KeyOf key_of, std::vector<std::vector<size_t>> &positions);
+        /* Groups key indices by destination server. */
+        void GroupByServer(std::vector<KeyType> &keys, std::vector<std::vector<size_t>> &positions);
+        bool MigrateStep() override;
+        std::pair<bool, MappedType> CachedGet(uint16_t key_int, KeyType &key);
 
     public:
         ~map() {
-            this->container::~container();
+            WaitForMigration();
         }
 
         void construct_shared_memory() override {
             ShmemAllocator alloc_inst(segment.get_segment_manager());
             /* Construct map in the shared memory space. */
-            mymap = segment.construct<MyMap>(name.c_str())(Compare(), alloc_inst);
+            mymap = segment.find_or_construct<MyMap>(name.c_str())(Compare(), alloc_inst);
+            ConstructLeases();
+            if (replication_factor > 1) {
+                replica_map = segment.find_or_construct<ReplicaMap>((name + "_replicas").c_str())(alloc_inst);
+                replication = std::make_unique<replication_queue<ReplicaOp>>(num_servers,
+                        [this](uint16_t server, std::vector<ReplicaOp> &ops) {
+                            return RPC_CALL_WRAPPER("_Replicate", server, bool, ops);
+                        });
+            }
+            ResetLocks();
+            OpenJournal(journal_supported);
         }
         void open_shared_memory() override {
             std::pair<MyMap*, boost::interprocess::managed_mapped_file::size_type> res;
             res = segment.find<MyMap> (name.c_str());
             mymap = res.first;
+            OpenLeases();
+            replica_map = segment.find<ReplicaMap>((name + "_replicas").c_str()).first;
         }
         void bind_functions()  override{
 /* Create a RPC server and map the methods to it. */
@@ -105,6 +175,15 @@ namespace hcl {
                     std::function<std::pair<bool, MappedType>(KeyType &)> eraseFunc(
                             std::bind(&map<KeyType, MappedType, Compare>::LocalErase, this,
                                       std::placeholders::_1));
+                    std::function<std::pair<uint64_t, std::pair<bool, MappedType>>(KeyType &)> leasedGetFunc(
+                            std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::LocalLeasedGet, this,
+                                      std::placeholders::_1));
+                    std::function<bool(std::vector<ReplicaOp> &)> replicateFunc(
+                            std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::LocalReplicate, this,
+                                      std::placeholders::_1));
+                    std::function<std::pair<bool, MappedType>(KeyType &)> replicaGetFunc(
+                            std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::LocalReplicaGet, this,
+                                      std::placeholders::_1));
                     std::function<std::vector<std::pair<KeyType, MappedType>>(void)>
                             getAllDataInServerFunc(std::bind(
                             &map<KeyType, MappedType, Compare>::LocalGetAllDataInServer,
@@ -113,12 +192,27 @@ namespace hcl {
                             containsInServerFunc(std::bind(&map<KeyType, MappedType,
                                                                    Compare>::LocalContainsInServer, this,
                                                            std::placeholders::_1, std::placeholders::_2));
+                    std::function<bool(std::vector<std::pair<KeyType, MappedType>> &)> multiPutFunc(
+                            std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::LocalMultiPut, this,
+                                      std::placeholders::_1));
+                    std::function<std::vector<std::pair<bool, MappedType>>(std::vector<KeyType> &)> multiGetFunc(
+                            std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::LocalMultiGet, this,
+                                      std::placeholders::_1));
+                    std::function<std::vector<std::pair<bool, MappedType>>(std::vector<KeyType> &)> multiEraseFunc(
+                            std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::LocalMultiErase, this,
+                                      std::placeholders::_1));
 
                     rpc->bind(func_prefix+"_Put", putFunc);
                     rpc->bind(func_prefix+"_Get", getFunc);
                     rpc->bind(func_prefix+"_Erase", eraseFunc);
+                    rpc->bind(func_prefix+"_LeasedGet", leasedGetFunc);
+                    rpc->bind(func_prefix+"_Replicate", replicateFunc);
+                    rpc->bind(func_prefix+"_ReplicaGet", replicaGetFunc);
                     rpc->bind(func_prefix+"_GetAllData", getAllDataInServerFunc);
                     rpc->bind(func_prefix+"_Contains", containsInServerFunc);
+                    rpc->bind(func_prefix+"_MultiPut", multiPutFunc);
+                    rpc->bind(func_prefix+"_MultiGet", multiGetFunc);
+                    rpc->bind(func_prefix+"_MultiErase", multiEraseFunc);
                     break;
                 }
 #endif
@@ -141,6 +235,15 @@ namespace hcl {
                     std::function<void(const tl::request &, KeyType &)> eraseFunc(
                         std::bind(&map<KeyType, MappedType, Compare>::ThalliumLocalErase, this,
                                   std::placeholders::_1, std::placeholders::_2));
+                    std::function<void(const tl::request &, KeyType &)> leasedGetFunc(
+                        std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::ThalliumLocalLeasedGet, this,
+                                  std::placeholders::_1, std::placeholders::_2));
+                    std::function<void(const tl::request &, std::vector<ReplicaOp> &)> replicateFunc(
+                        std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::ThalliumLocalReplicate, this,
+                                  std::placeholders::_1, std::placeholders::_2));
+                    std::function<void(const tl::request &, KeyType &)> replicaGetFunc(
+                        std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::ThalliumLocalReplicaGet, this,
+                                  std::placeholders::_1, std::placeholders::_2));
                     std::function<void(const tl::request &)>
                             getAllDataInServerFunc(std::bind(
                                 &map<KeyType, MappedType, Compare>::ThalliumLocalGetAllDataInServer,
@@ -151,19 +254,49 @@ namespace hcl {
                                                            std::placeholders::_1,
 							   std::placeholders::_2,
 							   std::placeholders::_3));
+                    std::function<void(const tl::request &, std::vector<std::pair<KeyType, MappedType>> &)> multiPutFunc(
+                        std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::ThalliumLocalMultiPut, this,
+                                  std::placeholders::_1, std::placeholders::_2));
+                    std::function<void(const tl::request &, std::vector<KeyType> &)> multiGetFunc(
+                        std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::ThalliumLocalMultiGet, this,
+                                  std::placeholders::_1, std::placeholders::_2));
+                    std::function<void(const tl::request &, std::vector<KeyType> &)> multiEraseFunc(
+                        std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::ThalliumLocalMultiErase, this,
+                                  std::placeholders::_1, std::placeholders::_2));
 
                     rpc->bind(func_prefix+"_Put", putFunc);
                     rpc->bind(func_prefix+"_Get", getFunc);
                     rpc->bind(func_prefix+"_Erase", eraseFunc);
+                    rpc->bind(func_prefix+"_LeasedGet", leasedGetFunc);
+                    rpc->bind(func_prefix+"_Replicate", replicateFunc);
+                    rpc->bind(func_prefix+"_ReplicaGet", replicaGetFunc);
                     rpc->bind(func_prefix+"_GetAllData", getAllDataInServerFunc);
                     rpc->bind(func_prefix+"_Contains", containsInServerFunc);
+                    rpc->bind(func_prefix+"_MultiPut", multiPutFunc);
+                    rpc->bind(func_prefix+"_MultiGet", multiGetFunc);
+                    rpc->bind(func_prefix+"_MultiErase", multiEraseFunc);
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+                    std::function<void(const tl::request &, KeyType &, tl::bulk &)> bulkPutFunc(
+                        std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::ThalliumLocalBulkPut, this,
+                                  std::placeholders::_1, std::placeholders::_2,
+                                  std::placeholders::_3));
+                    std::function<void(const tl::request &, KeyType &, tl::bulk &)> bulkGetFunc(
+                        std::bind(&map<KeyType, MappedType, Compare, Allocator, SharedType>::ThalliumLocalBulkGet, this,
+                                  std::placeholders::_1, std::placeholders::_2,
+                                  std::placeholders::_3));
+                    rpc->bind(func_prefix+"_BulkPut", bulkPutFunc);
+                    rpc->bind(func_prefix+"_BulkGet", bulkGetFunc);
+#endif
                     break;
                 }
 #endif
             }
+            bind_membership_functions();
+            bind_checkpoint_functions();
         }
 
-        explicit map(CharStruct name_ = "TEST_MAP", uint16_t port = HCL_CONF->RPC_PORT) :container(name_,port), mymap(){
+        explicit map(CharStruct name_ = "TEST_MAP", uint16_t port = HCL_CONF->RPC_PORT) :container(name_,port), mymap(), migrate_cursor(), migrate_resume(false), cache(),
+                replica_map(nullptr), replication(){
             AutoTrace trace = AutoTrace("hcl::map");
             if (is_server) {
                 construct_shared_memory();
@@ -171,6 +304,9 @@ namespace hcl {
             }else if (!is_server && server_on_node) {
                 open_shared_memory();
             }
+            WatchMembership();
+            if (HCL_CONF->CLIENT_CACHE_SIZE > 0)
+                cache = std::make_unique<client_cache<KeyType, MappedType>>(HCL_CONF->CLIENT_CACHE_SIZE);
         }
 
         MyMap *data() {
@@ -183,26 +319,60 @@ namespace hcl {
 
         std::pair<bool, MappedType> LocalGet(KeyType &key);
 
+        std::pair<uint64_t, std::pair<bool, MappedType>> LocalLeasedGet(KeyType &key);
+
         std::pair<bool, MappedType> LocalErase(KeyType &key);
 
         std::vector<std::pair<KeyType, MappedType>> LocalGetAllDataInServer();
 
         std::vector<std::pair<KeyType, MappedType>> LocalContainsInServer(KeyType &key_start, KeyType &key_end);
 
+        bool LocalMultiPut(std::vector<std::pair<KeyType, MappedType>> &entries);
+
+        std::vector<std::pair<bool, MappedType>> LocalMultiGet(std::vector<KeyType> &keys);
+
+        std::vector<std::pair<bool, MappedType>> LocalMultiErase(std::vector<KeyType> &keys);
+
+        bool LocalReplicate(std::vector<ReplicaOp> &ops);
+
+        std::pair<bool, MappedType> LocalReplicaGet(KeyType &key);
+
 #if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
         THALLIUM_DEFINE(LocalPut, (key,data), KeyType &key, MappedType &data)
         THALLIUM_DEFINE(LocalGet, (key), KeyType &key)
+        THALLIUM_DEFINE(LocalLeasedGet, (key), KeyType &key)
         THALLIUM_DEFINE(LocalErase, (key), KeyType &key)
         THALLIUM_DEFINE(LocalContainsInServer, (key_start, key_end), KeyType &key_start, KeyType &key_end)
         THALLIUM_DEFINE1(LocalGetAllDataInServer)
+        THALLIUM_DEFINE(LocalMultiPut, (entries), std::vector<std::pair<KeyType, MappedType>> &entries)
+        THALLIUM_DEFINE(LocalMultiGet, (keys), std::vector<KeyType> &keys)
+        THALLIUM_DEFINE(LocalMultiErase, (keys), std::vector<KeyType> &keys)
+        THALLIUM_DEFINE(LocalReplicate, (ops), std::vector<ReplicaOp> &ops)
+        THALLIUM_DEFINE(LocalReplicaGet, (key), KeyType &key)
+#endif
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        /* Bulk variants of Put and Get; see container::UseBulk. */
+        void ThalliumLocalBulkPut(const tl::request &thallium_req, KeyType &key, tl::bulk &bulk_handle);
+        void ThalliumLocalBulkGet(const tl::request &thallium_req, KeyType &key, tl::bulk &bulk_handle);
 #endif
 
         bool Put(KeyType &key, MappedType &data);
 
         std::pair<bool, MappedType> Get(KeyType &key);
 
+        value_view<MappedType> GetView(KeyType &key);
+
+        template<typename Visitor>
+        bool WithValue(KeyType &key, Visitor visitor);
+
         std::pair<bool, MappedType> Erase(KeyType &key);
 
+        std::future<bool> AsyncPut(KeyType &key, MappedType &data);
+
+        std::future<std::pair<bool, MappedType>> AsyncGet(KeyType &key);
+
+        std::future<std::pair<bool, MappedType>> AsyncErase(KeyType &key);
+
         std::vector<std::pair<KeyType, MappedType>> Contains(KeyType &key_start, KeyType &key_end);
 
         std::vector<std::pair<KeyType, MappedType>> GetAllData();
@@ -210,6 +380,14 @@ namespace hcl {
         std::vector<std::pair<KeyType, MappedType>> ContainsInServer(KeyType &key_start, KeyType &key_end);
 
         std::vector<std::pair<KeyType, MappedType>> GetAllDataInServer();
+
+        bool MultiPut(std::vector<std::pair<KeyType, MappedType>> &entries);
+
+        std::vector<std::pair<bool, MappedType>> MultiGet(std::vector<KeyType> &keys);
+
+        std::vector<std::pair<bool, MappedType>> MultiErase(std::vector<KeyType> &keys);
+
+        cache_stats CacheStats();
     };
 
 #include "map.cpp"
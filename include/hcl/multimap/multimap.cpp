@@ -16,12 +16,12 @@
 /* Constructor to deallocate the shared memory*/
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
 multimap<KeyType, MappedType, Compare, Allocator , SharedType>::~multimap() {
-    this->container::~container();
+    WaitForMigration();
 }
 
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
 multimap<KeyType, MappedType, Compare, Allocator , SharedType>::multimap(CharStruct name_, uint16_t port)
-                 : container(name_,port),mymap() {
+                 : container(name_,port),mymap(), migrate_cursor(), migrate_resume(false) {
     AutoTrace trace = AutoTrace("hcl::multimap");
     if (is_server) {
         construct_shared_memory();
@@ -29,6 +29,7 @@ multimap<KeyType, MappedType, Compare, Allocator , SharedType>::multimap(CharStr
     }else if (!is_server && server_on_node) {
         open_shared_memory();
     }
+    WatchMembership();
 }
 
 /**
@@ -41,15 +42,109 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 bool multimap<KeyType, MappedType, Compare, Allocator , SharedType>::LocalPut(KeyType &key,
                                                       MappedType &data) {
     AutoTrace trace = AutoTrace("hcl::multimap::Put(local)", key, data);
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-            lock(*mutex);
-    typename MyMap::iterator iterator = mymap->find(key);
-    if (iterator != mymap->end()) {
-        mymap->erase(iterator);
+    size_t key_hash = keyHash(key);
+    bool forward = false;
+    bool result = GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex>
+                lock(*mutex);
+        typename MyMap::iterator iterator = mymap->find(key);
+        if (iterator != mymap->end()) {
+            mymap->erase(iterator);
+        } else if (!Stays(key_hash)) {
+            forward = true;
+            return false;
+        }
+        auto &&value = GetData<Allocator, MappedType, SharedType>(data);
+        mymap->insert(std::pair<KeyType, MappedType>(key, value));
+        NoteWrite(key_hash);
+        return true;
+    });
+    if (forward) return Forward<bool>(key_hash, "_Put", key, data);
+    return result;
+}
+
+/**
+ * Insert a batch of entries into the local multimap, keeping every entry
+ * of a key. Servers use it to hand over keys when servers join or leave.
+ * @param entries, the key-value pairs to insert
+ * @return bool, true if all the inserts were successful else false.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool multimap<KeyType, MappedType, Compare, Allocator , SharedType>::LocalMultiPut(
+        std::vector<std::pair<KeyType, MappedType>> &entries) {
+    AutoTrace trace = AutoTrace("hcl::multimap::MultiPut(local)", entries.size());
+    std::vector<std::pair<KeyType, MappedType>> moved;
+    GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex);
+        moved.clear();
+        for (auto &entry : entries) {
+            if (!Stays(keyHash(entry.first)) && mymap->find(entry.first) == mymap->end()) {
+                moved.push_back(entry);
+                continue;
+            }
+            auto &&value = GetData<Allocator, MappedType, SharedType>(entry.second);
+            mymap->insert(std::pair<KeyType, MappedType>(entry.first, value));
+            NoteWrite(keyHash(entry.first));
+        }
+        return true;
+    });
+    bool result = true;
+    for (auto &entry : moved) {
+        std::vector<std::pair<KeyType, MappedType>> single(1, entry);
+        bool moved_result = Forward<bool>(keyHash(entry.first), "_MultiPut", single);
+        result = result && moved_result;
+    }
+    return result;
+}
+
+/**
+ * Moves the keys owned elsewhere in the next membership among the next
+ * MIGRATION_BATCH entries, resuming where the previous batch stopped. All
+ * entries of a key move together, so a batch may run over to finish a key.
+ * The multimap is only locked to copy the batch and to erase what arrived
+ * (see HandOver).
+ * @return bool, false once the end of the multimap was reached
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool multimap<KeyType, MappedType, Compare, Allocator , SharedType>::MigrateStep() {
+    const partitioner *next = next_routing.load();
+    if (next == nullptr) {
+        migrate_resume = false;
+        return false;
+    }
+    typedef std::pair<KeyType, MappedType> Entry;
+    std::vector<handover_batch<KeyType, Entry>> outgoing(next->NumServers());
+    {
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex);
+        typename MyMap::iterator iterator = migrate_resume ? mymap->lower_bound(migrate_cursor) : mymap->begin();
+        std::vector<size_t> hashes;
+        size_t scanned = 0;
+        while (iterator != mymap->end() && scanned < MIGRATION_BATCH) {
+            typename MyMap::iterator key_end = mymap->upper_bound(iterator->first);
+            size_t key_hash = keyHash(iterator->first);
+            uint16_t owner = next->GetServer(key_hash);
+            if (owner != my_server) {
+                outgoing[owner].keys.push_back(iterator->first);
+                outgoing[owner].hashes.push_back(key_hash);
+                hashes.push_back(key_hash);
+            }
+            for (; iterator != key_end; ++iterator, ++scanned) {
+                if (owner != my_server) outgoing[owner].entries.push_back(Entry(iterator->first, iterator->second));
+            }
+        }
+        migrate_resume = iterator != mymap->end();
+        if (migrate_resume) migrate_cursor = iterator->first;
+        StartHandover(hashes);
     }
-    auto value = GetData<Allocator, MappedType, SharedType>(data);
-    mymap->insert(std::pair<KeyType, MappedType>(key, value));
-    return true;
+    typedef std::pair<bool, MappedType> erase_type;
+    HandOver<erase_type>(*mutex, outgoing,
+        [this](KeyType &key, std::vector<Entry> &entries) {
+            auto range = mymap->equal_range(key);
+            for (auto iterator = range.first; iterator != range.second; ++iterator)
+                entries.push_back(Entry(iterator->first, iterator->second));
+        },
+        [this](KeyType &key) { mymap->erase(key); });
+    return migrate_resume;
 }
 
 /**
@@ -63,7 +158,7 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 bool multimap<KeyType, MappedType, Compare, Allocator , SharedType>::Put(KeyType &key,
                                                  MappedType &data) {
     size_t key_hash = keyHash(key);
-    uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
+    uint16_t key_int = GetServer(key_hash);
     if (is_local(key_int)) {
         return LocalPut(key, data);
     } else {
@@ -84,14 +179,18 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 std::pair<bool, MappedType>
 multimap<KeyType, MappedType, Compare, Allocator , SharedType>::LocalGet(KeyType &key) {
     AutoTrace trace = AutoTrace("hcl::multimap::Get(local)", key);
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-            lock(*mutex);
-    typename MyMap::iterator iterator = mymap->find(key);
-    if (iterator != mymap->end()) {
-        return std::pair<bool, MappedType>(true, iterator->second);
-    } else {
-        return std::pair<bool, MappedType>(false, MappedType());
+    size_t key_hash = keyHash(key);
+    {
+        boost::interprocess::sharable_lock<segment_mutex>
+                lock(*mutex);
+        typename MyMap::iterator iterator = mymap->find(key);
+        if (iterator != mymap->end()) {
+            return std::pair<bool, MappedType>(true, iterator->second);
+        }
+        if (Stays(key_hash)) return std::pair<bool, MappedType>(false, MappedType());
     }
+    typedef std::pair<bool, MappedType> ret_type;
+    return Forward<ret_type>(key_hash, "_Get", key);
 }
 
 /**
@@ -105,7 +204,7 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 std::pair<bool, MappedType>
 multimap<KeyType, MappedType, Compare, Allocator , SharedType>::Get(KeyType &key) {
     size_t key_hash = keyHash(key);
-    uint16_t key_int = key_hash % num_servers;
+    uint16_t key_int = GetServer(key_hash);
     if (is_local(key_int)) {
         return LocalGet(key);
     } else {
@@ -120,17 +219,23 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 std::pair<bool, MappedType>
 multimap<KeyType, MappedType, Compare, Allocator , SharedType>::LocalErase(KeyType &key) {
     AutoTrace trace = AutoTrace("hcl::multimap::Erase(local)", key);
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-            lock(*mutex);
-    size_t s = mymap->erase(key);
-    return std::pair<bool, MappedType>(s > 0, MappedType());
+    size_t key_hash = keyHash(key);
+    {
+        boost::interprocess::scoped_lock<segment_mutex>
+                lock(*mutex);
+        size_t s = mymap->erase(key);
+        if (s > 0) NoteWrite(key_hash);
+        if (s > 0 || Stays(key_hash)) return std::pair<bool, MappedType>(s > 0, MappedType());
+    }
+    typedef std::pair<bool, MappedType> ret_type;
+    return Forward<ret_type>(key_hash, "_Erase", key);
 }
 
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
 std::pair<bool, MappedType>
 multimap<KeyType, MappedType, Compare, Allocator , SharedType>::Erase(KeyType &key) {
     size_t key_hash = keyHash(key);
-    uint16_t key_int = key_hash % num_servers;
+    uint16_t key_int = GetServer(key_hash);
     if (is_local(key_int)) {
         return LocalErase(key);
     } else {
@@ -151,39 +256,34 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 std::vector<std::pair<KeyType, MappedType>>
 multimap<KeyType, MappedType, Compare, Allocator , SharedType>::Contains(KeyType &key) {
     AutoTrace trace = AutoTrace("hcl::multimap::Contains", key);
-    std::vector<std::pair<KeyType, MappedType>> final_values =
-            std::vector<std::pair<KeyType, MappedType>>();
-    auto current_server = ContainsInServer(key);
-    final_values.insert(final_values.end(), current_server.begin(),
-                        current_server.end());
-    for (int i = 0; i < num_servers; ++i) {
-        if (i != my_server) {
-            typedef std::vector<std::pair<KeyType, MappedType>> ret_type;
-            auto server = RPC_CALL_WRAPPER("_Contains", i, ret_type,
-                                           key);
-            final_values.insert(final_values.end(), server.begin(), server.end());
+    typedef std::vector<std::pair<KeyType, MappedType>> ret_type;
+    auto per_server = FanOut<ret_type>([&](uint16_t server) -> std::future<ret_type> {
+        if (server == my_server) {
+            return std::async(std::launch::deferred, [&]() { return ContainsInServer(key); });
         }
-    }
-    return final_values;
+        return RPC_CALL_WRAPPER_ASYNC("_Contains", server, ret_type, key);
+    });
+    return MergeSorted(per_server, [](const std::pair<KeyType, MappedType> &a,
+                                      const std::pair<KeyType, MappedType> &b) {
+        return Compare()(a.first, b.first);
+    });
 }
 
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
 std::vector<std::pair<KeyType, MappedType>>
 multimap<KeyType, MappedType, Compare, Allocator , SharedType>::GetAllData() {
     AutoTrace trace = AutoTrace("hcl::multimap::GetAllData");
-    std::vector<std::pair<KeyType, MappedType>> final_values =
-            std::vector<std::pair<KeyType, MappedType>>();
-    auto current_server = GetAllDataInServer();
-    final_values.insert(final_values.end(), current_server.begin(),
-                        current_server.end());
-    for (int i = 0; i < num_servers; ++i) {
-        if (i != my_server) {
-            typedef std::vector<std::pair<KeyType, MappedType> > ret_type;
-            auto server = RPC_CALL_WRAPPER1("_GetAllData", i, ret_type);
-            final_values.insert(final_values.end(), server.begin(), server.end());
+    typedef std::vector<std::pair<KeyType, MappedType> > ret_type;
+    auto per_server = FanOut<ret_type>([&](uint16_t server) -> std::future<ret_type> {
+        if (server == my_server) {
+            return std::async(std::launch::deferred, [&]() { return GetAllDataInServer(); });
         }
-    }
-    return final_values;
+        return RPC_CALL_WRAPPER_ASYNC1("_GetAllData", server, ret_type);
+    });
+    return MergeSorted(per_server, [](const std::pair<KeyType, MappedType> &a,
+                                      const std::pair<KeyType, MappedType> &b) {
+        return Compare()(a.first, b.first);
+    });
 }
 
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
@@ -193,7 +293,7 @@ multimap<KeyType, MappedType, Compare, Allocator , SharedType>::LocalContainsInS
     std::vector<std::pair<KeyType, MappedType>> final_values =
             std::vector<std::pair<KeyType, MappedType>>();
     {
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
+        boost::interprocess::sharable_lock<segment_mutex>
                 lock(*mutex);
         typename MyMap::iterator lower_bound;
         size_t size = mymap->size();
@@ -243,7 +343,7 @@ multimap<KeyType, MappedType, Compare, Allocator , SharedType>::LocalGetAllDataI
     std::vector<std::pair<KeyType, MappedType>> final_values =
             std::vector<std::pair<KeyType, MappedType>>();
     {
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
+        boost::interprocess::sharable_lock<segment_mutex>
                 lock(*mutex);
         typename MyMap::iterator lower_bound;
         lower_bound = mymap->begin();
@@ -273,7 +373,7 @@ template<typename KeyType, typename MappedType, typename Compare, typename Alloc
 void multimap<KeyType, MappedType, Compare, Allocator , SharedType>::construct_shared_memory() {
     ShmemAllocator alloc_inst(segment.get_segment_manager());
     /* Construct Multimap in the shared memory space. */
-    mymap = segment.construct<MyMap>(name.c_str())(Compare(), alloc_inst);
+    mymap = segment.find_or_construct<MyMap>(name.c_str())(Compare(), alloc_inst);
 }
 
 template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
@@ -307,12 +407,16 @@ void multimap<KeyType, MappedType, Compare, Allocator , SharedType>::bind_functi
                     containsInServerFunc(std::bind(&multimap<KeyType, MappedType,
                                                            Compare>::LocalContainsInServer, this,
                                                    std::placeholders::_1));
+            std::function<bool(std::vector<std::pair<KeyType, MappedType>> &)> multiPutFunc(
+                    std::bind(&multimap<KeyType, MappedType, Compare, Allocator , SharedType>::LocalMultiPut, this,
+                              std::placeholders::_1));
 
             rpc->bind(func_prefix+"_Put", putFunc);
             rpc->bind(func_prefix+"_Get", getFunc);
             rpc->bind(func_prefix+"_Erase", eraseFunc);
             rpc->bind(func_prefix+"_GetAllData", getAllDataInServerFunc);
             rpc->bind(func_prefix+"_Contains", containsInServerFunc);
+            rpc->bind(func_prefix+"_MultiPut", multiPutFunc);
             break;
         }
 #endif
@@ -344,16 +448,74 @@ void multimap<KeyType, MappedType, Compare, Allocator , SharedType>::bind_functi
                                                            Compare>::ThalliumLocalContainsInServer, this,
                                                            std::placeholders::_1,
 							   std::placeholders::_2));
+                    std::function<void(const tl::request &, std::vector<std::pair<KeyType, MappedType>> &)> multiPutFunc(
+                        std::bind(&multimap<KeyType, MappedType, Compare, Allocator , SharedType>::ThalliumLocalMultiPut, this,
+                                  std::placeholders::_1, std::placeholders::_2));
 
                     rpc->bind(func_prefix+"_Put", putFunc);
                     rpc->bind(func_prefix+"_Get", getFunc);
                     rpc->bind(func_prefix+"_Erase", eraseFunc);
                     rpc->bind(func_prefix+"_GetAllData", getAllDataInServerFunc);
                     rpc->bind(func_prefix+"_Contains", containsInServerFunc);
+                    rpc->bind(func_prefix+"_MultiPut", multiPutFunc);
                     break;
                 }
 #endif
     }
+    bind_membership_functions();
+    bind_checkpoint_functions();
+}
+
+/**
+ * Asynchronous Put. The request is sent immediately and the returned future
+ * yields the same result as Put; a key owned by the local server is stored
+ * before returning and the future is already ready.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::future<bool>
+multimap<KeyType, MappedType, Compare, Allocator , SharedType>::AsyncPut(KeyType &key, MappedType &data) {
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local(key_int)) {
+        return ReadyFuture(LocalPut(key, data));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::multimap::AsyncPut(remote)", key, data);
+        return RPC_CALL_WRAPPER_ASYNC("_Put", key_int, bool, key, data);
+    }
+}
+
+/**
+ * Asynchronous Get; see AsyncPut.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::future<std::pair<bool, MappedType>>
+multimap<KeyType, MappedType, Compare, Allocator , SharedType>::AsyncGet(KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local(key_int)) {
+        return ReadyFuture(LocalGet(key));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::multimap::AsyncGet(remote)", key);
+        return RPC_CALL_WRAPPER_ASYNC("_Get", key_int, ret_type, key);
+    }
+}
+
+/**
+ * Asynchronous Erase; see AsyncPut.
+ */
+template<typename KeyType, typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::future<std::pair<bool, MappedType>>
+multimap<KeyType, MappedType, Compare, Allocator , SharedType>::AsyncErase(KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local(key_int)) {
+        return ReadyFuture(LocalErase(key));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::multimap::AsyncErase(remote)", key);
+        return RPC_CALL_WRAPPER_ASYNC("_Erase", key_int, ret_type, key);
+    }
 }
 
 #endif  // INCLUDE_HCL_MULTIMAP_MULTIMAP_CPP_
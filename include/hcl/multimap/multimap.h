@@ -70,6 +70,11 @@ class multimap:public container {
     /** Class attributes**/
     std::hash<KeyType> keyHash;
     MyMap *mymap;
+    /* Migration cursor: the first key the next batch looks at. */
+    KeyType migrate_cursor;
+    bool migrate_resume;
+
+    bool MigrateStep() override;
 
   public:
     /* Constructor to deallocate the shared memory*/
@@ -92,6 +97,7 @@ class multimap:public container {
     std::pair<bool, MappedType> LocalErase(KeyType &key);
     std::vector<std::pair<KeyType, MappedType>> LocalContainsInServer(KeyType &key);
     std::vector<std::pair<KeyType, MappedType>> LocalGetAllDataInServer();
+    bool LocalMultiPut(std::vector<std::pair<KeyType, MappedType>> &entries);
 
 #if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
     THALLIUM_DEFINE(LocalPut, (key, data), KeyType &key, MappedType &data)
@@ -99,12 +105,16 @@ class multimap:public container {
     THALLIUM_DEFINE(LocalErase, (key), KeyType &key)
     THALLIUM_DEFINE(LocalContainsInServer, (key), KeyType &key)
     THALLIUM_DEFINE1(LocalGetAllDataInServer)
+    THALLIUM_DEFINE(LocalMultiPut, (entries), std::vector<std::pair<KeyType, MappedType>> &entries)
 #endif
 
     bool Put(KeyType &key, MappedType &data);
     std::pair<bool, MappedType> Get(KeyType &key);
 
     std::pair<bool, MappedType> Erase(KeyType &key);
+    std::future<bool> AsyncPut(KeyType &key, MappedType &data);
+    std::future<std::pair<bool, MappedType>> AsyncGet(KeyType &key);
+    std::future<std::pair<bool, MappedType>> AsyncErase(KeyType &key);
     std::vector<std::pair<KeyType, MappedType>> Contains(KeyType &key);
 
     std::vector<std::pair<KeyType, MappedType>> GetAllData();
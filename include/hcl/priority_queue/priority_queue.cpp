@@ -16,11 +16,12 @@
 /* Constructor to deallocate the shared memory*/
 template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
 priority_queue<MappedType, Compare, Allocator , SharedType>::~priority_queue() {
-    this->container::~container();
 }
 
 template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
-priority_queue<MappedType, Compare, Allocator , SharedType>::priority_queue(CharStruct name_, uint16_t port):container(name_,port),queue(){
+priority_queue<MappedType, Compare, Allocator , SharedType>::priority_queue(CharStruct name_, uint16_t port,
+                                                                            uint16_t sub_queues_)
+        :container(name_,port),sub_queues(nullptr),num_sub_queues(sub_queues_ > 0 ? sub_queues_ : 1),compare(){
     AutoTrace trace = AutoTrace("hcl::priority_queue");
     if (is_server) {
         construct_shared_memory();
@@ -31,7 +32,8 @@ priority_queue<MappedType, Compare, Allocator , SharedType>::priority_queue(Char
 }
 
 /**
- * Push the data into the local priority queue.
+ * Push the data into the local priority queue; a relaxed queue puts it
+ * into a random sub-queue.
  * @param key, the key for put
  * @param data, the value for put
  * @return bool, true if Put was successful else false.
@@ -39,10 +41,17 @@ priority_queue<MappedType, Compare, Allocator , SharedType>::priority_queue(Char
 template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
 bool priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPush(MappedType &data) {
     AutoTrace trace = AutoTrace("hcl::priority_queue::Push(local)", data);
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
-    auto value = GetData<Allocator, MappedType, SharedType>(data);
-    queue->push(value);
-    return true;
+    journal_commit commit(oplog.get());
+    uint16_t index = RandomSubQueue();
+    SubQueue &sub_queue = sub_queues[index];
+    bool pushed = GrowOnBadAlloc([&]() {
+        bip::scoped_lock<segment_mutex> lock(sub_queue.mutex);
+        auto &&value = GetData<Allocator, MappedType, SharedType>(data);
+        sub_queue.heap.push(value);
+        LogUpdate(JOURNAL_PUSH, index, data);
+        return true;
+    });
+    return commit.Done() && pushed;
 }
 
 /**
@@ -55,7 +64,7 @@ bool priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPush(Mapp
 template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
 bool priority_queue<MappedType, Compare, Allocator , SharedType>::Push(MappedType &data,
                                                uint16_t &key_int) {
-    if (is_local(key_int)) {
+    if (is_local_write(key_int)) {
         return LocalPush(data);
     } else {
         AutoTrace trace = AutoTrace("hcl::priority_queue::Push(remote)",
@@ -75,11 +84,56 @@ template<typename MappedType, typename Compare, typename Allocator , typename Sh
 std::pair<bool, MappedType>
 priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPop() {
     AutoTrace trace = AutoTrace("hcl::priority_queue::Pop(local)");
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
-    if (queue->size() > 0) {
-        MappedType value = queue->top();
-        queue->pop();
-        return std::pair<bool, MappedType>(true, value);
+    journal_commit commit(oplog.get());
+    std::pair<bool, MappedType> result = LocalPopOne();
+    if (result.first && !commit.Done()) return std::pair<bool, MappedType>(false, MappedType());
+    return result;
+}
+
+/**
+ * Pops one element; the caller commits the journal. A relaxed queue reads
+ * the tops of two random sub-queues under their sharable locks, one at a
+ * time, and then locks only the better one, without waiting for it. If it
+ * is taken, or its top is no longer the better of the two, another pair is
+ * tried. After RELAXED_POP_ATTEMPTS pairs, or if both were empty, the
+ * sub-queues are locked in turn, so a pop finds an element whenever the
+ * server has one.
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::pair<bool, MappedType>
+priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPopOne() {
+    uint16_t first = RandomSubQueue();
+    for (int attempt = 0; num_sub_queues > 1 && attempt < RELAXED_POP_ATTEMPTS; ++attempt) {
+        uint16_t candidates[2] = {first, RandomSubQueue()};
+        std::pair<bool, MappedType> tops[2];
+        for (int i = 0; i < 2; ++i) {
+            bip::sharable_lock<segment_mutex> lock(sub_queues[candidates[i]].mutex);
+            Queue &heap = sub_queues[candidates[i]].heap;
+            if (!heap.empty()) tops[i] = std::pair<bool, MappedType>(true, heap.top());
+        }
+        if (!tops[0].first && !tops[1].first) break;
+        int best = !tops[0].first || (tops[1].first && compare(tops[0].second, tops[1].second)) ? 1 : 0;
+        std::pair<bool, MappedType> &other = tops[1 - best];
+        bip::scoped_lock<segment_mutex> lock(sub_queues[candidates[best]].mutex, bip::try_to_lock);
+        Queue &heap = sub_queues[candidates[best]].heap;
+        if (lock.owns() && !heap.empty() && !(other.first && compare(heap.top(), other.second))) {
+            MappedType value = heap.top();
+            heap.pop();
+            LogUpdate(JOURNAL_POP, candidates[best], value);
+            return std::pair<bool, MappedType>(true, value);
+        }
+        first = RandomSubQueue();
+    }
+    for (uint16_t offset = 0; offset < num_sub_queues; ++offset) {
+        uint16_t index = (first + offset) % num_sub_queues;
+        bip::scoped_lock<segment_mutex> lock(sub_queues[index].mutex);
+        Queue &heap = sub_queues[index].heap;
+        if (!heap.empty()) {
+            MappedType value = heap.top();
+            heap.pop();
+            LogUpdate(JOURNAL_POP, index, value);
+            return std::pair<bool, MappedType>(true, value);
+        }
     }
     return std::pair<bool, MappedType>(false, MappedType());
 }
@@ -94,7 +148,7 @@ priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPop() {
 template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
 std::pair<bool, MappedType>
 priority_queue<MappedType, Compare, Allocator , SharedType>::Pop(uint16_t &key_int) {
-    if (is_local(key_int)) {
+    if (is_local_write(key_int)) {
         return LocalPop();
     } else {
         AutoTrace trace = AutoTrace("hcl::priority_queue::Pop(remote)",
@@ -105,7 +159,298 @@ priority_queue<MappedType, Compare, Allocator , SharedType>::Pop(uint16_t &key_i
 }
 
 /**
- * Get the data from the local priority queue.
+ * Push all of data into the local priority queue under one lock
+ * acquisition per sub-queue. A relaxed queue deals the values out to its
+ * sub-queues in turn, so sorted input does not end up in one of them. Each
+ * sub-queue appends its share to the heap's storage and orders it together
+ * (see dary_heap::restore).
+ * @param data, the values to push
+ * @return bool, true if all values were pushed
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPushN(std::vector<MappedType> &data) {
+    AutoTrace trace = AutoTrace("hcl::priority_queue::PushN(local)", data.size());
+    journal_commit commit(oplog.get());
+    size_t parts = std::min<size_t>(num_sub_queues, data.size());
+    uint16_t start = RandomSubQueue();
+    bool pushed = true;
+    for (size_t part = 0; part < parts; ++part) {
+        pushed = PushTo((start + part) % num_sub_queues, data, part, parts) && pushed;
+    }
+    return commit.Done() && pushed;
+}
+
+/* Pushes data[first], data[first + stride], ... into sub-queue index. */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool priority_queue<MappedType, Compare, Allocator , SharedType>::PushTo(uint16_t index, std::vector<MappedType> &data,
+                                                                         size_t first, size_t stride) {
+    SubQueue &sub_queue = sub_queues[index];
+    /* Values already pushed stay pushed if the segment has to grow: with a
+     * SharedType every value allocates, so a retry goes on from next. */
+    size_t next = first;
+    return GrowOnBadAlloc([&]() {
+        bip::scoped_lock<segment_mutex> lock(sub_queue.mutex);
+        size_t appended = 0;
+        try {
+            sub_queue.heap.reserve(sub_queue.heap.size() + (data.size() - next + stride - 1) / stride);
+            for (; next < data.size(); next += stride) {
+                auto &&value = GetData<Allocator, MappedType, SharedType>(data[next]);
+                sub_queue.heap.append(value);
+                LogUpdate(JOURNAL_PUSH, index, data[next]);
+                appended++;
+            }
+        } catch (...) {
+            /* Order what was appended before the lock is released. */
+            sub_queue.heap.restore(appended);
+            throw;
+        }
+        sub_queue.heap.restore(appended);
+        return true;
+    });
+}
+
+/**
+ * Push all of data into the priority queue of server key_int with one call.
+ * @param data, the values to push
+ * @param key_int, key_int to know which server
+ * @return bool, true if all values were pushed
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool priority_queue<MappedType, Compare, Allocator , SharedType>::PushN(std::vector<MappedType> &data,
+                                                uint16_t &key_int) {
+    if (is_local_write(key_int)) {
+        return LocalPushN(data);
+    } else {
+        AutoTrace trace = AutoTrace("hcl::priority_queue::PushN(remote)", data.size(), key_int);
+        return RPC_CALL_WRAPPER("_PushN", key_int, bool, data);
+    }
+}
+
+/**
+ * Pop the top max_count values of the local priority queue under one lock
+ * acquisition. A relaxed queue makes a separate two-choice pop for each
+ * value, so the values come out in roughly, not strictly, priority order.
+ * @param max_count, the most values to pop
+ * @return the popped values in priority order; empty if the queue was
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::vector<MappedType>
+priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPopN(uint32_t max_count) {
+    AutoTrace trace = AutoTrace("hcl::priority_queue::PopN(local)", max_count);
+    journal_commit commit(oplog.get());
+    std::vector<MappedType> values;
+    if (num_sub_queues > 1) {
+        while (values.size() < max_count) {
+            std::pair<bool, MappedType> result = LocalPopOne();
+            if (!result.first) break;
+            values.push_back(result.second);
+        }
+    } else {
+        bip::scoped_lock<segment_mutex> lock(sub_queues[0].mutex);
+        Queue &heap = sub_queues[0].heap;
+        values.reserve(std::min<size_t>(max_count, heap.size()));
+        while (values.size() < max_count && !heap.empty()) {
+            values.push_back(heap.top());
+            heap.pop();
+            LogUpdate(JOURNAL_POP, 0, values.back());
+        }
+    }
+    if (!values.empty() && !commit.Done()) values.clear();
+    return values;
+}
+
+/**
+ * Pop the top max_count values of the priority queue of server key_int
+ * with one call.
+ * @param max_count, the most values to pop
+ * @param key_int, key_int to know which server
+ * @return the popped values in priority order; empty if the queue was
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::vector<MappedType>
+priority_queue<MappedType, Compare, Allocator , SharedType>::PopN(uint32_t max_count, uint16_t &key_int) {
+    if (is_local_write(key_int)) {
+        return LocalPopN(max_count);
+    } else {
+        AutoTrace trace = AutoTrace("hcl::priority_queue::PopN(remote)", max_count, key_int);
+        typedef std::vector<MappedType> ret_type;
+        return RPC_CALL_WRAPPER("_PopN", key_int, ret_type, max_count);
+    }
+}
+
+/**
+ * Read the top max_count values of the local priority queue without
+ * popping them. The sub-queues of a relaxed queue are read one after the
+ * other and merged.
+ * @param max_count, the most values to return
+ * @return the values in priority order
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::vector<MappedType>
+priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPeekN(uint32_t max_count) {
+    AutoTrace trace = AutoTrace("hcl::priority_queue::PeekN(local)", max_count);
+    std::vector<std::vector<MappedType>> runs;
+    runs.reserve(num_sub_queues);
+    for (uint16_t i = 0; i < num_sub_queues; ++i) {
+        bip::sharable_lock<segment_mutex> lock(sub_queues[i].mutex);
+        runs.push_back(sub_queues[i].heap.peek(max_count));
+    }
+    if (runs.size() == 1) return runs[0];
+    std::vector<MappedType> values = MergeSorted(runs, [this](const MappedType &a, const MappedType &b) {
+        return compare(b, a);
+    });
+    if (values.size() > max_count) values.resize(max_count);
+    return values;
+}
+
+/**
+ * Read the top max_count values of the priority queue of server key_int
+ * without popping them.
+ * @param max_count, the most values to return
+ * @param key_int, key_int to know which server
+ * @return the values in priority order
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::vector<MappedType>
+priority_queue<MappedType, Compare, Allocator , SharedType>::PeekN(uint32_t max_count, uint16_t &key_int) {
+    if (is_local(key_int)) {
+        return LocalPeekN(max_count);
+    } else {
+        AutoTrace trace = AutoTrace("hcl::priority_queue::PeekN(remote)", max_count, key_int);
+        typedef std::vector<MappedType> ret_type;
+        return RPC_CALL_WRAPPER("_PeekN", key_int, ret_type, max_count);
+    }
+}
+
+/**
+ * Change the priority of an element of the local priority queue: the
+ * first element equal to old_value is replaced by new_value, which then
+ * moves to its place in the heap.
+ * @param old_value, the element as it is in the queue
+ * @param new_value, the element with its new priority
+ * @return bool, false if no element equals old_value
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool priority_queue<MappedType, Compare, Allocator , SharedType>::LocalUpdatePriority(MappedType &old_value,
+                                                                                    MappedType &new_value) {
+    AutoTrace trace = AutoTrace("hcl::priority_queue::UpdatePriority(local)", old_value, new_value);
+    journal_commit commit(oplog.get());
+    bool updated = false;
+    for (uint16_t i = 0; i < num_sub_queues && !updated; ++i) {
+        bip::scoped_lock<segment_mutex> lock(sub_queues[i].mutex);
+        updated = sub_queues[i].heap.update(old_value, new_value);
+        if (updated) LogUpdate(JOURNAL_UPDATE, i, old_value, new_value);
+    }
+    return updated && commit.Done();
+}
+
+/**
+ * Change the priority of an element of the priority queue of server
+ * key_int; see LocalUpdatePriority. Only bound for element types with an
+ * operator==.
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+bool priority_queue<MappedType, Compare, Allocator , SharedType>::UpdatePriority(MappedType &old_value,
+                                                                               MappedType &new_value,
+                                                                               uint16_t &key_int) {
+    static_assert(is_equality_comparable<MappedType>::value,
+                  "UpdatePriority finds the element with MappedType::operator==");
+    if (is_local_write(key_int)) {
+        return LocalUpdatePriority(old_value, new_value);
+    } else {
+        AutoTrace trace = AutoTrace("hcl::priority_queue::UpdatePriority(remote)", old_value, new_value, key_int);
+        return RPC_CALL_WRAPPER("_UpdatePriority", key_int, bool, old_value, new_value);
+    }
+}
+
+/**
+ * The top k values over all servers. Every server is asked for its own
+ * top k at once and the sorted replies are merged, so this takes one round
+ * trip whatever the number of servers.
+ * @param k, the most values to return
+ * @return the values in priority order
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::vector<MappedType> priority_queue<MappedType, Compare, Allocator , SharedType>::GlobalTopK(uint32_t k) {
+    AutoTrace trace = AutoTrace("hcl::priority_queue::GlobalTopK", k);
+    typedef std::vector<MappedType> ret_type;
+    std::vector<ret_type> runs = FanOut<ret_type>([this, &k](uint16_t server) -> std::future<ret_type> {
+        if (is_local(server)) return ReadyFuture(LocalPeekN(k));
+        auto reply = RPC_CALL_WRAPPER_ASYNC("_PeekN", server, ret_type, k);
+        return reply;
+    });
+    ret_type values = MergeSorted(runs, [this](const MappedType &a, const MappedType &b) { return compare(b, a); });
+    if (values.size() > k) values.resize(k);
+    return values;
+}
+
+/**
+ * Pop the top value over all servers. The tops of all servers are read at
+ * once and the server holding the highest one is popped. Another client
+ * may pop that value in between, in which case the next value of the same
+ * server is returned; if that server has run empty the tops are read again.
+ * @return return a pair of bool and Value. bool is false only if every
+ * server was empty
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::pair<bool, MappedType> priority_queue<MappedType, Compare, Allocator , SharedType>::GlobalPop() {
+    AutoTrace trace = AutoTrace("hcl::priority_queue::GlobalPop");
+    typedef std::pair<bool, MappedType> ret_type;
+    while (true) {
+        std::vector<ret_type> tops = FanOut<ret_type>([this](uint16_t server) -> std::future<ret_type> {
+            if (is_local(server)) return ReadyFuture(LocalTop());
+            auto reply = RPC_CALL_WRAPPER_ASYNC1("_Top", server, ret_type);
+            return reply;
+        });
+        int best = -1;
+        for (uint16_t server = 0; server < tops.size(); ++server) {
+            if (tops[server].first && (best < 0 || compare(tops[best].second, tops[server].second))) best = server;
+        }
+        if (best < 0) return ret_type(false, MappedType());
+        uint16_t server = best;
+        ret_type result = Pop(server);
+        if (result.first) return result;
+    }
+}
+
+/**
+ * The two-choice pop of a relaxed queue across servers: the tops of two
+ * random servers are read at once and the better one is popped. This
+ * spreads consumers over the servers instead of sending all of them to the
+ * server with the highest top, as GlobalPop does. Falls back to GlobalPop
+ * when both servers are empty.
+ * @return return a pair of bool and Value. bool is false only if every
+ * server was empty
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::pair<bool, MappedType> priority_queue<MappedType, Compare, Allocator , SharedType>::RelaxedPop() {
+    AutoTrace trace = AutoTrace("hcl::priority_queue::RelaxedPop");
+    typedef std::pair<bool, MappedType> ret_type;
+    uint16_t servers = Routing()->NumServers();
+    uint16_t choices[2] = {static_cast<uint16_t>(Random() % servers), static_cast<uint16_t>(Random() % servers)};
+    std::future<ret_type> replies[2];
+    for (int i = 0; i < 2; ++i) {
+        uint16_t &server = choices[i];
+        if (is_local(server)) {
+            replies[i] = ReadyFuture(LocalTop());
+        } else {
+            auto reply = RPC_CALL_WRAPPER_ASYNC1("_Top", server, ret_type);
+            replies[i] = std::move(reply);
+        }
+    }
+    ret_type tops[2] = {replies[0].get(), replies[1].get()};
+    if (tops[0].first || tops[1].first) {
+        uint16_t &server = (!tops[0].first || (tops[1].first && compare(tops[0].second, tops[1].second)))
+                           ? choices[1] : choices[0];
+        ret_type result = Pop(server);
+        if (result.first) return result;
+    }
+    return GlobalPop();
+}
+
+/**
+ * Get the data from the local priority queue; the best top of all
+ * sub-queues.
  * @param key_int, key_int to know which server
  * @return return a pair of bool and Value. If bool is true then data was
  * found and is present in value part else bool is set to false
@@ -114,12 +459,15 @@ template<typename MappedType, typename Compare, typename Allocator , typename Sh
 std::pair<bool, MappedType>
 priority_queue<MappedType, Compare, Allocator , SharedType>::LocalTop() {
     AutoTrace trace = AutoTrace("hcl::priority_queue::Top(local)");
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
-    if (queue->size() > 0) {
-        MappedType value = queue->top();
-        return std::pair<bool, MappedType>(true, value);
+    std::pair<bool, MappedType> result(false, MappedType());
+    for (uint16_t i = 0; i < num_sub_queues; ++i) {
+        bip::sharable_lock<segment_mutex> lock(sub_queues[i].mutex);
+        Queue &heap = sub_queues[i].heap;
+        if (!heap.empty() && (!result.first || compare(result.second, heap.top()))) {
+            result = std::pair<bool, MappedType>(true, heap.top());
+        }
     }
-    return std::pair<bool, MappedType>(false, MappedType());;
+    return result;
 }
 
 /**
@@ -150,8 +498,11 @@ priority_queue<MappedType, Compare, Allocator , SharedType>::Top(uint16_t &key_i
 template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
 size_t priority_queue<MappedType, Compare, Allocator , SharedType>::LocalSize() {
     AutoTrace trace = AutoTrace("hcl::priority_queue::Size(local)");
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
-    size_t value = queue->size();
+    size_t value = 0;
+    for (uint16_t i = 0; i < num_sub_queues; ++i) {
+        bip::sharable_lock<segment_mutex> lock(sub_queues[i].mutex);
+        value += sub_queues[i].heap.size();
+    }
     return value;
 }
 
@@ -175,15 +526,20 @@ size_t priority_queue<MappedType, Compare, Allocator , SharedType>::Size(uint16_
 template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
 void priority_queue<MappedType, Compare, Allocator , SharedType>::construct_shared_memory() {
     ShmemAllocator alloc_inst(segment.get_segment_manager());
-    /* Construct priority queue in the shared memory space. */
-    queue = segment.construct<Queue>("Queue")(Compare(), alloc_inst);
+    /* Construct the sub-queues in the shared memory space. A reopened
+     * segment keeps the number it was created with. */
+    sub_queues = segment.find_or_construct<SubQueue>("Queue")[num_sub_queues](alloc_inst);
+    num_sub_queues = static_cast<uint16_t>(segment.find<SubQueue>("Queue").second);
+    ResetLocks();
+    OpenJournal(journal_supported);
 }
 
 template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
 void priority_queue<MappedType, Compare, Allocator , SharedType>::open_shared_memory() {
-    std::pair<Queue*, bip::managed_mapped_file::size_type> res;
-    res = segment.find<Queue> ("Queue");
-    queue = res.first;
+    std::pair<SubQueue*, bip::managed_mapped_file::size_type> res;
+    res = segment.find<SubQueue> ("Queue");
+    sub_queues = res.first;
+    num_sub_queues = static_cast<uint16_t>(res.second);
 }
 
 template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
@@ -209,6 +565,24 @@ void priority_queue<MappedType, Compare, Allocator , SharedType>::bind_functions
             rpc->bind(func_prefix+"_Pop", popFunc);
             rpc->bind(func_prefix+"_Top", topFunc);
             rpc->bind(func_prefix+"_Size", sizeFunc);
+            std::function<bool(std::vector<MappedType> &)> pushNFunc(std::bind(
+                    &hcl::priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPushN, this,
+                    std::placeholders::_1));
+            std::function<std::vector<MappedType>(uint32_t)> popNFunc(std::bind(
+                    &hcl::priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPopN, this,
+                    std::placeholders::_1));
+            rpc->bind(func_prefix+"_PushN", pushNFunc);
+            rpc->bind(func_prefix+"_PopN", popNFunc);
+            std::function<std::vector<MappedType>(uint32_t)> peekNFunc(std::bind(
+                    &hcl::priority_queue<MappedType, Compare, Allocator , SharedType>::LocalPeekN, this,
+                    std::placeholders::_1));
+            rpc->bind(func_prefix+"_PeekN", peekNFunc);
+            if constexpr (is_equality_comparable<MappedType>::value) {
+                std::function<bool(MappedType &, MappedType &)> updatePriorityFunc(std::bind(
+                        &hcl::priority_queue<MappedType, Compare, Allocator , SharedType>::LocalUpdatePriority, this,
+                        std::placeholders::_1, std::placeholders::_2));
+                rpc->bind(func_prefix+"_UpdatePriority", updatePriorityFunc);
+            }
             break;
         }
 #endif
@@ -238,10 +612,60 @@ void priority_queue<MappedType, Compare, Allocator , SharedType>::bind_functions
                     rpc->bind(func_prefix+"_Pop", popFunc);
                     rpc->bind(func_prefix+"_Top", topFunc);
                     rpc->bind(func_prefix+"_Size", sizeFunc);
+                    std::function<void(const tl::request &, std::vector<MappedType> &)> pushNFunc(std::bind(
+                        &hcl::priority_queue<MappedType, Compare, Allocator , SharedType>::ThalliumLocalPushN, this,
+                        std::placeholders::_1, std::placeholders::_2));
+                    std::function<void(const tl::request &, uint32_t)> popNFunc(std::bind(
+                        &hcl::priority_queue<MappedType, Compare, Allocator , SharedType>::ThalliumLocalPopN, this,
+                        std::placeholders::_1, std::placeholders::_2));
+                    rpc->bind(func_prefix+"_PushN", pushNFunc);
+                    rpc->bind(func_prefix+"_PopN", popNFunc);
+                    std::function<void(const tl::request &, uint32_t)> peekNFunc(std::bind(
+                        &hcl::priority_queue<MappedType, Compare, Allocator , SharedType>::ThalliumLocalPeekN, this,
+                        std::placeholders::_1, std::placeholders::_2));
+                    rpc->bind(func_prefix+"_PeekN", peekNFunc);
+                    if constexpr (is_equality_comparable<MappedType>::value) {
+                        std::function<void(const tl::request &, MappedType &, MappedType &)> updatePriorityFunc(std::bind(
+                            &hcl::priority_queue<MappedType, Compare, Allocator , SharedType>::ThalliumLocalUpdatePriority,
+                            this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+                        rpc->bind(func_prefix+"_UpdatePriority", updatePriorityFunc);
+                    }
                     break;
                 }
 #endif
     }
+    bind_checkpoint_functions();
+}
+
+/**
+ * Asynchronous Push. The request is sent immediately and the returned future
+ * yields the same result as Push; on the local server the push happens
+ * before returning and the future is already ready.
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::future<bool>
+priority_queue<MappedType, Compare, Allocator , SharedType>::AsyncPush(MappedType &data, uint16_t &key_int) {
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalPush(data));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::priority_queue::AsyncPush(remote)", data, key_int);
+        return RPC_CALL_WRAPPER_ASYNC("_Push", key_int, bool, data);
+    }
+}
+
+/**
+ * Asynchronous Pop; see AsyncPush.
+ */
+template<typename MappedType, typename Compare, typename Allocator , typename SharedType>
+std::future<std::pair<bool, MappedType>>
+priority_queue<MappedType, Compare, Allocator , SharedType>::AsyncPop(uint16_t &key_int) {
+    typedef std::pair<bool, MappedType> ret_type;
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalPop());
+    } else {
+        AutoTrace trace = AutoTrace("hcl::priority_queue::AsyncPop(remote)", key_int);
+        return RPC_CALL_WRAPPER_ASYNC1("_Pop", key_int, ret_type);
+    }
 }
 
 #endif  // INCLUDE_HCL_PRIORITY_QUEUE_PRIORITY_QUEUE_CPP_
@@ -21,6 +21,8 @@
 #include <hcl/common/singleton.h>
 #include <hcl/common/debug.h>
 #include <hcl/common/typedefs.h>
+#include <hcl/common/constants.h>
+#include <hcl/common/dary_heap.h>
 /** MPI Headers**/
 #include <mpi.h>
 /** RPC Lib Headers**/
@@ -44,9 +46,10 @@
 #include <iostream>
 #include <functional>
 #include <utility>
-#include <queue>
+#include <algorithm>
 #include <string>
 #include <memory>
+#include <random>
 #include <vector>
 #include <hcl/common/container.h>
 
@@ -58,7 +61,18 @@ namespace bip = boost::interprocess;
 namespace hcl {
 /**
  * This is a Distributed priority_queue Class. It uses shared memory + RPC + MPI
- * to achieve the data structure.
+ * to achieve the data structure. Each server keeps a HEAP_ARITY-ary heap in
+ * its segment; Top and Pop return the element ordered highest by Compare,
+ * as std::priority_queue does. GlobalTopK and GlobalPop look at the tops of
+ * all servers at once.
+ *
+ * With more than one sub-queue the queue is relaxed (a MultiQueue): each
+ * server spreads its elements over that many heaps with their own locks.
+ * A push goes to a random heap and a pop takes the better top of two random
+ * heaps, so concurrent pushes and pops rarely meet on a lock, at the price
+ * of popping an element that is not quite the highest. With c * P heaps for
+ * P concurrent consumers, the expected rank of the popped element is about
+ * c * P. Top, PeekN, GlobalTopK and Size stay exact.
  *
  * @tparam MappedType, the value of the priority_queue
  */
@@ -68,10 +82,74 @@ class priority_queue:public container {
     /** Class Typedefs for ease of use **/
     typedef bip::allocator<MappedType, bip::managed_mapped_file::segment_manager>
     ShmemAllocator;
-    typedef std::priority_queue<MappedType, std::vector<MappedType, ShmemAllocator>, Compare> Queue;
+    typedef dary_heap<MappedType, Compare, ShmemAllocator, HEAP_ARITY> Queue;
+
+    /**
+     * One independently locked heap of this server. The sub-queues are
+     * constructed as one array in the segment so that co-located clients
+     * find both the heaps and their count by name.
+     */
+    struct SubQueue {
+        segment_mutex mutex;
+        Queue heap;
+        explicit SubQueue(const ShmemAllocator &allocator)
+                : mutex(HCL_CONF->READ_WRITE_LOCK), heap(Compare(), allocator) {}
+    };
 
     /** Class attributes**/
-    Queue *queue;
+    SubQueue *sub_queues;
+    uint16_t num_sub_queues;
+    Compare compare;
+
+    /* Each thread draws from its own generator, seeded differently. */
+    static uint32_t Random() {
+        static thread_local std::mt19937 random(std::random_device{}());
+        return random();
+    }
+    uint16_t RandomSubQueue() {
+        return num_sub_queues == 1 ? 0 : static_cast<uint16_t>(Random() % num_sub_queues);
+    }
+    std::pair<bool, MappedType> LocalPopOne();
+    bool PushTo(uint16_t index, std::vector<MappedType> &data, size_t first, size_t stride);
+    /* Updates happen under the sub-queue locks, not the container mutex. */
+    std::vector<segment_mutex *> AllocationLocks() override {
+        std::vector<segment_mutex *> locks;
+        for (uint16_t i = 0; i < num_sub_queues; ++i) locks.push_back(&sub_queues[i].mutex);
+        return locks;
+    }
+
+    static const bool journal_supported = journal_codec<MappedType>::supported;
+    /* Journals a push, pop or priority update of sub-queue index; called
+     * with that sub-queue locked. Replay applies it to the same sub-queue,
+     * so a relaxed queue is rebuilt exactly as it was. */
+    void LogUpdate(JournalOp op, uint16_t index, const MappedType &data,
+                   const MappedType &new_data = MappedType()) {
+        if constexpr (journal_supported) {
+            if (oplog == nullptr) return;
+            journal_record record(op);
+            record << index;
+            if (op == JOURNAL_PUSH || op == JOURNAL_UPDATE) record << data;
+            if (op == JOURNAL_UPDATE) record << new_data;
+            Journal(record);
+        }
+    }
+    void ReplayRecord(journal_reader &record) override {
+        if constexpr (journal_supported) {
+            uint8_t op = record.Op();
+            uint16_t index;
+            MappedType data, new_data;
+            record >> index;
+            if (op == JOURNAL_PUSH || op == JOURNAL_UPDATE) record >> data;
+            if (op == JOURNAL_UPDATE) record >> new_data;
+            if (!record.Valid() || index >= num_sub_queues) return;
+            Queue &heap = sub_queues[index].heap;
+            if (op == JOURNAL_PUSH) GrowOnBadAlloc([&]() { heap.push(data); return true; });
+            else if (op == JOURNAL_POP && !heap.empty()) heap.pop();
+            else if (op == JOURNAL_UPDATE) {
+                if constexpr (is_equality_comparable<MappedType>::value) heap.update(data, new_data);
+            }
+        }
+    }
   public:
     ~priority_queue();
 
@@ -81,14 +159,21 @@ class priority_queue:public container {
 
     void bind_functions() override;
 
-    explicit priority_queue(CharStruct name_ = "TEST_PRIORITY_QUEUE", uint16_t port=HCL_CONF->RPC_PORT);
-    Queue * data(){
-        if(server_on_node || is_server) return queue;
+    /* sub_queues_ > 1 makes the queue relaxed; only the server's value matters. */
+    explicit priority_queue(CharStruct name_ = "TEST_PRIORITY_QUEUE", uint16_t port=HCL_CONF->RPC_PORT,
+                            uint16_t sub_queues_=HCL_CONF->NUM_SUB_QUEUES);
+    Queue * data(uint16_t sub_queue = 0){
+        if(server_on_node || is_server) return &sub_queues[sub_queue].heap;
         else nullptr;
     }
+    uint16_t NumSubQueues(){ return num_sub_queues; }
     bool LocalPush(MappedType &data);
     std::pair<bool, MappedType> LocalPop();
     std::pair<bool, MappedType> LocalTop();
+    bool LocalPushN(std::vector<MappedType> &data);
+    std::vector<MappedType> LocalPopN(uint32_t max_count);
+    std::vector<MappedType> LocalPeekN(uint32_t max_count);
+    bool LocalUpdatePriority(MappedType &old_value, MappedType &new_value);
     size_t LocalSize();
 
 #if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
@@ -96,11 +181,24 @@ class priority_queue:public container {
     THALLIUM_DEFINE1(LocalPop)
     THALLIUM_DEFINE1(LocalTop)
     THALLIUM_DEFINE1(LocalSize)
+    THALLIUM_DEFINE(LocalPushN, (data), std::vector<MappedType> &data)
+    THALLIUM_DEFINE(LocalPopN, (max_count), uint32_t max_count)
+    THALLIUM_DEFINE(LocalPeekN, (max_count), uint32_t max_count)
+    THALLIUM_DEFINE(LocalUpdatePriority, (old_value, new_value), MappedType &old_value, MappedType &new_value)
 #endif
 
     bool Push(MappedType &data, uint16_t &key_int);
     std::pair<bool, MappedType> Pop(uint16_t &key_int);
+    std::future<bool> AsyncPush(MappedType &data, uint16_t &key_int);
+    std::future<std::pair<bool, MappedType>> AsyncPop(uint16_t &key_int);
+    bool PushN(std::vector<MappedType> &data, uint16_t &key_int);
+    std::vector<MappedType> PopN(uint32_t max_count, uint16_t &key_int);
+    std::vector<MappedType> PeekN(uint32_t max_count, uint16_t &key_int);
+    bool UpdatePriority(MappedType &old_value, MappedType &new_value, uint16_t &key_int);
     std::pair<bool, MappedType> Top(uint16_t &key_int);
+    std::vector<MappedType> GlobalTopK(uint32_t k);
+    std::pair<bool, MappedType> GlobalPop();
+    std::pair<bool, MappedType> RelaxedPop();
     size_t Size(uint16_t &key_int);
 };
 
@@ -12,14 +12,31 @@
 
 template<typename MappedType, typename Allocator , typename SharedType>
 queue<MappedType, Allocator , SharedType>::~queue() {
-    this->container::~container();
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+    if (waker.joinable()) {
+        {
+            bip::scoped_lock<segment_mutex> lock(*mutex);
+            stop_waker = true;
+            pushed->notify_all();
+        }
+        waker.join();
+        for (auto &pop : parked) hcl::SendResponse(pop.request, std::pair<bool, MappedType>(false, MappedType()));
+    }
+#endif
 }
 template<typename MappedType, typename Allocator , typename SharedType>
-queue<MappedType, Allocator , SharedType>::queue(CharStruct name_, uint16_t port):container(name_,port),my_queue(){
+queue<MappedType, Allocator , SharedType>::queue(CharStruct name_, uint16_t port):container(name_,port),my_queue(),pushed()
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+        ,parked(),stop_waker(false),waker()
+#endif
+{
     AutoTrace trace = AutoTrace("hcl::queue(local)");
     if (is_server) {
         construct_shared_memory();
         bind_functions();
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+        waker = std::thread(&queue::WakeParked, this);
+#endif
     }else if (!is_server && server_on_node) {
         open_shared_memory();
     }
@@ -34,10 +51,16 @@ queue<MappedType, Allocator , SharedType>::queue(CharStruct name_, uint16_t port
 template<typename MappedType, typename Allocator , typename SharedType>
 bool queue<MappedType, Allocator , SharedType>::LocalPush(MappedType &data) {
     AutoTrace trace = AutoTrace("hcl::queue::Push(local)", data);
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
-    auto value = GetData<Allocator, MappedType, SharedType>(data);
-    my_queue->push_back(std::move(value));
-    return true;
+    journal_commit commit(oplog.get());
+    bool result = GrowOnBadAlloc([&]() {
+        bip::scoped_lock<segment_mutex> lock(*mutex);
+        auto &&value = GetData<Allocator, MappedType, SharedType>(data);
+        my_queue->push_back(std::move(value));
+        LogUpdate(JOURNAL_PUSH, data);
+        pushed->notify_all();
+        return true;
+    });
+    return commit.Done() && result;
 }
 
 /**
@@ -49,11 +72,16 @@ bool queue<MappedType, Allocator , SharedType>::LocalPush(MappedType &data) {
 template<typename MappedType, typename Allocator , typename SharedType>
 bool queue<MappedType, Allocator , SharedType>::Push(MappedType &data,
                              uint16_t &key_int) {
-    if (is_local(key_int)) {
+    if (is_local_write(key_int)) {
         return LocalPush(data);
     } else {
         AutoTrace trace = AutoTrace("hcl::queue::Push(remote)", data,
                                     key_int);
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        if (UseBulk<Allocator, MappedType>()) {
+            return BulkCall<bool>(key_int, "_BulkPush", data, tl::bulk_mode::read_only);
+        }
+#endif
         return RPC_CALL_WRAPPER("_Push", key_int, bool,
                                 data);
     }
@@ -69,15 +97,295 @@ template<typename MappedType, typename Allocator , typename SharedType>
 std::pair<bool, MappedType>
 queue<MappedType, Allocator , SharedType>::LocalPop() {
     AutoTrace trace = AutoTrace("hcl::queue::Pop(local)");
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+    journal_commit commit(oplog.get());
+    std::pair<bool, MappedType> result;
+    {
+        bip::scoped_lock<segment_mutex> lock(*mutex);
+        result = PopFront();
+    }
+    if (result.first && !commit.Done()) return std::pair<bool, MappedType>(false, MappedType());
+    return result;
+}
+
+template<typename MappedType, typename Allocator , typename SharedType>
+std::pair<bool, MappedType>
+queue<MappedType, Allocator , SharedType>::PopFront() {
     if (my_queue->size() > 0) {
         MappedType value = my_queue->front();
         my_queue->pop_front();
+        LogUpdate(JOURNAL_POP, value);
         return std::pair<bool, MappedType>(true, value);
     }
     return std::pair<bool, MappedType>(false, MappedType());
 }
 
+/**
+ * Push all of data into the local queue under one lock acquisition.
+ * @param data, the values to push, in order
+ * @return bool, true if all values were pushed
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+bool queue<MappedType, Allocator , SharedType>::LocalPushN(std::vector<MappedType> &data) {
+    AutoTrace trace = AutoTrace("hcl::queue::PushN(local)", data.size());
+    journal_commit commit(oplog.get());
+    /* Values already pushed stay pushed if the segment has to grow. */
+    size_t done = 0;
+    bool result = GrowOnBadAlloc([&]() {
+        bip::scoped_lock<segment_mutex> lock(*mutex);
+        for (; done < data.size(); ++done) {
+            auto &&value = GetData<Allocator, MappedType, SharedType>(data[done]);
+            my_queue->push_back(std::move(value));
+            LogUpdate(JOURNAL_PUSH, data[done]);
+        }
+        pushed->notify_all();
+        return true;
+    });
+    return commit.Done() && result;
+}
+
+/**
+ * Push all of data into the queue of server key_int with one call.
+ * @param data, the values to push, in order
+ * @param key_int, key_int to know which server
+ * @return bool, true if all values were pushed
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+bool queue<MappedType, Allocator , SharedType>::PushN(std::vector<MappedType> &data, uint16_t &key_int) {
+    if (is_local_write(key_int)) {
+        return LocalPushN(data);
+    } else {
+        AutoTrace trace = AutoTrace("hcl::queue::PushN(remote)", data.size(), key_int);
+        return RPC_CALL_WRAPPER("_PushN", key_int, bool, data);
+    }
+}
+
+/**
+ * Pop up to max_count values from the local queue under one lock
+ * acquisition.
+ * @param max_count, the most values to pop
+ * @return the popped values, oldest first; empty if the queue was
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+std::vector<MappedType> queue<MappedType, Allocator , SharedType>::LocalPopN(uint32_t max_count) {
+    AutoTrace trace = AutoTrace("hcl::queue::PopN(local)", max_count);
+    journal_commit commit(oplog.get());
+    std::vector<MappedType> values;
+    {
+        bip::scoped_lock<segment_mutex> lock(*mutex);
+        values.reserve(std::min<size_t>(max_count, my_queue->size()));
+        while (values.size() < max_count && !my_queue->empty()) values.push_back(PopFront().second);
+    }
+    if (!values.empty() && !commit.Done()) values.clear();
+    return values;
+}
+
+/**
+ * Pop up to max_count values from the queue of server key_int with one call.
+ * @param max_count, the most values to pop
+ * @param key_int, key_int to know which server
+ * @return the popped values, oldest first; empty if the queue was
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+std::vector<MappedType> queue<MappedType, Allocator , SharedType>::PopN(uint32_t max_count, uint16_t &key_int) {
+    if (is_local_write(key_int)) {
+        return LocalPopN(max_count);
+    } else {
+        AutoTrace trace = AutoTrace("hcl::queue::PopN(remote)", max_count, key_int);
+        typedef std::vector<MappedType> ret_type;
+        return RPC_CALL_WRAPPER("_PopN", key_int, ret_type, max_count);
+    }
+}
+
+/**
+ * Server side of a steal: hands over half of the local queue, oldest
+ * first, but at most max_count elements, so the victim keeps work of its
+ * own and repeated steals spread the backlog over the thieves.
+ * @param max_count, the most values to hand over
+ * @return the stolen values; empty if the queue was empty
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+std::vector<MappedType> queue<MappedType, Allocator , SharedType>::LocalSteal(uint32_t max_count) {
+    AutoTrace trace = AutoTrace("hcl::queue::Steal(local)", max_count);
+    journal_commit commit(oplog.get());
+    std::vector<MappedType> values;
+    {
+        bip::scoped_lock<segment_mutex> lock(*mutex);
+        size_t count = std::min<size_t>(max_count, (my_queue->size() + 1) / 2);
+        values.reserve(count);
+        while (values.size() < count) values.push_back(PopFront().second);
+    }
+    if (!values.empty() && !commit.Done()) values.clear();
+    return values;
+}
+
+/* Pushes stolen elements to server; false if it did not take them. */
+template<typename MappedType, typename Allocator , typename SharedType>
+bool queue<MappedType, Allocator , SharedType>::PlaceStolen(std::vector<MappedType> &values, uint16_t server) {
+    try {
+        return PushN(values, server);
+    } catch (std::exception &) {
+        return false;
+    }
+}
+
+/**
+ * Pop for consumers that may take work from any server. The caller's own
+ * server is tried first, through shared memory if it is on this node. If
+ * it is empty, the other servers are tried in random order and the first
+ * one with work hands over a batch of up to STEAL_BATCH elements. One of
+ * them is returned and the rest go to the caller's own server, where this
+ * and other local consumers find them without another remote call. The
+ * victim has already popped them, so if the caller's server refuses them
+ * they are pushed back to the victim, and if that fails too they are
+ * handed to the caller instead of being dropped.
+ * @param unplaced, receives the stolen elements no queue took back; they
+ * are in no queue and only the caller has them
+ * @return return a pair of bool and Value. bool is false only if no server
+ * had an element
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+std::pair<bool, MappedType>
+queue<MappedType, Allocator , SharedType>::StealingPop(std::vector<MappedType> &unplaced) {
+    std::pair<bool, MappedType> result = Pop(my_server);
+    if (result.first) return result;
+    uint16_t servers = num_servers;
+    std::vector<uint16_t> victims;
+    for (uint16_t server = 0; server < servers; ++server) {
+        if (server != my_server) victims.push_back(server);
+    }
+    static thread_local std::mt19937 random(my_rank);
+    std::shuffle(victims.begin(), victims.end(), random);
+    for (uint16_t victim : victims) {
+        /* Only the caller's own server can be on its node. */
+        AutoTrace trace = AutoTrace("hcl::queue::Steal(remote)", victim);
+        typedef std::vector<MappedType> ret_type;
+        uint32_t batch = STEAL_BATCH;
+        ret_type stolen = RPC_CALL_WRAPPER("_Steal", victim, ret_type, batch);
+        if (stolen.empty()) continue;
+        result = std::pair<bool, MappedType>(true, stolen.front());
+        if (stolen.size() > 1) {
+            std::vector<MappedType> rest(stolen.begin() + 1, stolen.end());
+            if (!PlaceStolen(rest, my_server) && !PlaceStolen(rest, victim)) {
+                unplaced.insert(unplaced.end(), rest.begin(), rest.end());
+            }
+        }
+        return result;
+    }
+    return result;
+}
+
+/**
+ * Pop that waits up to timeout_ms milliseconds for an element if the local
+ * queue is empty. Sleeps on the segment's condition instead of polling, so
+ * it wakes as soon as any process pushes.
+ * @param timeout_ms, how long to wait for an element
+ * @return a pair of bool and Value; bool is false if the wait timed out
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+std::pair<bool, MappedType>
+queue<MappedType, Allocator , SharedType>::LocalBlockingPop(uint32_t timeout_ms) {
+    AutoTrace trace = AutoTrace("hcl::queue::BlockingPop(local)", timeout_ms);
+    journal_commit commit(oplog.get());
+    boost::posix_time::ptime deadline =
+            boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(timeout_ms);
+    std::pair<bool, MappedType> result;
+    {
+        bip::scoped_lock<segment_mutex> lock(*mutex);
+        pushed->timed_wait(lock, deadline, [this]() { return !my_queue->empty(); });
+        result = PopFront();
+    }
+    if (result.first && !commit.Done()) return std::pair<bool, MappedType>(false, MappedType());
+    return result;
+}
+
+/**
+ * Pop from the queue of server key_int, waiting up to timeout_ms
+ * milliseconds for an element. With Thallium a remote call does not hold a
+ * server handler thread while it waits; with rpclib it does.
+ * @param key_int, key_int to know which server
+ * @param timeout_ms, how long to wait for an element
+ * @return a pair of bool and Value; bool is false if the wait timed out
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+std::pair<bool, MappedType>
+queue<MappedType, Allocator , SharedType>::BlockingPop(uint16_t &key_int, uint32_t timeout_ms) {
+    if (is_local_write(key_int)) {
+        return LocalBlockingPop(timeout_ms);
+    } else {
+        AutoTrace trace = AutoTrace("hcl::queue::BlockingPop(remote)", key_int, timeout_ms);
+        typedef std::pair<bool, MappedType> ret_type;
+        return RPC_CALL_WRAPPER("_BlockingPop", key_int, ret_type, timeout_ms);
+    }
+}
+
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+/**
+ * Server side of a remote BlockingPop. If the queue is empty the request is
+ * parked and the handler returns at once; WakeParked responds later.
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+void queue<MappedType, Allocator , SharedType>::ThalliumLocalBlockingPop(
+        const tl::request &thallium_req, uint32_t timeout_ms) {
+    AutoTrace trace = AutoTrace("hcl::queue::BlockingPop(local)", timeout_ms);
+    journal_commit commit(oplog.get());
+    std::pair<bool, MappedType> result;
+    {
+        bip::scoped_lock<segment_mutex> lock(*mutex);
+        if (my_queue->empty() && timeout_ms > 0 && !stop_waker) {
+            parked.push_back(ParkedPop{thallium_req, boost::posix_time::microsec_clock::universal_time() +
+                                                     boost::posix_time::milliseconds(timeout_ms)});
+            /* Let the waker pick up the new deadline. */
+            pushed->notify_all();
+            return;
+        }
+        result = PopFront();
+    }
+    if (result.first && !commit.Done()) result = std::pair<bool, MappedType>(false, MappedType());
+    hcl::SendResponse(thallium_req, result);
+}
+
+/**
+ * Runs on the server while it lives. Hands elements to parked pops in the
+ * order they arrived and answers those whose time ran out, then sleeps on
+ * the push condition until the next push, park or deadline.
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+void queue<MappedType, Allocator , SharedType>::WakeParked() {
+    typedef std::pair<bool, MappedType> ret_type;
+    bip::scoped_lock<segment_mutex> lock(*mutex);
+    while (!stop_waker) {
+        journal_commit commit(oplog.get());
+        std::vector<std::pair<tl::request, ret_type>> answers;
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        boost::posix_time::ptime next_deadline(boost::posix_time::pos_infin);
+        for (auto pop = parked.begin(); pop != parked.end();) {
+            if (!my_queue->empty()) {
+                answers.emplace_back(pop->request, PopFront());
+            } else if (pop->deadline <= now) {
+                answers.emplace_back(pop->request, ret_type(false, MappedType()));
+            } else {
+                next_deadline = std::min(next_deadline, pop->deadline);
+                ++pop;
+                continue;
+            }
+            pop = parked.erase(pop);
+        }
+        if (!answers.empty()) {
+            lock.unlock();
+            if (!commit.Done()) {
+                for (auto &answer : answers) answer.second = ret_type(false, MappedType());
+            }
+            for (auto &answer : answers) hcl::SendResponse(answer.first, answer.second);
+            lock.lock();
+        } else if (parked.empty()) {
+            pushed->wait(lock);
+        } else {
+            pushed->timed_wait(lock, next_deadline);
+        }
+    }
+}
+#endif
+
 /**
  * Get the data from the queue. Uses key_int to decide the server to hash it
  * to,
@@ -88,25 +396,71 @@ queue<MappedType, Allocator , SharedType>::LocalPop() {
 template<typename MappedType, typename Allocator , typename SharedType>
 std::pair<bool, MappedType>
 queue<MappedType, Allocator , SharedType>::Pop(uint16_t &key_int) {
-    if (is_local(key_int)) {
+    if (is_local_write(key_int)) {
         return LocalPop();
     } else {
         AutoTrace trace = AutoTrace("hcl::queue::Pop(remote)",
                                     key_int);
         typedef std::pair<bool, MappedType> ret_type;
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        if (UseBulk<Allocator, MappedType>()) {
+            ret_type result(false, MappedType());
+            result.first = BulkCall<bool>(key_int, "_BulkPop", result.second, tl::bulk_mode::write_only);
+            return result;
+        }
+#endif
         return RPC_CALL_WRAPPER1("_Pop", key_int, ret_type);
     }
 }
 
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+/**
+ * Server side of a bulk Push: the value is pulled from the client and then
+ * pushed as by LocalPush, so a failed transfer leaves the queue as it was.
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+void queue<MappedType, Allocator , SharedType>::ThalliumLocalBulkPush(
+        const tl::request &thallium_req, tl::bulk &bulk_handle) {
+    AutoTrace trace = AutoTrace("hcl::queue::BulkPush(local)");
+    MappedType data;
+    try {
+        rpc->rdma_pull(thallium_req, bulk_handle, &data, sizeof(MappedType));
+    } catch (std::exception &e) {
+        printf("Error: %s could not pull a pushed value: %s\n", name.c_str(), e.what());
+        hcl::SendResponse(thallium_req, false);
+        return;
+    }
+    hcl::SendResponse(thallium_req, LocalPush(data));
+}
+
+/**
+ * Server side of a bulk Pop: the front value is pushed into the client's
+ * buffer before it is removed. Responds false when the queue is empty.
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+void queue<MappedType, Allocator , SharedType>::ThalliumLocalBulkPop(
+        const tl::request &thallium_req, tl::bulk &bulk_handle) {
+    AutoTrace trace = AutoTrace("hcl::queue::BulkPop(local)");
+    journal_commit commit(oplog.get());
+    bool found;
+    {
+        bip::scoped_lock<segment_mutex> lock(*mutex);
+        found = my_queue->size() > 0;
+        if (found) {
+            rpc->rdma_push(thallium_req, bulk_handle, &my_queue->front(), sizeof(MappedType));
+            my_queue->pop_front();
+            LogUpdate(JOURNAL_POP, MappedType());
+        }
+    }
+    hcl::SendResponse(thallium_req, found && commit.Done());
+}
+#endif
+
 template<typename MappedType, typename Allocator , typename SharedType>
 bool queue<MappedType, Allocator , SharedType>::LocalWaitForElement() {
     AutoTrace trace = AutoTrace("hcl::queue::WaitForElement(local)");
-    int count = 0;
-    while (my_queue->size() == 0) {
-        usleep(10);
-        if (count == 0) printf("Server %d, No Events in Queue\n", my_rank);
-        count++;
-    }
+    bip::scoped_lock<segment_mutex> lock(*mutex);
+    pushed->wait(lock, [this]() { return !my_queue->empty(); });
     return true;
 }
 
@@ -129,7 +483,7 @@ bool queue<MappedType, Allocator , SharedType>::WaitForElement(uint16_t &key_int
 template<typename MappedType, typename Allocator , typename SharedType>
 size_t queue<MappedType, Allocator , SharedType>::LocalSize() {
     AutoTrace trace = AutoTrace("hcl::queue::Size(local)");
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+    bip::sharable_lock<segment_mutex> lock(*mutex);
     size_t value = my_queue->size();
     return value;
 }
@@ -154,7 +508,11 @@ template<typename MappedType, typename Allocator , typename SharedType>
 void queue<MappedType, Allocator , SharedType>::construct_shared_memory() {
     ShmemAllocator alloc_inst(segment.get_segment_manager());
     /* Construct queue in the shared memory space. */
-    my_queue = segment.construct<Queue>("Queue")(alloc_inst);
+    my_queue = segment.find_or_construct<Queue>("Queue")(alloc_inst);
+    pushed = segment.find_or_construct<bip::interprocess_condition_any>("QueuePushed")();
+    /* Nobody can be waiting on a condition left in a reopened segment. */
+    if (reopened) new (pushed) bip::interprocess_condition_any();
+    OpenJournal(journal_supported);
 }
 
 template<typename MappedType, typename Allocator , typename SharedType>
@@ -162,6 +520,7 @@ void queue<MappedType, Allocator , SharedType>::open_shared_memory() {
     std::pair<Queue*, bip::managed_mapped_file::size_type> res;
     res = segment.find<Queue> ("Queue");
     my_queue = res.first;
+    pushed = segment.find<bip::interprocess_condition_any>("QueuePushed").first;
 }
 
 template<typename MappedType, typename Allocator , typename SharedType>
@@ -179,8 +538,24 @@ void queue<MappedType, Allocator , SharedType>::bind_functions() {
                     &hcl::queue<MappedType, Allocator , SharedType>::LocalSize, this));
             std::function<bool(void)> waitForElementFunc(std::bind(
                     &hcl::queue<MappedType, Allocator , SharedType>::LocalWaitForElement, this));
+            std::function<std::pair<bool, MappedType>(uint32_t)> blockingPopFunc(std::bind(
+                    &hcl::queue<MappedType, Allocator , SharedType>::LocalBlockingPop, this,
+                    std::placeholders::_1));
             rpc->bind(func_prefix+"_Push", pushFunc);
             rpc->bind(func_prefix+"_Pop", popFunc);
+            rpc->bind(func_prefix+"_BlockingPop", blockingPopFunc);
+            std::function<bool(std::vector<MappedType> &)> pushNFunc(std::bind(
+                    &hcl::queue<MappedType, Allocator , SharedType>::LocalPushN, this,
+                    std::placeholders::_1));
+            std::function<std::vector<MappedType>(uint32_t)> popNFunc(std::bind(
+                    &hcl::queue<MappedType, Allocator , SharedType>::LocalPopN, this,
+                    std::placeholders::_1));
+            rpc->bind(func_prefix+"_PushN", pushNFunc);
+            rpc->bind(func_prefix+"_PopN", popNFunc);
+            std::function<std::vector<MappedType>(uint32_t)> stealFunc(std::bind(
+                    &hcl::queue<MappedType, Allocator , SharedType>::LocalSteal, this,
+                    std::placeholders::_1));
+            rpc->bind(func_prefix+"_Steal", stealFunc);
             rpc->bind(func_prefix+"_WaitForElement", waitForElementFunc);
             rpc->bind(func_prefix+"_Size", sizeFunc);
             break;
@@ -204,13 +579,71 @@ void queue<MappedType, Allocator , SharedType>::bind_functions() {
                     std::function<void(const tl::request &)> waitForElementFunc(std::bind(
                         &hcl::queue<MappedType, Allocator , SharedType>::ThalliumLocalWaitForElement, this,
                         std::placeholders::_1));
+                    std::function<void(const tl::request &, uint32_t)> blockingPopFunc(std::bind(
+                        &hcl::queue<MappedType, Allocator , SharedType>::ThalliumLocalBlockingPop, this,
+                        std::placeholders::_1, std::placeholders::_2));
                     rpc->bind(func_prefix+"_Push", pushFunc);
                     rpc->bind(func_prefix+"_Pop", popFunc);
+                    rpc->bind(func_prefix+"_BlockingPop", blockingPopFunc);
+                    std::function<void(const tl::request &, std::vector<MappedType> &)> pushNFunc(std::bind(
+                        &hcl::queue<MappedType, Allocator , SharedType>::ThalliumLocalPushN, this,
+                        std::placeholders::_1, std::placeholders::_2));
+                    std::function<void(const tl::request &, uint32_t)> popNFunc(std::bind(
+                        &hcl::queue<MappedType, Allocator , SharedType>::ThalliumLocalPopN, this,
+                        std::placeholders::_1, std::placeholders::_2));
+                    rpc->bind(func_prefix+"_PushN", pushNFunc);
+                    rpc->bind(func_prefix+"_PopN", popNFunc);
+                    std::function<void(const tl::request &, uint32_t)> stealFunc(std::bind(
+                        &hcl::queue<MappedType, Allocator , SharedType>::ThalliumLocalSteal, this,
+                        std::placeholders::_1, std::placeholders::_2));
+                    rpc->bind(func_prefix+"_Steal", stealFunc);
                     rpc->bind(func_prefix+"_WaitForElement", waitForElementFunc);
                     rpc->bind(func_prefix+"_Size", sizeFunc);
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+                    std::function<void(const tl::request &, tl::bulk &)> bulkPushFunc(std::bind(
+                        &hcl::queue<MappedType, Allocator , SharedType>::ThalliumLocalBulkPush, this,
+                        std::placeholders::_1, std::placeholders::_2));
+                    std::function<void(const tl::request &, tl::bulk &)> bulkPopFunc(std::bind(
+                        &hcl::queue<MappedType, Allocator , SharedType>::ThalliumLocalBulkPop, this,
+                        std::placeholders::_1, std::placeholders::_2));
+                    rpc->bind(func_prefix+"_BulkPush", bulkPushFunc);
+                    rpc->bind(func_prefix+"_BulkPop", bulkPopFunc);
+#endif
                     break;
                 }
 #endif
     }
+    bind_checkpoint_functions();
+}
+/**
+ * Asynchronous Push. The request is sent immediately and the returned future
+ * yields the same result as Push; on the local server the push happens
+ * before returning and the future is already ready.
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+std::future<bool>
+queue<MappedType, Allocator , SharedType>::AsyncPush(MappedType &data, uint16_t &key_int) {
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalPush(data));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::queue::AsyncPush(remote)", data, key_int);
+        return RPC_CALL_WRAPPER_ASYNC("_Push", key_int, bool, data);
+    }
 }
+
+/**
+ * Asynchronous Pop; see AsyncPush.
+ */
+template<typename MappedType, typename Allocator , typename SharedType>
+std::future<std::pair<bool, MappedType>>
+queue<MappedType, Allocator , SharedType>::AsyncPop(uint16_t &key_int) {
+    typedef std::pair<bool, MappedType> ret_type;
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalPop());
+    } else {
+        AutoTrace trace = AutoTrace("hcl::queue::AsyncPop(remote)", key_int);
+        return RPC_CALL_WRAPPER_ASYNC1("_Pop", key_int, ret_type);
+    }
+}
+
 // template class queue<int>;
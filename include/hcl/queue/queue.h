@@ -39,9 +39,16 @@
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/interprocess_condition_any.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/algorithm/string.hpp>
 /** Standard C++ Headers**/
 #include <iostream>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
 #include <functional>
 #include <utility>
 #include <memory>
@@ -69,6 +76,46 @@ class queue :public container{
 
     /** Class attributes**/
     Queue *my_queue;
+    /* Notified on every push. It lives in the segment, so co-located
+     * consumers blocked in BlockingPop are woken by any pusher. */
+    bip::interprocess_condition_any *pushed;
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+    /* A remote BlockingPop waiting for an element; guarded by *mutex. */
+    struct ParkedPop {
+        tl::request request;
+        boost::posix_time::ptime deadline;
+    };
+    std::deque<ParkedPop> parked;
+    bool stop_waker;
+    /* Answers parked pops as elements arrive or their time runs out. */
+    std::thread waker;
+    void WakeParked();
+#endif
+
+    /* Removes the front element; called with the queue locked. */
+    std::pair<bool, MappedType> PopFront();
+    bool PlaceStolen(std::vector<MappedType> &values, uint16_t server);
+
+    static const bool journal_supported = journal_codec<MappedType>::supported;
+    /* Journals a push or pop; called with the queue locked. */
+    void LogUpdate(JournalOp op, const MappedType &data) {
+        if constexpr (journal_supported) {
+            if (oplog == nullptr) return;
+            journal_record record(op);
+            if (op == JOURNAL_PUSH) record << data;
+            Journal(record);
+        }
+    }
+    void ReplayRecord(journal_reader &record) override {
+        if constexpr (journal_supported) {
+            uint8_t op = record.Op();
+            MappedType data;
+            if (op == JOURNAL_PUSH) record >> data;
+            if (!record.Valid()) return;
+            if (op == JOURNAL_PUSH) LocalPush(data);
+            else if (op == JOURNAL_POP) LocalPop();
+        }
+    }
   public:
     ~queue();
 
@@ -85,6 +132,10 @@ class queue :public container{
     }
     bool LocalPush(MappedType &data);
     std::pair<bool, MappedType> LocalPop();
+    std::pair<bool, MappedType> LocalBlockingPop(uint32_t timeout_ms);
+    bool LocalPushN(std::vector<MappedType> &data);
+    std::vector<MappedType> LocalPopN(uint32_t max_count);
+    std::vector<MappedType> LocalSteal(uint32_t max_count);
     bool LocalWaitForElement();
     size_t LocalSize();
 
@@ -93,10 +144,26 @@ class queue :public container{
     THALLIUM_DEFINE1(LocalPop)
     THALLIUM_DEFINE1(LocalWaitForElement)
     THALLIUM_DEFINE1(LocalSize)
+    THALLIUM_DEFINE(LocalPushN, (data), std::vector<MappedType> &data)
+    THALLIUM_DEFINE(LocalPopN, (max_count), uint32_t max_count)
+    THALLIUM_DEFINE(LocalSteal, (max_count), uint32_t max_count)
+    /* Parks the request until an element arrives, see WakeParked. */
+    void ThalliumLocalBlockingPop(const tl::request &thallium_req, uint32_t timeout_ms);
 #endif    
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+    /* Bulk variants of Push and Pop; see container::UseBulk. */
+    void ThalliumLocalBulkPush(const tl::request &thallium_req, tl::bulk &bulk_handle);
+    void ThalliumLocalBulkPop(const tl::request &thallium_req, tl::bulk &bulk_handle);
+#endif
 
     bool Push(MappedType &data, uint16_t &key_int);
     std::pair<bool, MappedType> Pop(uint16_t &key_int);
+    std::future<bool> AsyncPush(MappedType &data, uint16_t &key_int);
+    std::future<std::pair<bool, MappedType>> AsyncPop(uint16_t &key_int);
+    std::pair<bool, MappedType> BlockingPop(uint16_t &key_int, uint32_t timeout_ms);
+    bool PushN(std::vector<MappedType> &data, uint16_t &key_int);
+    std::vector<MappedType> PopN(uint32_t max_count, uint16_t &key_int);
+    std::pair<bool, MappedType> StealingPop(std::vector<MappedType> &unplaced);
     bool WaitForElement(uint16_t &key_int);
     size_t Size(uint16_t &key_int);
 };
@@ -0,0 +1,218 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INCLUDE_HCL_RING_QUEUE_RING_QUEUE_CPP_
+#define INCLUDE_HCL_RING_QUEUE_RING_QUEUE_CPP_
+
+template<typename MappedType>
+ring_queue<MappedType>::~ring_queue() {
+}
+
+template<typename MappedType>
+ring_queue<MappedType>::ring_queue(CharStruct name_, uint16_t port, uint64_t capacity_)
+        :container(name_,port),capacity(1),ring(nullptr),slots(nullptr),elements(nullptr){
+    AutoTrace trace = AutoTrace("hcl::ring_queue");
+    while (capacity < capacity_) capacity <<= 1;
+    if (is_server) {
+        construct_shared_memory();
+        bind_functions();
+    }else if (!is_server && server_on_node) {
+        open_shared_memory();
+    }
+}
+
+/**
+ * Push the data into the local ring. Lock-free: a slot is claimed by
+ * advancing the enqueue position and published by bumping its sequence.
+ * @param data, the value for push
+ * @return bool, true if Push was successful, false if the ring is full.
+ */
+template<typename MappedType>
+bool ring_queue<MappedType>::LocalPush(MappedType &data) {
+    AutoTrace trace = AutoTrace("hcl::ring_queue::Push(local)", data);
+    uint64_t position = ring->enqueue_position.load(std::memory_order_relaxed);
+    while (true) {
+        Slot &slot = SlotAt(position);
+        int64_t lag = static_cast<int64_t>(slot.sequence.load(std::memory_order_acquire) - position);
+        if (lag == 0) {
+            if (ring->enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                ElementAt(position) = data;
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (lag < 0) {
+            return false;
+        } else {
+            position = ring->enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Push the data into the ring of server key_int.
+ * @param data, the value for push
+ * @param key_int, key_int to know which server
+ * @return bool, true if Push was successful, false if the ring is full.
+ */
+template<typename MappedType>
+bool ring_queue<MappedType>::Push(MappedType &data, uint16_t &key_int) {
+    if (is_local(key_int)) {
+        return LocalPush(data);
+    } else {
+        AutoTrace trace = AutoTrace("hcl::ring_queue::Push(remote)", data, key_int);
+        return RPC_CALL_WRAPPER("_Push", key_int, bool, data);
+    }
+}
+
+/**
+ * Pop the oldest element of the local ring. Lock-free, like LocalPush.
+ * @return return a pair of bool and Value. If bool is true then data was
+ * found and is present in value part else bool is set to false
+ */
+template<typename MappedType>
+std::pair<bool, MappedType> ring_queue<MappedType>::LocalPop() {
+    AutoTrace trace = AutoTrace("hcl::ring_queue::Pop(local)");
+    uint64_t position = ring->dequeue_position.load(std::memory_order_relaxed);
+    while (true) {
+        Slot &slot = SlotAt(position);
+        int64_t lag = static_cast<int64_t>(slot.sequence.load(std::memory_order_acquire) - (position + 1));
+        if (lag == 0) {
+            if (ring->dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                std::pair<bool, MappedType> result(true, ElementAt(position));
+                /* Free the slot for the producer one lap ahead. */
+                slot.sequence.store(position + ring->capacity, std::memory_order_release);
+                return result;
+            }
+        } else if (lag < 0) {
+            return std::pair<bool, MappedType>(false, MappedType());
+        } else {
+            position = ring->dequeue_position.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Pop the oldest element of the ring of server key_int.
+ * @param key_int, key_int to know which server
+ * @return return a pair of bool and Value. If bool is true then data was
+ * found and is present in value part else bool is set to false
+ */
+template<typename MappedType>
+std::pair<bool, MappedType> ring_queue<MappedType>::Pop(uint16_t &key_int) {
+    if (is_local(key_int)) {
+        return LocalPop();
+    } else {
+        AutoTrace trace = AutoTrace("hcl::ring_queue::Pop(remote)", key_int);
+        typedef std::pair<bool, MappedType> ret_type;
+        return RPC_CALL_WRAPPER1("_Pop", key_int, ret_type);
+    }
+}
+
+/**
+ * Number of elements in the local ring. Exact only while nobody pushes or
+ * pops concurrently.
+ */
+template<typename MappedType>
+size_t ring_queue<MappedType>::LocalSize() {
+    AutoTrace trace = AutoTrace("hcl::ring_queue::Size(local)");
+    uint64_t dequeued = ring->dequeue_position.load(std::memory_order_acquire);
+    uint64_t enqueued = ring->enqueue_position.load(std::memory_order_acquire);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+template<typename MappedType>
+size_t ring_queue<MappedType>::Size(uint16_t &key_int) {
+    if (is_local(key_int)) {
+        return LocalSize();
+    } else {
+        AutoTrace trace = AutoTrace("hcl::ring_queue::Size(remote)", key_int);
+        return RPC_CALL_WRAPPER1("_Size", key_int, size_t);
+    }
+}
+
+template<typename MappedType>
+void ring_queue<MappedType>::construct_shared_memory() {
+    /* A reopened segment keeps its ring, and with it its capacity. */
+    ring = segment.find<Ring>("Ring").first;
+    if (ring == nullptr) {
+        char *block = static_cast<char *>(segment.allocate_aligned(capacity * SLOT_SIZE, CACHE_LINE_SIZE));
+        for (uint64_t position = 0; position < capacity; ++position) {
+            Slot *slot = reinterpret_cast<Slot *>(block + position * SLOT_SIZE);
+            new (&slot->sequence) std::atomic<uint64_t>(position);
+        }
+        ring = segment.construct<Ring>("Ring")();
+        ring->capacity = capacity;
+        ring->slots = segment.get_handle_from_address(block);
+        ring->elements = 0;
+        if (!is_inline) {
+            void *element_block = segment.allocate_aligned(capacity * sizeof(MappedType), CACHE_LINE_SIZE);
+            ring->elements = segment.get_handle_from_address(element_block);
+        }
+        ring->enqueue_position.store(0);
+        ring->dequeue_position.store(0);
+    }
+    slots = static_cast<char *>(segment.get_address_from_handle(ring->slots));
+    if (!is_inline) elements = static_cast<char *>(segment.get_address_from_handle(ring->elements));
+}
+
+template<typename MappedType>
+void ring_queue<MappedType>::open_shared_memory() {
+    ring = segment.find<Ring>("Ring").first;
+    slots = static_cast<char *>(segment.get_address_from_handle(ring->slots));
+    if (!is_inline) elements = static_cast<char *>(segment.get_address_from_handle(ring->elements));
+}
+
+template<typename MappedType>
+void ring_queue<MappedType>::bind_functions() {
+    /* Create a RPC server and map the methods to it. */
+    switch (HCL_CONF->RPC_IMPLEMENTATION) {
+#ifdef HCL_ENABLE_RPCLIB
+        case RPCLIB: {
+            std::function<bool(MappedType &)> pushFunc(
+                    std::bind(&hcl::ring_queue<MappedType>::LocalPush, this,
+                              std::placeholders::_1));
+            std::function<std::pair<bool, MappedType>(void)> popFunc(std::bind(
+                    &hcl::ring_queue<MappedType>::LocalPop, this));
+            std::function<size_t(void)> sizeFunc(std::bind(
+                    &hcl::ring_queue<MappedType>::LocalSize, this));
+            rpc->bind(func_prefix+"_Push", pushFunc);
+            rpc->bind(func_prefix+"_Pop", popFunc);
+            rpc->bind(func_prefix+"_Size", sizeFunc);
+            break;
+        }
+#endif
+#ifdef HCL_ENABLE_THALLIUM_TCP
+            case THALLIUM_TCP:
+#endif
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+            case THALLIUM_ROCE:
+#endif
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+            {
+                    std::function<void(const tl::request &, MappedType &)> pushFunc(
+                        std::bind(&hcl::ring_queue<MappedType>::ThalliumLocalPush, this,
+                                  std::placeholders::_1, std::placeholders::_2));
+                    std::function<void(const tl::request &)> popFunc(std::bind(
+                        &hcl::ring_queue<MappedType>::ThalliumLocalPop, this, std::placeholders::_1));
+                    std::function<void(const tl::request &)> sizeFunc(std::bind(
+                        &hcl::ring_queue<MappedType>::ThalliumLocalSize, this, std::placeholders::_1));
+                    rpc->bind(func_prefix+"_Push", pushFunc);
+                    rpc->bind(func_prefix+"_Pop", popFunc);
+                    rpc->bind(func_prefix+"_Size", sizeFunc);
+                    break;
+                }
+#endif
+    }
+    bind_checkpoint_functions();
+}
+
+#endif  // INCLUDE_HCL_RING_QUEUE_RING_QUEUE_CPP_
@@ -0,0 +1,148 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INCLUDE_HCL_RING_QUEUE_RING_QUEUE_H_
+#define INCLUDE_HCL_RING_QUEUE_RING_QUEUE_H_
+
+/**
+ * Include Headers
+ */
+#include <hcl/communication/rpc_lib.h>
+#include <hcl/communication/rpc_factory.h>
+#include <hcl/common/singleton.h>
+#include <hcl/common/debug.h>
+#include <hcl/common/constants.h>
+/** MPI Headers**/
+#include <mpi.h>
+/** RPC Lib Headers**/
+#ifdef HCL_ENABLE_RPCLIB
+#include <rpc/server.h>
+#include <rpc/client.h>
+#include <rpc/rpc_error.h>
+#endif
+/** Thallium Headers **/
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+#include <thallium.hpp>
+#endif
+
+/** Boost Headers **/
+#include <boost/interprocess/managed_mapped_file.hpp>
+/** Standard C++ Headers**/
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <string>
+#include <hcl/common/container.h>
+
+/** Namespaces Uses **/
+namespace bip = boost::interprocess;
+
+namespace hcl {
+/**
+ * A bounded distributed FIFO queue. Each server keeps a fixed ring of slots
+ * in its segment; producers and consumers claim slots with a compare-and-swap
+ * on a shared position and hand them over through a per-slot sequence
+ * number, so co-located processes push and pop without taking any lock or
+ * making a system call. Push fails when the ring is full and Pop when it is
+ * empty. Remote processes reach the same ring through RPC.
+ *
+ * Elements of up to RING_INLINE_SIZE bytes live in the slot itself, larger
+ * ones in a parallel array with one element per slot, allocated with the
+ * ring so that pushing them is lock-free as well. The ring is not journaled, and a Checkpoint only captures a
+ * consistent ring while no push or pop is in progress.
+ *
+ * @tparam MappedType, the value of the queue; must be trivially copyable
+ */
+template<typename MappedType>
+class ring_queue :public container{
+    static_assert(std::is_trivially_copyable<MappedType>::value,
+                  "ring_queue elements are copied between processes byte by byte");
+  private:
+    static const bool is_inline = sizeof(MappedType) <= RING_INLINE_SIZE;
+
+    /* sequence == position: free for the producer of that position;
+     * sequence == position + 1: holds the element for its consumer. */
+    struct InlineSlot {
+        std::atomic<uint64_t> sequence;
+        MappedType value;
+    };
+    struct OutOfLineSlot {
+        std::atomic<uint64_t> sequence;
+    };
+    typedef typename std::conditional<is_inline, InlineSlot, OutOfLineSlot>::type Slot;
+    /* Slots are padded to whole cache lines so neighbours don't contend. */
+    static const size_t SLOT_SIZE = (sizeof(Slot) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+    /* Lives in the segment; the two positions sit on their own cache lines. */
+    struct Ring {
+        uint64_t capacity;
+        bip::managed_mapped_file::handle_t slots;
+        bip::managed_mapped_file::handle_t elements;
+        char pad0[CACHE_LINE_SIZE];
+        std::atomic<uint64_t> enqueue_position;
+        char pad1[CACHE_LINE_SIZE];
+        std::atomic<uint64_t> dequeue_position;
+        char pad2[CACHE_LINE_SIZE];
+    };
+
+    /** Class attributes**/
+    uint64_t capacity;
+    Ring *ring;
+    char *slots;
+    char *elements;
+
+    inline Slot &SlotAt(uint64_t position) {
+        return *reinterpret_cast<Slot *>(slots + (position & (ring->capacity - 1)) * SLOT_SIZE);
+    }
+    /* The element of a claimed slot; only its claimer may touch it. */
+    inline MappedType &ElementAt(uint64_t position) {
+        if constexpr (is_inline) {
+            return SlotAt(position).value;
+        } else {
+            return *reinterpret_cast<MappedType *>(elements + (position & (ring->capacity - 1)) * sizeof(MappedType));
+        }
+    }
+  public:
+    ~ring_queue();
+
+    void construct_shared_memory() override;
+
+    void open_shared_memory() override;
+
+    void bind_functions() override;
+
+    /* capacity_ is rounded up to a power of two; only the server's matters. */
+    explicit ring_queue(CharStruct name_ = "TEST_RING_QUEUE", uint16_t port=HCL_CONF->RPC_PORT,
+                        uint64_t capacity_=RING_QUEUE_CAPACITY);
+
+    bool LocalPush(MappedType &data);
+    std::pair<bool, MappedType> LocalPop();
+    size_t LocalSize();
+    uint64_t Capacity() { return ring == nullptr ? capacity : ring->capacity; }
+
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+    THALLIUM_DEFINE(LocalPush, (data), MappedType &data)
+    THALLIUM_DEFINE1(LocalPop)
+    THALLIUM_DEFINE1(LocalSize)
+#endif
+
+    bool Push(MappedType &data, uint16_t &key_int);
+    std::pair<bool, MappedType> Pop(uint16_t &key_int);
+    size_t Size(uint16_t &key_int);
+};
+
+#include "ring_queue.cpp"
+
+}  // namespace hcl
+
+#endif  // INCLUDE_HCL_RING_QUEUE_RING_QUEUE_H_
@@ -22,6 +22,9 @@
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
+#include <atomic>
+#include <future>
+#include <mutex>
 #include <utility>
 #include <memory>
 #include <string>
@@ -31,22 +34,48 @@
 namespace bip = boost::interprocess;
 
 namespace hcl {
+/**
+ * Counter handing out unique, increasing ids. GetNextSequenceRange reserves
+ * a block of consecutive ids at once. With a lease size above 1, a process
+ * without a server on its node reserves its ids in blocks of that size and
+ * asks for the next block when half of the current one is used, so most
+ * GetNextSequence calls are answered in the process. Leased ids are unique
+ * but no longer increase in the order of calls across processes, and the
+ * unused rest of a lease is lost when the process ends. Co-located
+ * processes take every id from the shared counter with one fetch_add.
+ */
 class global_sequence :public container{
   private:
-    uint64_t* value;
+    std::atomic<uint64_t>* value;
+    uint64_t lease_size;
+    std::mutex lease_mutex;
+    /* The ids of the current lease are [lease_next, lease_end). */
+    uint64_t lease_next, lease_end;
+    std::future<uint64_t> prefetch;
+
+    uint64_t LeasedNextSequence() {
+        std::lock_guard<std::mutex> lock(lease_mutex);
+        if (lease_next == lease_end) {
+            lease_next = prefetch.valid() ? prefetch.get() : GetNextSequenceRange(lease_size);
+            lease_end = lease_next + lease_size;
+        }
+        if (!prefetch.valid() && lease_end - lease_next <= lease_size / 2) {
+            prefetch = AsyncGetNextSequenceRange(lease_size);
+        }
+        return lease_next++;
+    }
 
   public:
     ~global_sequence() {
-        this->container::~container();
     }
 
     void construct_shared_memory() override {
-        value = segment.construct<uint64_t>(name.c_str())(0);
+        value = segment.find_or_construct<std::atomic<uint64_t>>(name.c_str())(0);
     }
 
     void open_shared_memory() override {
-        std::pair<uint64_t*, bip::managed_mapped_file::size_type> res;
-        res = segment.find<uint64_t> (name.c_str());
+        std::pair<std::atomic<uint64_t>*, bip::managed_mapped_file::size_type> res;
+        res = segment.find<std::atomic<uint64_t>> (name.c_str());
         value = res.first;
     }
 
@@ -56,7 +85,10 @@ class global_sequence :public container{
             case RPCLIB: {
                 std::function<uint64_t(void)> getNextSequence(std::bind(
                 &hcl::global_sequence::LocalGetNextSequence, this));
+                std::function<uint64_t(uint64_t)> getNextSequenceRange(std::bind(
+                &hcl::global_sequence::LocalGetNextSequenceRange, this, std::placeholders::_1));
                 rpc->bind(func_prefix+"_GetNextSequence", getNextSequence);
+                rpc->bind(func_prefix+"_GetNextSequenceRange", getNextSequenceRange);
                 break;
             }
 #endif
@@ -71,15 +103,22 @@ class global_sequence :public container{
                     std::function<void(const tl::request &)> getNextSequence(std::bind(
                             &hcl::global_sequence::ThalliumLocalGetNextSequence, this,
                             std::placeholders::_1));
+                    std::function<void(const tl::request &, uint64_t)> getNextSequenceRange(std::bind(
+                            &hcl::global_sequence::ThalliumLocalGetNextSequenceRange, this,
+                            std::placeholders::_1, std::placeholders::_2));
                     rpc->bind(func_prefix+"_GetNextSequence", getNextSequence);
+                    rpc->bind(func_prefix+"_GetNextSequenceRange", getNextSequenceRange);
                     break;
                 }
 #endif
         }
+        bind_checkpoint_functions();
     }
 
-    global_sequence(CharStruct name_ = "TEST_GLOBAL_SEQUENCE", uint16_t port=HCL_CONF->RPC_PORT)
-            : container(name_,port) {
+    global_sequence(CharStruct name_ = "TEST_GLOBAL_SEQUENCE", uint16_t port=HCL_CONF->RPC_PORT,
+                    uint64_t lease_size_=HCL_CONF->SEQUENCE_LEASE_SIZE)
+            : container(name_,port), value(nullptr), lease_size(lease_size_), lease_mutex(),
+              lease_next(0), lease_end(0), prefetch() {
         AutoTrace trace = AutoTrace("hcl::global_sequence");
         if (is_server) {
             construct_shared_memory();
@@ -88,7 +127,7 @@ class global_sequence :public container{
             open_shared_memory();
         }
     }
-    uint64_t * data(){
+    std::atomic<uint64_t> * data(){
         if(server_on_node || is_server) return value;
         else nullptr;
     }
@@ -96,6 +135,9 @@ class global_sequence :public container{
         if (is_local()) {
             return LocalGetNextSequence();
         }
+        else if (lease_size > 1) {
+            return LeasedNextSequence();
+        }
         else {
             auto my_server_i = my_server;
             return RPC_CALL_WRAPPER1("_GetNextSequence", my_server_i, uint64_t);
@@ -110,14 +152,41 @@ class global_sequence :public container{
         }
     }
 
+    /*
+     * GetNextSequenceRange() reserves count consecutive ids and returns the
+     * first; the block is [first, first + count)
+     */
+    uint64_t GetNextSequenceRange(uint64_t count){
+        if (is_local()) {
+            return LocalGetNextSequenceRange(count);
+        }
+        else {
+            auto my_server_i = my_server;
+            return RPC_CALL_WRAPPER("_GetNextSequenceRange", my_server_i, uint64_t, count);
+        }
+    }
+
+    std::future<uint64_t> AsyncGetNextSequenceRange(uint64_t count){
+        if (is_local()) {
+            return ReadyFuture(LocalGetNextSequenceRange(count));
+        }
+        else {
+            auto my_server_i = my_server;
+            return RPC_CALL_WRAPPER_ASYNC("_GetNextSequenceRange", my_server_i, uint64_t, count);
+        }
+    }
+
     uint64_t LocalGetNextSequence() {
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-                lock(*mutex);
-        return ++*value;
+        return value->fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    uint64_t LocalGetNextSequenceRange(uint64_t count) {
+        return value->fetch_add(count, std::memory_order_relaxed) + 1;
     }
 
 #if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
     THALLIUM_DEFINE1(LocalGetNextSequence)
+    THALLIUM_DEFINE(LocalGetNextSequenceRange, (count), uint64_t count)
 #endif
 
 };
@@ -16,11 +16,13 @@
 /* Constructor to deallocate the shared memory*/
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 set<KeyType, Hash, Compare, Allocator , SharedType>::~set() {
-    this->container::~container();
+    WaitForMigration();
 }
 
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
-set<KeyType, Hash, Compare, Allocator , SharedType>::set(CharStruct name_, uint16_t port): container(name_, port), myset() {
+set<KeyType, Hash, Compare, Allocator , SharedType>::set(CharStruct name_, uint16_t port)
+        : container(name_, port), myset(), migrate_cursor(), migrate_resume(false),
+          replica_set(nullptr), replication() {
     AutoTrace trace = AutoTrace("hcl::set");
     if (is_server) {
         construct_shared_memory();
@@ -28,6 +30,7 @@ set<KeyType, Hash, Compare, Allocator , SharedType>::set(CharStruct name_, uint1
     }else if (!is_server && server_on_node) {
         open_shared_memory();
     }
+    WatchMembership();
 }
 
 /**
@@ -39,11 +42,137 @@ set<KeyType, Hash, Compare, Allocator , SharedType>::set(CharStruct name_, uint1
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 bool set<KeyType, Hash, Compare, Allocator , SharedType>::LocalPut(KeyType &key) {
     AutoTrace trace = AutoTrace("hcl::set::Put(local)", key);
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-    auto value = GetData<Allocator, KeyType, SharedType>(key);
-    myset->insert(value);
+    journal_commit commit(oplog.get());
+    size_t key_hash = keyHash(key);
+    bool forward = false;
+    bool result = GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex);
+        if (!Stays(key_hash) && myset->find(key) == myset->end()) {
+            forward = true;
+            return false;
+        }
+        auto &&value = GetData<Allocator, KeyType, SharedType>(key);
+        myset->insert(value);
+        LogUpdate(key_hash, key, true);
+        return true;
+    });
+    if (forward) return Forward<bool>(key_hash, "_Put", key);
+    return commit.Done() && result;
+}
+
+/**
+ * Put a batch of keys into the local set under a single lock acquisition.
+ * Servers use it to hand over keys when servers join or leave.
+ * @param keys, the keys for put
+ * @return bool, true if all the Puts were successful else false.
+ */
+template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
+bool set<KeyType, Hash, Compare, Allocator , SharedType>::LocalMultiPut(std::vector<KeyType> &keys) {
+    AutoTrace trace = AutoTrace("hcl::set::MultiPut(local)", keys.size());
+    journal_commit commit(oplog.get());
+    std::vector<size_t> moved;
+    GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex);
+        moved.clear();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (!Stays(keyHash(keys[i])) && myset->find(keys[i]) == myset->end()) {
+                moved.push_back(i);
+                continue;
+            }
+            auto &&value = GetData<Allocator, KeyType, SharedType>(keys[i]);
+            myset->insert(value);
+            LogUpdate(keyHash(keys[i]), keys[i], true);
+        }
+        return true;
+    });
+    bool result = commit.Done();
+    for (size_t i : moved) {
+        bool moved_result = Forward<bool>(keyHash(keys[i]), "_Put", keys[i]);
+        result = result && moved_result;
+    }
+    return result;
+}
 
-    return true;
+/**
+ * Applies updates sent by the owners of keys this server holds copies of,
+ * in the order they were made.
+ * @return bool, false if this server keeps no replicas
+ */
+template<typename KeyType, typename Hash, typename Compare, typename Allocator ,typename SharedType>
+bool set<KeyType, Hash, Compare, Allocator , SharedType>::LocalReplicate(std::vector<ReplicaOp> &ops) {
+    AutoTrace trace = AutoTrace("hcl::set::Replicate(local)", ops.size());
+    if (replica_set == nullptr) return false;
+    return GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex> lock(replica_set->mutex);
+        for (auto &op : ops) {
+            if (op.second) {
+                auto &&value = GetData<Allocator, KeyType, SharedType>(op.first);
+                replica_set->set.insert(value);
+            } else {
+                replica_set->set.erase(op.first);
+            }
+        }
+        return true;
+    });
+}
+
+/**
+ * Get served by any server holding key; a replica's copy may lag the
+ * owner's latest updates, so on a miss the owner is asked.
+ */
+template<typename KeyType, typename Hash, typename Compare, typename Allocator ,typename SharedType>
+bool set<KeyType, Hash, Compare, Allocator , SharedType>::LocalReplicaGet(KeyType &key) {
+    size_t key_hash = keyHash(key);
+    if (replica_set == nullptr || GetServer(key_hash) == my_server) return LocalGet(key);
+    AutoTrace trace = AutoTrace("hcl::set::ReplicaGet(local)", key);
+    {
+        boost::interprocess::sharable_lock<segment_mutex> lock(replica_set->mutex);
+        if (replica_set->set.find(key) != replica_set->set.end()) return true;
+    }
+    return Forward<bool>(key_hash, "_Get", key);
+}
+
+/**
+ * Moves the keys owned elsewhere in the next membership among the next
+ * MIGRATION_BATCH keys of the set, resuming where the previous batch stopped.
+ * The set is only locked to copy the batch and to erase what arrived (see
+ * HandOver).
+ * @return bool, false once the end of the set was reached
+ */
+template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
+bool set<KeyType, Hash, Compare, Allocator , SharedType>::MigrateStep() {
+    journal_commit commit(oplog.get());
+    const partitioner *next = next_routing.load();
+    if (next == nullptr) {
+        migrate_resume = false;
+        return false;
+    }
+    std::vector<handover_batch<KeyType, KeyType>> outgoing(next->NumServers());
+    {
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex);
+        typename MySet::iterator iterator = migrate_resume ? myset->lower_bound(migrate_cursor) : myset->begin();
+        std::vector<size_t> hashes;
+        for (size_t scanned = 0; iterator != myset->end() && scanned < MIGRATION_BATCH; ++iterator, ++scanned) {
+            size_t key_hash = keyHash(*iterator);
+            uint16_t owner = next->GetServer(key_hash);
+            if (owner == my_server) continue;
+            outgoing[owner].keys.push_back(*iterator);
+            outgoing[owner].hashes.push_back(key_hash);
+            outgoing[owner].entries.push_back(*iterator);
+            hashes.push_back(key_hash);
+        }
+        migrate_resume = iterator != myset->end();
+        if (migrate_resume) migrate_cursor = *iterator;
+        StartHandover(hashes);
+    }
+    HandOver<bool>(*mutex, outgoing,
+        [this](KeyType &key, std::vector<KeyType> &keys) {
+            if (myset->find(key) != myset->end()) keys.push_back(key);
+        },
+        [this](KeyType &key) {
+            if (myset->erase(key) > 0) LogUpdate(keyHash(key), key, false);
+        });
+    return migrate_resume;
 }
 
 /**
@@ -55,8 +184,8 @@ bool set<KeyType, Hash, Compare, Allocator , SharedType>::LocalPut(KeyType &key)
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 bool set<KeyType, Hash, Compare, Allocator , SharedType>::Put(KeyType &key) {
     size_t key_hash = keyHash(key);
-    uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
-    if (is_local(key_int)) {
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
         return LocalPut(key);
     } else {
         AutoTrace trace = AutoTrace("hcl::set::Put(remote)", key);
@@ -73,14 +202,17 @@ bool set<KeyType, Hash, Compare, Allocator , SharedType>::Put(KeyType &key) {
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 bool set<KeyType, Hash, Compare, Allocator , SharedType>::LocalGet(KeyType &key) {
     AutoTrace trace = AutoTrace("hcl::set::Get(local)", key);
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-            lock(*mutex);
-    typename MySet::iterator iterator = myset->find(key);
-    if (iterator != myset->end()) {
-        return true;
-    } else {
-        return false;
+    size_t key_hash = keyHash(key);
+    {
+        boost::interprocess::sharable_lock<segment_mutex>
+                lock(*mutex);
+        typename MySet::iterator iterator = myset->find(key);
+        if (iterator != myset->end()) {
+            return true;
+        }
+        if (Stays(key_hash)) return false;
     }
+    return Forward<bool>(key_hash, "_Get", key);
 }
 
 /**
@@ -92,7 +224,12 @@ bool set<KeyType, Hash, Compare, Allocator , SharedType>::LocalGet(KeyType &key)
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 bool set<KeyType, Hash, Compare, Allocator , SharedType>::Get(KeyType &key) {
     size_t key_hash = keyHash(key);
-    uint16_t key_int = key_hash % num_servers;
+    if (replication_factor > 1) {
+        if (HoldsReplica(key_hash)) return LocalReplicaGet(key);
+        AutoTrace trace = AutoTrace("hcl::set::Get(replica)", key);
+        return ReplicaRead<bool>(key_hash, "_ReplicaGet", key);
+    }
+    uint16_t key_int = GetServer(key_hash);
     if (is_local(key_int)) {
         return LocalGet(key);
     } else {
@@ -105,18 +242,25 @@ bool set<KeyType, Hash, Compare, Allocator , SharedType>::Get(KeyType &key) {
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 bool set<KeyType, Hash, Compare, Allocator , SharedType>::LocalErase(KeyType &key) {
     AutoTrace trace = AutoTrace("hcl::set::Erase(local)", key);
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-    size_t s = myset->erase(key);
-
-    return s > 0;
+    journal_commit commit(oplog.get());
+    size_t key_hash = keyHash(key);
+    size_t s;
+    {
+        boost::interprocess::scoped_lock<segment_mutex> lock(*mutex);
+        s = myset->erase(key);
+        if (s > 0) LogUpdate(key_hash, key, false);
+    }
+    if (s > 0) return commit.Done();
+    if (Stays(key_hash)) return false;
+    return Forward<bool>(key_hash, "_Erase", key);
 }
 
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 bool
 set<KeyType, Hash, Compare, Allocator , SharedType>::Erase(KeyType &key) {
     size_t key_hash = keyHash(key);
-    uint16_t key_int = key_hash % num_servers;
-    if (is_local(key_int)) {
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
         return LocalErase(key);
     } else {
         AutoTrace trace = AutoTrace("hcl::set::Erase(remote)", key);
@@ -135,33 +279,27 @@ template<typename KeyType,  typename Hash, typename Compare, typename Allocator
 std::vector<KeyType>
 set<KeyType, Hash, Compare, Allocator , SharedType>::Contains(KeyType &key_start, KeyType &key_end) {
     AutoTrace trace = AutoTrace("hcl::set::Contains", key_start,key_end);
-    std::vector<KeyType> final_values = std::vector<KeyType>();
-    auto current_server = ContainsInServer(key_start,key_end);
-    final_values.insert(final_values.end(), current_server.begin(), current_server.end());
-    for (int i = 0; i < num_servers; ++i) {
-        if (i != my_server) {
-            typedef std::vector<KeyType> ret_type;
-            auto server = RPC_CALL_WRAPPER("_Contains", i, ret_type, key_start,key_end);
-            final_values.insert(final_values.end(), server.begin(), server.end());
+    typedef std::vector<KeyType> ret_type;
+    auto per_server = FanOut<ret_type>([&](uint16_t server) -> std::future<ret_type> {
+        if (server == my_server) {
+            return std::async(std::launch::deferred, [&]() { return ContainsInServer(key_start, key_end); });
         }
-    }
-    return final_values;
+        return RPC_CALL_WRAPPER_ASYNC("_Contains", server, ret_type, key_start, key_end);
+    });
+    return MergeSorted(per_server, Compare());
 }
 
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 std::vector<KeyType> set<KeyType, Hash, Compare, Allocator , SharedType>::GetAllData() {
     AutoTrace trace = AutoTrace("hcl::set::GetAllData");
-    std::vector<KeyType> final_values = std::vector<KeyType>();
-    auto current_server = GetAllDataInServer();
-    final_values.insert(final_values.end(), current_server.begin(), current_server.end());
-    for (int i = 0; i < num_servers ; ++i) {
-        if (i != my_server) {
-            typedef std::vector<KeyType> ret_type;
-            auto server = RPC_CALL_WRAPPER1("_GetAllData", i, ret_type);
-            final_values.insert(final_values.end(), server.begin(), server.end());
+    typedef std::vector<KeyType> ret_type;
+    auto per_server = FanOut<ret_type>([&](uint16_t server) -> std::future<ret_type> {
+        if (server == my_server) {
+            return std::async(std::launch::deferred, [&]() { return GetAllDataInServer(); });
         }
-    }
-    return final_values;
+        return RPC_CALL_WRAPPER_ASYNC1("_GetAllData", server, ret_type);
+    });
+    return MergeSorted(per_server, Compare());
 }
 
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
@@ -169,7 +307,7 @@ std::vector<KeyType> set<KeyType, Hash, Compare, Allocator , SharedType>::LocalC
     AutoTrace trace = AutoTrace("hcl::set::ContainsInServer", key_start,key_end);
     std::vector<KeyType> final_values = std::vector<KeyType>();
     {
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
+        boost::interprocess::sharable_lock<segment_mutex> lock(*mutex);
         typename MySet::iterator lower_bound;
         size_t size = myset->size();
         if (size == 0) {
@@ -215,7 +353,7 @@ std::vector<KeyType> set<KeyType, Hash, Compare, Allocator , SharedType>::LocalG
     AutoTrace trace = AutoTrace("hcl::set::GetAllDataInServer", NULL);
     std::vector<KeyType> final_values = std::vector<KeyType>();
     {
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
+        boost::interprocess::sharable_lock<segment_mutex>
                 lock(*mutex);
         typename MySet::iterator lower_bound;
         lower_bound = myset->begin();
@@ -243,7 +381,7 @@ set<KeyType, Hash, Compare, Allocator , SharedType>::GetAllDataInServer() {
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 std::pair<bool, KeyType> set<KeyType, Hash, Compare, Allocator , SharedType>::LocalSeekFirst() {
     AutoTrace trace = AutoTrace("hcl::set::SeekFirst(local)");
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+    bip::sharable_lock<segment_mutex> lock(*mutex);
     if (myset->size() > 0) {
         auto iterator = myset->begin();  // We want First (smallest) value in set
         KeyType value = *iterator;
@@ -267,7 +405,7 @@ std::pair<bool, KeyType> set<KeyType, Hash, Compare, Allocator , SharedType>::Se
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 std::pair<bool, std::vector<KeyType>> set<KeyType, Hash, Compare, Allocator , SharedType>::LocalSeekFirstN(uint32_t n){
     AutoTrace trace = AutoTrace("hcl::set::LocalSeekFirstN(local)");
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+    bip::sharable_lock<segment_mutex> lock(*mutex);
     auto keys = std::vector<KeyType>();
     auto iterator = myset->begin();
     int i=0;
@@ -293,19 +431,24 @@ std::pair<bool, std::vector<KeyType>> set<KeyType, Hash, Compare, Allocator , Sh
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 std::pair<bool, KeyType> set<KeyType, Hash, Compare, Allocator , SharedType>::LocalPopFirst() {
     AutoTrace trace = AutoTrace("hcl::set::PopFirst(local)");
-    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
-    if (myset->size() > 0) {
-        auto iterator = myset->begin();  // We want First (smallest) value in set
-        KeyType value = *iterator;
-        myset->erase(iterator);
-        return std::pair<bool, KeyType>(true, value);
+    journal_commit commit(oplog.get());
+    std::pair<bool, KeyType> result(false, KeyType());
+    {
+        bip::scoped_lock<segment_mutex> lock(*mutex);
+        if (myset->size() > 0) {
+            auto iterator = myset->begin();  // We want First (smallest) value in set
+            result = std::pair<bool, KeyType>(true, *iterator);
+            myset->erase(iterator);
+            LogUpdate(keyHash(result.second), result.second, false);
+        }
     }
-    return std::pair<bool, KeyType>(false, KeyType());
+    if (result.first && !commit.Done()) return std::pair<bool, KeyType>(false, KeyType());
+    return result;
 }
 
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 std::pair<bool, KeyType> set<KeyType, Hash, Compare, Allocator , SharedType>::PopFirst(uint16_t &key_int) {
-    if (is_local(key_int)) {
+    if (is_local_write(key_int)) {
         return LocalPopFirst();
     } else {
         AutoTrace trace = AutoTrace("hcl::set::PopFirst(remote)",
@@ -318,6 +461,7 @@ std::pair<bool, KeyType> set<KeyType, Hash, Compare, Allocator , SharedType>::Po
 template<typename KeyType,  typename Hash, typename Compare, typename Allocator ,typename SharedType>
 size_t set<KeyType, Hash, Compare, Allocator , SharedType>::LocalSize() {
     AutoTrace trace = AutoTrace("hcl::set::Size(local)");
+    bip::sharable_lock<segment_mutex> lock(*mutex);
     return myset->size();
 }
 
@@ -336,7 +480,16 @@ template<typename KeyType, typename Hash, typename Compare, typename Allocator ,
 void set<KeyType, Hash, Compare, Allocator , SharedType>::construct_shared_memory() {
     ShmemAllocator alloc_inst(segment.get_segment_manager());
     /* Construct set in the shared memory space. */
-    myset = segment.construct<MySet>(name.c_str())(Compare(), alloc_inst);
+    myset = segment.find_or_construct<MySet>(name.c_str())(Compare(), alloc_inst);
+    if (replication_factor > 1) {
+        replica_set = segment.find_or_construct<ReplicaSet>((name + "_replicas").c_str())(alloc_inst);
+        replication = std::make_unique<replication_queue<ReplicaOp>>(num_servers,
+                [this](uint16_t server, std::vector<ReplicaOp> &ops) {
+                    return RPC_CALL_WRAPPER("_Replicate", server, bool, ops);
+                });
+    }
+    ResetLocks();
+    OpenJournal(journal_supported);
 }
 
 template<typename KeyType, typename Hash, typename Compare, typename Allocator ,typename SharedType>
@@ -345,6 +498,7 @@ void set<KeyType, Hash, Compare, Allocator , SharedType>::open_shared_memory() {
             boost::interprocess::managed_mapped_file::size_type> res;
     res = segment.find<MySet> (name.c_str());
     myset = res.first;
+    replica_set = segment.find<ReplicaSet>((name + "_replicas").c_str()).first;
 }
 
 template<typename KeyType, typename Hash, typename Compare, typename Allocator ,typename SharedType>
@@ -379,6 +533,15 @@ void set<KeyType, Hash, Compare, Allocator , SharedType>::bind_functions() {
             std::function<std::pair<bool, std::vector<KeyType>>(uint32_t)> localSeekFirstNFunc(
                     std::bind(&set<KeyType, Hash, Compare, Allocator , SharedType>::LocalSeekFirstN, this,
                               std::placeholders::_1));
+            std::function<bool(std::vector<KeyType> &)> multiPutFunc(
+                    std::bind(&set<KeyType, Hash, Compare, Allocator , SharedType>::LocalMultiPut, this,
+                              std::placeholders::_1));
+            std::function<bool(std::vector<ReplicaOp> &)> replicateFunc(
+                    std::bind(&set<KeyType, Hash, Compare, Allocator , SharedType>::LocalReplicate, this,
+                              std::placeholders::_1));
+            std::function<bool(KeyType &)> replicaGetFunc(
+                    std::bind(&set<KeyType, Hash, Compare, Allocator , SharedType>::LocalReplicaGet, this,
+                              std::placeholders::_1));
             rpc->bind(func_prefix+"_Put", putFunc);
             rpc->bind(func_prefix+"_Get", getFunc);
             rpc->bind(func_prefix+"_Erase", eraseFunc);
@@ -389,6 +552,9 @@ void set<KeyType, Hash, Compare, Allocator , SharedType>::bind_functions() {
             rpc->bind(func_prefix+"_PopFirst", popFirstFunc);
             rpc->bind(func_prefix+"_SeekFirstN", localSeekFirstNFunc);
             rpc->bind(func_prefix+"_Size", sizeFunc);
+            rpc->bind(func_prefix+"_MultiPut", multiPutFunc);
+            rpc->bind(func_prefix+"_Replicate", replicateFunc);
+            rpc->bind(func_prefix+"_ReplicaGet", replicaGetFunc);
             break;
         }
 #endif
@@ -432,6 +598,15 @@ void set<KeyType, Hash, Compare, Allocator , SharedType>::bind_functions() {
                         std::bind(&set<KeyType, Hash, Compare, Allocator , SharedType>::ThalliumLocalSeekFirstN, this,
 				  std::placeholders::_1,
 				  std::placeholders::_2));
+                std::function<void(const tl::request &, std::vector<KeyType> &)> multiPutFunc(
+                        std::bind(&set<KeyType, Hash, Compare, Allocator , SharedType>::ThalliumLocalMultiPut, this,
+                                  std::placeholders::_1, std::placeholders::_2));
+                std::function<void(const tl::request &, std::vector<ReplicaOp> &)> replicateFunc(
+                        std::bind(&set<KeyType, Hash, Compare, Allocator , SharedType>::ThalliumLocalReplicate, this,
+                                  std::placeholders::_1, std::placeholders::_2));
+                std::function<void(const tl::request &, KeyType &)> replicaGetFunc(
+                        std::bind(&set<KeyType, Hash, Compare, Allocator , SharedType>::ThalliumLocalReplicaGet, this,
+                                  std::placeholders::_1, std::placeholders::_2));
                 rpc->bind(func_prefix+"_Put", putFunc);
                 rpc->bind(func_prefix+"_Get", getFunc);
                 rpc->bind(func_prefix+"_Erase", eraseFunc);
@@ -442,10 +617,67 @@ void set<KeyType, Hash, Compare, Allocator , SharedType>::bind_functions() {
                 rpc->bind(func_prefix+"_PopFirst", popFirstFunc);
                 // rpc->bind(func_prefix+"_SeekFirstN", localSeekFirstNFunc);
                 rpc->bind(func_prefix+"_Size", sizeFunc);
+                rpc->bind(func_prefix+"_MultiPut", multiPutFunc);
+                rpc->bind(func_prefix+"_Replicate", replicateFunc);
+                rpc->bind(func_prefix+"_ReplicaGet", replicaGetFunc);
 		break;
                 }
 #endif
     }
+    bind_membership_functions();
+    bind_checkpoint_functions();
+}
+
+/**
+ * Asynchronous Put. The request is sent immediately and the returned future
+ * yields the same result as Put; a key owned by the local server is stored
+ * before returning and the future is already ready.
+ */
+template<typename KeyType, typename Hash, typename Compare, typename Allocator ,typename SharedType>
+std::future<bool>
+set<KeyType, Hash, Compare, Allocator , SharedType>::AsyncPut(KeyType &key) {
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalPut(key));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::set::AsyncPut(remote)", key);
+        return RPC_CALL_WRAPPER_ASYNC("_Put", key_int, bool, key);
+    }
+}
+
+/**
+ * Asynchronous Get; see AsyncPut.
+ */
+template<typename KeyType, typename Hash, typename Compare, typename Allocator ,typename SharedType>
+std::future<bool>
+set<KeyType, Hash, Compare, Allocator , SharedType>::AsyncGet(KeyType &key) {
+    typedef bool ret_type;
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local(key_int)) {
+        return ReadyFuture(LocalGet(key));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::set::AsyncGet(remote)", key);
+        return RPC_CALL_WRAPPER_ASYNC("_Get", key_int, ret_type, key);
+    }
+}
+
+/**
+ * Asynchronous Erase; see AsyncPut.
+ */
+template<typename KeyType, typename Hash, typename Compare, typename Allocator ,typename SharedType>
+std::future<bool>
+set<KeyType, Hash, Compare, Allocator , SharedType>::AsyncErase(KeyType &key) {
+    typedef bool ret_type;
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalErase(key));
+    } else {
+        AutoTrace trace = AutoTrace("hcl::set::AsyncErase(remote)", key);
+        return RPC_CALL_WRAPPER_ASYNC("_Erase", key_int, ret_type, key);
+    }
 }
 
 #endif  // INCLUDE_HCL_SET_SET_CPP_
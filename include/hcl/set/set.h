@@ -69,9 +69,51 @@ class set :public container {
     ShmemAllocator;
     typedef boost::interprocess::set<KeyType, Compare, ShmemAllocator>
     MySet;
+    /* An update sent to replicas: the key and whether it is still present. */
+    typedef std::pair<KeyType, bool> ReplicaOp;
+    /* Copies of keys owned by other servers, locked apart from myset. */
+    struct ReplicaSet {
+        segment_mutex mutex;
+        MySet set;
+        explicit ReplicaSet(const ShmemAllocator &allocator)
+                : mutex(HCL_CONF->READ_WRITE_LOCK), set(Compare(), allocator) {}
+    };
     /** Class attributes**/
     Hash keyHash;
     MySet *myset;
+    /* Migration cursor: the first key the next batch looks at. */
+    KeyType migrate_cursor;
+    bool migrate_resume;
+    /* Both null without replication. */
+    ReplicaSet *replica_set;
+    std::unique_ptr<replication_queue<ReplicaOp>> replication;
+
+    bool MigrateStep() override;
+    static const bool journal_supported = journal_codec<KeyType>::supported;
+    /* Hands an applied update to the journal and the replicas. Called with
+     * the set locked, so both see updates in order. */
+    void LogUpdate(size_t key_hash, const KeyType &key, bool present) {
+        NoteWrite(key_hash);
+        if constexpr (journal_supported) {
+            if (oplog != nullptr) Journal(journal_record(present ? JOURNAL_PUT : JOURNAL_ERASE) << key);
+        }
+        if (replication != nullptr) QueueReplicas(replication.get(), key_hash, ReplicaOp(key, present));
+    }
+    void ReplayRecord(journal_reader &record) override {
+        if constexpr (journal_supported) {
+            uint8_t op = record.Op();
+            KeyType key;
+            record >> key;
+            if (!record.Valid()) return;
+            if (op == JOURNAL_PUT) LocalPut(key);
+            else if (op == JOURNAL_ERASE) LocalErase(key);
+        }
+    }
+    std::vector<segment_mutex *> AllocationLocks() override {
+        std::vector<segment_mutex *> locks(1, mutex);
+        if (replica_set != nullptr) locks.push_back(&replica_set->mutex);
+        return locks;
+    }
 
   public:
     ~set();
@@ -97,6 +139,9 @@ class set :public container {
     std::pair<bool, KeyType> LocalPopFirst();
     size_t LocalSize();
     std::pair<bool, std::vector<KeyType>> LocalSeekFirstN(uint32_t n);
+    bool LocalMultiPut(std::vector<KeyType> &keys);
+    bool LocalReplicate(std::vector<ReplicaOp> &ops);
+    bool LocalReplicaGet(KeyType &key);
 
 
 #if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
@@ -106,6 +151,9 @@ class set :public container {
     THALLIUM_DEFINE(LocalContainsInServer, (key_start, key_end), KeyType &key_start,
 		    KeyType &key_end)
     THALLIUM_DEFINE(LocalSeekFirstN, (n), uint32_t n)
+    THALLIUM_DEFINE(LocalMultiPut, (keys), std::vector<KeyType> &keys)
+    THALLIUM_DEFINE(LocalReplicate, (ops), std::vector<ReplicaOp> &ops)
+    THALLIUM_DEFINE(LocalReplicaGet, (key), KeyType &key)
 
     THALLIUM_DEFINE1(LocalSize)
     THALLIUM_DEFINE1(LocalSeekFirst)
@@ -117,6 +165,9 @@ class set :public container {
     bool Get(KeyType &key);
 
     bool Erase(KeyType &key);
+    std::future<bool> AsyncPut(KeyType &key);
+    std::future<bool> AsyncGet(KeyType &key);
+    std::future<bool> AsyncErase(KeyType &key);
     std::vector<KeyType> Contains(KeyType &key_start,KeyType &key_end);
 
     std::vector<KeyType> GetAllData();
@@ -18,12 +18,15 @@
 /* Constructor to deallocate the shared memory*/
 template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
 unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::~unordered_map() {
-    this->container::~container();
+    WaitForMigration();
 }
 
 template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
-unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::unordered_map(CharStruct name_, uint16_t port)
-        : container(name_,port), myHashMap(), size_occupied(0){
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::unordered_map(CharStruct name_, uint16_t port,
+                                                                  uint16_t num_stripes_)
+        : container(name_,port), stripes(), num_stripes(num_stripes_ > 0 ? num_stripes_ : 1),
+          migrate_stripe(0), migrate_bucket(0), migrate_bucket_count(0), cache(),
+          replica_stripe(nullptr), replication(), size_occupied(0){
     // init my_server, num_servers, server_on_node, processor_name from RPC
     AutoTrace trace = AutoTrace("hcl::unordered_map");
     if (is_server) {
@@ -32,6 +35,9 @@ unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::unordered_map(C
     }else if (!is_server && server_on_node) {
         open_shared_memory();
     }
+    WatchMembership();
+    if (HCL_CONF->CLIENT_CACHE_SIZE > 0)
+        cache = std::make_unique<client_cache<KeyType, MappedType, Hash>>(HCL_CONF->CLIENT_CACHE_SIZE);
 }
 
 /**
@@ -43,11 +49,26 @@ unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::unordered_map(C
 template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
 bool unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalPut(KeyType &key,
                                                   MappedType &data) {
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>lock(*mutex);
-    auto value = GetData<Allocator, MappedType, SharedType>(data);
-    auto iter = myHashMap->insert_or_assign(key, value);
-    if(iter.second) size_occupied += CalculateSize<KeyType>().GetSize(key) + CalculateSize<MappedType>().GetSize(data);
-    return true;
+    journal_commit commit(oplog.get());
+    size_t key_hash = keyHash(key);
+    Stripe &stripe = GetStripe(key_hash);
+    bool forward = false;
+    lease_writer writer(leases, key_hash);
+    bool result = GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex> lock(stripe.mutex, boost::interprocess::defer_lock);
+        writer.Lock(lock);
+        if (!Stays(key_hash) && stripe.map.find(key) == stripe.map.end()) {
+            forward = true;
+            return false;
+        }
+        auto &&value = GetData<Allocator, MappedType, SharedType>(data);
+        auto iter = stripe.map.insert_or_assign(key, value);
+        if(iter.second) size_occupied += CalculateSize<KeyType>().GetSize(key) + CalculateSize<MappedType>().GetSize(data);
+        LogUpdate(key_hash, key, true, data);
+        return true;
+    });
+    if (forward) return Forward<bool>(key_hash, "_Put", key, data);
+    return commit.Done() && result;
 }
 /**
  * Put the data into the unordered map. Uses key to decide the server to hash it to,
@@ -58,10 +79,17 @@ bool unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalPut(K
 template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
 bool unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::Put(KeyType key,
                                              MappedType data) {
-    uint16_t key_int = (uint16_t)keyHash(key)% num_servers;
-    if (is_local(key_int)) {
+    if (cache != nullptr) cache->Invalidate(key);
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
         return LocalPut(key, data);
     } else {
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        if (UseBulk<Allocator, MappedType>()) {
+            return BulkCall<bool>(key_int, "_BulkPut", data, tl::bulk_mode::read_only, key);
+        }
+#endif
         return RPC_CALL_WRAPPER("_Put", key_int, bool,
                                 key, data);
     }
@@ -77,14 +105,59 @@ bool unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::Put(KeyTyp
 template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
 std::pair<bool, MappedType>
 unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalGet(KeyType &key) {
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-            lock(*mutex);
-    typename MyHashMap::iterator iterator = myHashMap->find(key);
-    if (iterator != myHashMap->end()) {
-        return std::pair<bool, MappedType>(true, iterator->second);
-    } else {
-        return std::pair<bool, MappedType>(false, MappedType());
+    size_t key_hash = keyHash(key);
+    Stripe &stripe = GetStripe(key_hash);
+    {
+        boost::interprocess::sharable_lock<segment_mutex>
+                lock(stripe.mutex);
+        typename MyHashMap::iterator iterator = stripe.map.find(key);
+        if (iterator != stripe.map.end()) {
+            return std::pair<bool, MappedType>(true, iterator->second);
+        }
+        if (Stays(key_hash)) return std::pair<bool, MappedType>(false, MappedType());
     }
+    typedef std::pair<bool, MappedType> ret_type;
+    return Forward<ret_type>(key_hash, "_Get", key);
+}
+
+/**
+ * LocalGet for a caching client: also grants a read lease on the key, which
+ * Put and Erase wait out before changing it.
+ * @return the lease in nanoseconds (0 if none) and the result of LocalGet
+ */
+template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
+std::pair<uint64_t, std::pair<bool, MappedType>>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalLeasedGet(KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    Stripe &stripe = GetStripe(key_hash);
+    {
+        boost::interprocess::sharable_lock<segment_mutex>
+                lock(stripe.mutex);
+        typename MyHashMap::iterator iterator = stripe.map.find(key);
+        if (iterator != stripe.map.end()) {
+            return std::pair<uint64_t, ret_type>(GrantLease(key_hash), ret_type(true, iterator->second));
+        }
+        if (Stays(key_hash)) return std::pair<uint64_t, ret_type>(GrantLease(key_hash), ret_type(false, MappedType()));
+    }
+    return std::pair<uint64_t, ret_type>(0, Forward<ret_type>(key_hash, "_Get", key));
+}
+
+/**
+ * Get through the client cache: a cached result is used while its lease
+ * lasts, otherwise the server is asked for the value and a new lease.
+ */
+template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
+std::pair<bool, MappedType>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::CachedGet(uint16_t key_int, KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
+    typedef std::pair<uint64_t, ret_type> leased_type;
+    ret_type result;
+    if (cache->Lookup(key, result)) return result;
+    auto sent = std::chrono::steady_clock::now();
+    leased_type leased = RPC_CALL_WRAPPER("_LeasedGet", key_int, leased_type, key);
+    if (leased.first > 0) cache->Insert(key, leased.second, sent + std::chrono::nanoseconds(leased.first));
+    return leased.second;
 }
 
 /**
@@ -96,37 +169,151 @@ unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalGet(KeyTyp
 template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
 std::pair<bool, MappedType>
 unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::Get(KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
     size_t key_hash = keyHash(key);
-    uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
+    /* Cached reads need the owner's lease, so only uncached ones use replicas. */
+    if (replication_factor > 1 && cache == nullptr) {
+        if (HoldsReplica(key_hash)) return LocalReplicaGet(key);
+        return ReplicaRead<ret_type>(key_hash, "_ReplicaGet", key);
+    }
+    uint16_t key_int = GetServer(key_hash);
     if (is_local(key_int)) {
         return LocalGet(key);
     } else {
-        typedef std::pair<bool, MappedType> ret_type;
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        if (UseBulk<Allocator, MappedType>()) {
+            ret_type result(false, MappedType());
+            result.first = BulkCall<bool>(key_int, "_BulkGet", result.second, tl::bulk_mode::write_only, key);
+            return result;
+        }
+#endif
+       if (cache != nullptr) return CachedGet(key_int, key);
        return RPC_CALL_WRAPPER("_Get", key_int, ret_type,key);
     }
 }
 
+/**
+ * Get a read handle to the data. For a key held by the co-located server the
+ * handle pins the value in place under the stripe's shared lock instead of
+ * copying it out; otherwise it owns the value fetched by Get.
+ * @param key, key to get
+ * @return value_view, empty if the key was not found
+ */
+template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
+value_view<MappedType>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::GetView(KeyType &key) {
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local(key_int)) {
+        Stripe &stripe = GetStripe(key_hash);
+        {
+            boost::interprocess::sharable_lock<segment_mutex>
+                    lock(stripe.mutex);
+            typename MyHashMap::iterator iterator = stripe.map.find(key);
+            if (iterator != stripe.map.end()) return value_view<MappedType>(std::move(lock), &iterator->second);
+            if (Stays(key_hash)) return value_view<MappedType>();
+        }
+        typedef std::pair<bool, MappedType> ret_type;
+        return value_view<MappedType>(Forward<ret_type>(key_hash, "_Get", key));
+    }
+    return value_view<MappedType>(Get(key));
+}
+
+/**
+ * Run visitor(const MappedType &) on the data for key, in place when the key
+ * is held by the co-located server.
+ * @return bool, false if the key was not found and visitor was not called
+ */
+template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
+template<typename Visitor>
+bool unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::WithValue(KeyType &key, Visitor visitor) {
+    value_view<MappedType> view = GetView(key);
+    if (!view) return false;
+    visitor(*view);
+    return true;
+}
+
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+/**
+ * Server side of a bulk Put: the value is pulled from the client and then
+ * put as by LocalPut, so a failed transfer leaves the map as it was.
+ */
+template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
+void unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalBulkPut(
+        const tl::request &thallium_req, KeyType &key, tl::bulk &bulk_handle) {
+    MappedType data;
+    try {
+        rpc->rdma_pull(thallium_req, bulk_handle, &data, sizeof(MappedType));
+    } catch (std::exception &e) {
+        printf("Error: %s could not pull a put value: %s\n", name.c_str(), e.what());
+        hcl::SendResponse(thallium_req, false);
+        return;
+    }
+    hcl::SendResponse(thallium_req, LocalPut(key, data));
+}
+
+/**
+ * Server side of a bulk Get: the stored value is pushed from the segment
+ * into the client's buffer. Responds whether the key was found.
+ */
+template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
+void unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalBulkGet(
+        const tl::request &thallium_req, KeyType &key, tl::bulk &bulk_handle) {
+    size_t key_hash = keyHash(key);
+    Stripe &stripe = GetStripe(key_hash);
+    {
+        boost::interprocess::sharable_lock<segment_mutex> lock(stripe.mutex);
+        typename MyHashMap::iterator iterator = stripe.map.find(key);
+        bool found = iterator != stripe.map.end();
+        if (found) rpc->rdma_push(thallium_req, bulk_handle, &iterator->second, sizeof(MappedType));
+        if (found || Stays(key_hash)) {
+            hcl::SendResponse(thallium_req, found);
+            return;
+        }
+    }
+    typedef std::pair<bool, MappedType> ret_type;
+    ret_type result = Forward<ret_type>(key_hash, "_Get", key);
+    if (result.first) rpc->rdma_push(thallium_req, bulk_handle, &result.second, sizeof(MappedType));
+    hcl::SendResponse(thallium_req, result.first);
+}
+#endif
+
 
 
 template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
 std::pair<bool, MappedType>
 unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalErase(KeyType &key) {
-    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-            lock(*mutex);
-    typename MyHashMap::iterator iterator = myHashMap->find(key);
-    if (iterator != myHashMap->end()) {
-        size_occupied -= CalculateSize<KeyType>().GetSize(key) + CalculateSize<MappedType>().GetSize(iterator->second);
-        myHashMap->erase(iterator);
-        return std::pair<bool, MappedType>(true, MappedType());
-    }else return std::pair<bool, MappedType>(false, MappedType());
+    journal_commit commit(oplog.get());
+    size_t key_hash = keyHash(key);
+    Stripe &stripe = GetStripe(key_hash);
+    bool erased = false;
+    {
+        lease_writer writer(leases, key_hash);
+        boost::interprocess::scoped_lock<segment_mutex>
+                lock(stripe.mutex, boost::interprocess::defer_lock);
+        writer.Lock(lock);
+        typename MyHashMap::iterator iterator = stripe.map.find(key);
+        if (iterator != stripe.map.end()) {
+            size_occupied -= CalculateSize<KeyType>().GetSize(key) + CalculateSize<MappedType>().GetSize(iterator->second);
+            stripe.map.erase(iterator);
+            LogUpdate(key_hash, key, false, MappedType());
+            erased = true;
+        } else if (Stays(key_hash)) {
+            return std::pair<bool, MappedType>(false, MappedType());
+        }
+    }
+    if (erased) return std::pair<bool, MappedType>(commit.Done(), MappedType());
+    typedef std::pair<bool, MappedType> ret_type;
+    return Forward<ret_type>(key_hash, "_Erase", key);
 }
 
 template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
 std::pair<bool, MappedType>
 unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::Erase(KeyType &key) {
+    if (cache != nullptr) cache->Invalidate(key);
     size_t key_hash = keyHash(key);
-    uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
-    if (is_local(key_int)) {
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
         return LocalErase(key);
     } else {
       typedef std::pair<bool, MappedType> ret_type;
@@ -141,17 +328,19 @@ unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::Erase(KeyType &
 template<typename KeyType, typename MappedType,typename Hash, typename Allocator ,typename SharedType>
 std::vector<std::pair<KeyType, MappedType>>
 unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::GetAllData() {
-    std::vector<std::pair<KeyType, MappedType>> final_values =
-            std::vector<std::pair<KeyType, MappedType>>();
-    auto current_server = GetAllDataInServer();
-    final_values.insert(final_values.end(), current_server.begin(),
-                        current_server.end());
-    for (int i = 0; i < num_servers; ++i) {
+    typedef std::vector<std::pair<KeyType, MappedType> > ret_type;
+    auto per_server = FanOut<ret_type>([&](uint16_t server) -> std::future<ret_type> {
+        if (server == my_server) {
+            return std::async(std::launch::deferred, [&]() { return GetAllDataInServer(); });
+        }
+        return RPC_CALL_WRAPPER_ASYNC1("_GetAllData", server, ret_type);
+    });
+    /* A client of a server that has left starts from an empty list. */
+    ret_type final_values;
+    if (my_server < per_server.size()) final_values = std::move(per_server[my_server]);
+    for (int i = 0; i < per_server.size(); ++i) {
         if (i != my_server) {
-	  
-            typedef std::vector<std::pair<KeyType, MappedType> > ret_type;
-            auto server = RPC_CALL_WRAPPER1("_GetAllData",i, ret_type);
-            final_values.insert(final_values.end(), server.begin(), server.end());
+            final_values.insert(final_values.end(), per_server[i].begin(), per_server[i].end());
         }
     }
     return final_values;
@@ -162,13 +351,15 @@ std::vector<std::pair<KeyType, MappedType>>
 unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalGetAllDataInServer() {
     std::vector<std::pair<KeyType, MappedType>> final_values =
             std::vector<std::pair<KeyType, MappedType>>();
-    {
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>
-                lock(*mutex);
+    /* Stripes are locked one at a time, so the result is a per-stripe (not a
+     * server-wide) snapshot. */
+    for (uint16_t i = 0; i < num_stripes; ++i) {
+        boost::interprocess::sharable_lock<segment_mutex>
+                lock(stripes[i].mutex);
         typename MyHashMap::iterator lower_bound;
-        if (myHashMap->size() > 0) {
-            lower_bound = myHashMap->begin();
-            while (lower_bound != myHashMap->end()) {
+        if (stripes[i].map.size() > 0) {
+            lower_bound = stripes[i].map.begin();
+            while (lower_bound != stripes[i].map.end()) {
                 final_values.push_back(std::pair<KeyType, MappedType>(
                     lower_bound->first, lower_bound->second));
                 lower_bound++;
@@ -193,11 +384,380 @@ unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::GetAllDataInSer
 
 
 
+/**
+ * Put a batch of key-value pairs into the local unordered map. Entries are
+ * grouped by stripe so every stripe touched is locked only once.
+ * @param entries, the key-value pairs for put
+ * @return bool, true if all the Puts were successful else false.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+bool unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalMultiPut(
+        std::vector<std::pair<KeyType, MappedType>> &entries) {
+    journal_commit commit(oplog.get());
+    std::vector<std::vector<size_t>> per_stripe(num_stripes);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        per_stripe[GetStripeIndex(keyHash(entries[i].first))].push_back(i);
+    }
+    std::vector<size_t> moved;
+    for (uint16_t s = 0; s < num_stripes; ++s) {
+        if (per_stripe[s].empty()) continue;
+        Stripe &stripe = stripes[s];
+        lease_writer writer(leases);
+        for (size_t i : per_stripe[s]) writer.Add(keyHash(entries[i].first));
+        GrowOnBadAlloc([&]() {
+            boost::interprocess::scoped_lock<segment_mutex> lock(stripe.mutex, boost::interprocess::defer_lock);
+            writer.Lock(lock);
+            for (size_t i : per_stripe[s]) {
+                auto &entry = entries[i];
+                if (!Stays(keyHash(entry.first)) && stripe.map.find(entry.first) == stripe.map.end()) {
+                    /* A retry after growing the segment revisits every entry. */
+                    if (std::find(moved.begin(), moved.end(), i) == moved.end()) moved.push_back(i);
+                    continue;
+                }
+                auto &&value = GetData<Allocator, MappedType, SharedType>(entry.second);
+                auto iter = stripe.map.insert_or_assign(entry.first, value);
+                if (iter.second) size_occupied += CalculateSize<KeyType>().GetSize(entry.first) +
+                                                  CalculateSize<MappedType>().GetSize(entry.second);
+                LogUpdate(keyHash(entry.first), entry.first, true, entry.second);
+            }
+            return true;
+        });
+    }
+    bool result = commit.Done();
+    for (size_t i : moved) {
+        bool moved_result = Forward<bool>(keyHash(entries[i].first), "_Put", entries[i].first, entries[i].second);
+        result = result && moved_result;
+    }
+    return result;
+}
+
+/**
+ * Get a batch of keys from the local unordered map, locking each stripe
+ * touched once.
+ * @param keys, keys to get
+ * @return one pair of bool and Value per key, in the order of keys.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+std::vector<std::pair<bool, MappedType>>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalMultiGet(std::vector<KeyType> &keys) {
+    std::vector<std::pair<bool, MappedType>> results(keys.size());
+    std::vector<std::vector<size_t>> per_stripe(num_stripes);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        per_stripe[GetStripeIndex(keyHash(keys[i]))].push_back(i);
+    }
+    std::vector<size_t> moved;
+    for (uint16_t s = 0; s < num_stripes; ++s) {
+        if (per_stripe[s].empty()) continue;
+        Stripe &stripe = stripes[s];
+        boost::interprocess::sharable_lock<segment_mutex> lock(stripe.mutex);
+        for (size_t i : per_stripe[s]) {
+            typename MyHashMap::iterator iterator = stripe.map.find(keys[i]);
+            if (iterator != stripe.map.end()) {
+                results[i] = std::pair<bool, MappedType>(true, iterator->second);
+            } else {
+                results[i] = std::pair<bool, MappedType>(false, MappedType());
+                if (!Stays(keyHash(keys[i]))) moved.push_back(i);
+            }
+        }
+    }
+    typedef std::pair<bool, MappedType> ret_type;
+    for (size_t i : moved) results[i] = Forward<ret_type>(keyHash(keys[i]), "_Get", keys[i]);
+    return results;
+}
+
+/**
+ * Erase a batch of keys from the local unordered map, locking each stripe
+ * touched once.
+ * @param keys, keys to erase
+ * @return one pair per key, in the order of keys; bool is true if the key
+ * was present.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+std::vector<std::pair<bool, MappedType>>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalMultiErase(std::vector<KeyType> &keys) {
+    journal_commit commit(oplog.get());
+    std::vector<std::pair<bool, MappedType>> results(keys.size());
+    std::vector<std::vector<size_t>> per_stripe(num_stripes);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        per_stripe[GetStripeIndex(keyHash(keys[i]))].push_back(i);
+    }
+    std::vector<size_t> moved;
+    for (uint16_t s = 0; s < num_stripes; ++s) {
+        if (per_stripe[s].empty()) continue;
+        Stripe &stripe = stripes[s];
+        lease_writer writer(leases);
+        for (size_t i : per_stripe[s]) writer.Add(keyHash(keys[i]));
+        boost::interprocess::scoped_lock<segment_mutex> lock(stripe.mutex, boost::interprocess::defer_lock);
+        writer.Lock(lock);
+        for (size_t i : per_stripe[s]) {
+            typename MyHashMap::iterator iterator = stripe.map.find(keys[i]);
+            if (iterator != stripe.map.end()) {
+                size_occupied -= CalculateSize<KeyType>().GetSize(keys[i]) +
+                                 CalculateSize<MappedType>().GetSize(iterator->second);
+                stripe.map.erase(iterator);
+                LogUpdate(keyHash(keys[i]), keys[i], false, MappedType());
+                results[i] = std::pair<bool, MappedType>(true, MappedType());
+            } else {
+                results[i] = std::pair<bool, MappedType>(false, MappedType());
+                if (!Stays(keyHash(keys[i]))) moved.push_back(i);
+            }
+        }
+    }
+    if (!commit.Done()) {
+        for (auto &result : results) result.first = false;
+    }
+    typedef std::pair<bool, MappedType> ret_type;
+    for (size_t i : moved) results[i] = Forward<ret_type>(keyHash(keys[i]), "_Erase", keys[i]);
+    return results;
+}
+
+/**
+ * Applies updates sent by the owners of keys this server holds copies of,
+ * in the order they were made.
+ * @param ops, the updates; a pair with bool false erases the key
+ * @return bool, false if this server keeps no replicas
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+bool unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalReplicate(std::vector<ReplicaOp> &ops) {
+    if (replica_stripe == nullptr) return false;
+    return GrowOnBadAlloc([&]() {
+        boost::interprocess::scoped_lock<segment_mutex> lock(replica_stripe->mutex);
+        /* Reapplying the whole batch after the segment grew is harmless. */
+        for (auto &op : ops) {
+            if (op.second.first) {
+                auto &&value = GetData<Allocator, MappedType, SharedType>(op.second.second);
+                replica_stripe->map.insert_or_assign(op.first, value);
+            } else {
+                replica_stripe->map.erase(op.first);
+            }
+        }
+        return true;
+    });
+}
+
+/**
+ * Get served by any server holding key: the owner answers from its data,
+ * replicas from their copy, which may lag the owner's latest updates. A
+ * replica that misses asks the owner, since the key may have been put after
+ * the last batch it received, or before it restarted.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+std::pair<bool, MappedType>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalReplicaGet(KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    if (replica_stripe == nullptr || GetServer(key_hash) == my_server) return LocalGet(key);
+    {
+        boost::interprocess::sharable_lock<segment_mutex> lock(replica_stripe->mutex);
+        typename MyHashMap::iterator iterator = replica_stripe->map.find(key);
+        if (iterator != replica_stripe->map.end()) return ret_type(true, iterator->second);
+    }
+    return Forward<ret_type>(key_hash, "_Get", key);
+}
+
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+template<typename Item, typename KeyOf>
+void unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::GroupByServer(std::vector<Item> &items, KeyOf key_of,
+        std::vector<std::vector<size_t>> &positions) {
+    const partitioner *table = Routing();
+    positions.assign(table->NumServers(), std::vector<size_t>());
+    for (size_t i = 0; i < items.size(); ++i) {
+        size_t key_hash = keyHash(key_of(items[i]));
+        positions[table->GetServer(key_hash)].push_back(i);
+    }
+}
+
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+void unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::GroupByServer(std::vector<KeyType> &keys,
+        std::vector<std::vector<size_t>> &positions) {
+    GroupByServer(keys, [](KeyType &key) -> KeyType & { return key; }, positions);
+}
+
+/**
+ * Put a batch of key-value pairs. Entries are grouped by destination server
+ * and each server receives a single RPC carrying all of its entries; entries
+ * owned by the local server skip RPC.
+ * @param entries, the key-value pairs for put
+ * @return bool, true if all the Puts were successful else false.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+bool unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::MultiPut(std::vector<std::pair<KeyType, MappedType>> &entries) {
+    if (cache != nullptr) {
+        for (auto &entry : entries) cache->Invalidate(entry.first);
+    }
+    std::vector<std::vector<size_t>> positions;
+    GroupByServer(entries, [](std::pair<KeyType, MappedType> &entry) -> KeyType & { return entry.first; },
+                  positions);
+    bool result = true;
+    for (uint16_t key_int = 0; key_int < positions.size(); ++key_int) {
+        if (positions[key_int].empty()) continue;
+        /* Only copy out a sub-batch when the entries span several servers. */
+        std::vector<std::pair<KeyType, MappedType>> sub_batch;
+        if (positions[key_int].size() != entries.size()) {
+            sub_batch.reserve(positions[key_int].size());
+            for (size_t i : positions[key_int]) sub_batch.push_back(entries[i]);
+        }
+        auto &batch = sub_batch.empty() ? entries : sub_batch;
+        bool batch_result;
+        if (is_local_write(key_int)) {
+            batch_result = LocalMultiPut(batch);
+        } else {
+            batch_result = RPC_CALL_WRAPPER("_MultiPut", key_int, bool, batch);
+        }
+        result = result && batch_result;
+    }
+    return result;
+}
+
+/**
+ * Get a batch of keys with one RPC per destination server.
+ * @param keys, keys to get
+ * @return one pair of bool and Value per key, in the order of keys.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+std::vector<std::pair<bool, MappedType>>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::MultiGet(std::vector<KeyType> &keys) {
+    typedef std::vector<std::pair<bool, MappedType>> ret_type;
+    std::vector<std::vector<size_t>> positions;
+    GroupByServer(keys, positions);
+    ret_type results;
+    for (uint16_t key_int = 0; key_int < positions.size(); ++key_int) {
+        if (positions[key_int].empty()) continue;
+        bool whole = positions[key_int].size() == keys.size();
+        std::vector<KeyType> sub_batch;
+        if (!whole) {
+            sub_batch.reserve(positions[key_int].size());
+            for (size_t i : positions[key_int]) sub_batch.push_back(keys[i]);
+        }
+        auto &batch = whole ? keys : sub_batch;
+        ret_type batch_results;
+        if (is_local(key_int)) {
+            batch_results = LocalMultiGet(batch);
+        } else {
+            batch_results = RPC_CALL_WRAPPER("_MultiGet", key_int, ret_type, batch);
+        }
+        /* A single destination already answers in the caller's order. */
+        if (whole) return batch_results;
+        if (results.empty()) results.resize(keys.size());
+        for (size_t i = 0; i < batch_results.size(); ++i) {
+            results[positions[key_int][i]] = std::move(batch_results[i]);
+        }
+    }
+    return results;
+}
+
+/**
+ * Erase a batch of keys with one RPC per destination server.
+ * @param keys, keys to erase
+ * @return one pair per key, in the order of keys; bool is true if the key
+ * was present.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+std::vector<std::pair<bool, MappedType>>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::MultiErase(std::vector<KeyType> &keys) {
+    if (cache != nullptr) {
+        for (auto &key : keys) cache->Invalidate(key);
+    }
+    typedef std::vector<std::pair<bool, MappedType>> ret_type;
+    std::vector<std::vector<size_t>> positions;
+    GroupByServer(keys, positions);
+    ret_type results;
+    for (uint16_t key_int = 0; key_int < positions.size(); ++key_int) {
+        if (positions[key_int].empty()) continue;
+        bool whole = positions[key_int].size() == keys.size();
+        std::vector<KeyType> sub_batch;
+        if (!whole) {
+            sub_batch.reserve(positions[key_int].size());
+            for (size_t i : positions[key_int]) sub_batch.push_back(keys[i]);
+        }
+        auto &batch = whole ? keys : sub_batch;
+        ret_type batch_results;
+        if (is_local_write(key_int)) {
+            batch_results = LocalMultiErase(batch);
+        } else {
+            batch_results = RPC_CALL_WRAPPER("_MultiErase", key_int, ret_type, batch);
+        }
+        if (whole) return batch_results;
+        if (results.empty()) results.resize(keys.size());
+        for (size_t i = 0; i < batch_results.size(); ++i) {
+            results[positions[key_int][i]] = std::move(batch_results[i]);
+        }
+    }
+    return results;
+}
+
+/**
+ * Moves up to MIGRATION_BATCH entries owned elsewhere in the next membership
+ * out of the current stripe, one _MultiPut per new owner. The stripe is only
+ * locked to copy the batch and to erase what arrived (see HandOver), so
+ * requests for those keys are answered here until their new owner has them.
+ * @return bool, false once every stripe has been scanned
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+bool unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::MigrateStep() {
+    journal_commit commit(oplog.get());
+    const partitioner *next = next_routing.load();
+    if (next == nullptr || migrate_stripe >= num_stripes) {
+        migrate_stripe = 0;
+        migrate_bucket = 0;
+        migrate_bucket_count = 0;
+        return false;
+    }
+    Stripe &stripe = stripes[migrate_stripe];
+    typedef std::pair<KeyType, MappedType> Entry;
+    std::vector<handover_batch<KeyType, Entry>> outgoing(next->NumServers());
+    {
+        boost::interprocess::scoped_lock<segment_mutex> lock(stripe.mutex);
+        if (stripe.map.bucket_count() != migrate_bucket_count) {
+            migrate_bucket_count = stripe.map.bucket_count();
+            migrate_bucket = 0;
+        }
+        std::vector<size_t> hashes;
+        while (migrate_bucket < migrate_bucket_count && hashes.size() < MIGRATION_BATCH) {
+            for (auto iterator = stripe.map.begin(migrate_bucket); iterator != stripe.map.end(migrate_bucket); ++iterator) {
+                size_t key_hash = keyHash(iterator->first);
+                uint16_t owner = next->GetServer(key_hash);
+                if (owner == my_server) continue;
+                outgoing[owner].keys.push_back(iterator->first);
+                outgoing[owner].hashes.push_back(key_hash);
+                outgoing[owner].entries.push_back(Entry(iterator->first, iterator->second));
+                hashes.push_back(key_hash);
+            }
+            migrate_bucket++;
+        }
+        StartHandover(hashes);
+    }
+    typedef std::pair<bool, MappedType> erase_type;
+    HandOver<erase_type>(stripe.mutex, outgoing,
+        [&stripe](KeyType &key, std::vector<Entry> &entries) {
+            typename MyHashMap::iterator iterator = stripe.map.find(key);
+            if (iterator != stripe.map.end()) entries.push_back(Entry(iterator->first, iterator->second));
+        },
+        [this, &stripe](KeyType &key) {
+            typename MyHashMap::iterator iterator = stripe.map.find(key);
+            if (iterator == stripe.map.end()) return;
+            size_occupied -= CalculateSize<KeyType>().GetSize(key) +
+                             CalculateSize<MappedType>().GetSize(iterator->second);
+            stripe.map.erase(iterator);
+            LogUpdate(keyHash(key), key, false, MappedType());
+        });
+    if (migrate_bucket >= migrate_bucket_count) {
+        migrate_stripe++;
+        migrate_bucket = 0;
+        migrate_bucket_count = 0;
+    }
+    return true;
+}
+
 template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
 void unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::open_shared_memory() {
-    std::pair<MyHashMap *, boost::interprocess::managed_mapped_file::size_type> res;
-    res = segment.find<MyHashMap>(name.c_str());
-    myHashMap = res.first;
+    std::pair<Stripe *, boost::interprocess::managed_mapped_file::size_type> res;
+    res = segment.find<Stripe>(name.c_str());
+    stripes = res.first;
+    /* The server decides the stripe count; clients follow what is in the segment. */
+    num_stripes = static_cast<uint16_t>(res.second);
+    OpenLeases();
+    replica_stripe = segment.find<Stripe>((name + "_replicas").c_str()).first;
 }
 
 template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
@@ -214,14 +774,38 @@ void unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::bind_funct
             std::function<std::pair<bool, MappedType>(KeyType &)> eraseFunc(
                     std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalErase, this,
                               std::placeholders::_1));
+            std::function<std::pair<uint64_t, std::pair<bool, MappedType>>(KeyType &)> leasedGetFunc(
+                    std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalLeasedGet, this,
+                              std::placeholders::_1));
+            std::function<bool(std::vector<ReplicaOp> &)> replicateFunc(
+                    std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalReplicate, this,
+                              std::placeholders::_1));
+            std::function<std::pair<bool, MappedType>(KeyType &)> replicaGetFunc(
+                    std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalReplicaGet, this,
+                              std::placeholders::_1));
             std::function<std::vector<std::pair<KeyType, MappedType>>(void)>
                     getAllDataInServerFunc(std::bind(
                     &unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalGetAllDataInServer,
                     this));
+            std::function<bool(std::vector<std::pair<KeyType, MappedType>> &)> multiPutFunc(
+                    std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalMultiPut, this,
+                              std::placeholders::_1));
+            std::function<std::vector<std::pair<bool, MappedType>>(std::vector<KeyType> &)> multiGetFunc(
+                    std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalMultiGet, this,
+                              std::placeholders::_1));
+            std::function<std::vector<std::pair<bool, MappedType>>(std::vector<KeyType> &)> multiEraseFunc(
+                    std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::LocalMultiErase, this,
+                              std::placeholders::_1));
             rpc->bind(func_prefix+"_Put", putFunc);
             rpc->bind(func_prefix+"_Get", getFunc);
             rpc->bind(func_prefix+"_Erase", eraseFunc);
+            rpc->bind(func_prefix+"_LeasedGet", leasedGetFunc);
+            rpc->bind(func_prefix+"_Replicate", replicateFunc);
+            rpc->bind(func_prefix+"_ReplicaGet", replicaGetFunc);
             rpc->bind(func_prefix+"_GetAllData", getAllDataInServerFunc);
+            rpc->bind(func_prefix+"_MultiPut", multiPutFunc);
+            rpc->bind(func_prefix+"_MultiGet", multiGetFunc);
+            rpc->bind(func_prefix+"_MultiErase", multiEraseFunc);
             break;
         }
 #endif
@@ -238,29 +822,123 @@ void unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::bind_funct
             std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalPut, this,
                       std::placeholders::_1, std::placeholders::_2,
                       std::placeholders::_3));
-        // std::function<void(const tl::request &, tl::bulk &, KeyType &)> putFunc(
-        //     std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalPut, this,
-        //               std::placeholders::_1, std::placeholders::_2,
-        //               std::placeholders::_3));
         std::function<void(const tl::request &, KeyType &)> getFunc(
             std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalGet, this,
                       std::placeholders::_1, std::placeholders::_2));
         std::function<void(const tl::request &, KeyType &)> eraseFunc(
             std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalErase, this,
                       std::placeholders::_1, std::placeholders::_2));
+        std::function<void(const tl::request &, KeyType &)> leasedGetFunc(
+            std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalLeasedGet, this,
+                      std::placeholders::_1, std::placeholders::_2));
+        std::function<void(const tl::request &, std::vector<ReplicaOp> &)> replicateFunc(
+            std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalReplicate, this,
+                      std::placeholders::_1, std::placeholders::_2));
+        std::function<void(const tl::request &, KeyType &)> replicaGetFunc(
+            std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalReplicaGet, this,
+                      std::placeholders::_1, std::placeholders::_2));
         std::function<void(const tl::request &)>
                 getAllDataInServerFunc(std::bind(
                     &unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalGetAllDataInServer,
                     this, std::placeholders::_1));
+        std::function<void(const tl::request &, std::vector<std::pair<KeyType, MappedType>> &)> multiPutFunc(
+            std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalMultiPut, this,
+                      std::placeholders::_1, std::placeholders::_2));
+        std::function<void(const tl::request &, std::vector<KeyType> &)> multiGetFunc(
+            std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalMultiGet, this,
+                      std::placeholders::_1, std::placeholders::_2));
+        std::function<void(const tl::request &, std::vector<KeyType> &)> multiEraseFunc(
+            std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalMultiErase, this,
+                      std::placeholders::_1, std::placeholders::_2));
 
         rpc->bind(func_prefix+"_Put", putFunc);
         rpc->bind(func_prefix+"_Get", getFunc);
         rpc->bind(func_prefix+"_Erase", eraseFunc);
+        rpc->bind(func_prefix+"_LeasedGet", leasedGetFunc);
+        rpc->bind(func_prefix+"_Replicate", replicateFunc);
+        rpc->bind(func_prefix+"_ReplicaGet", replicaGetFunc);
         rpc->bind(func_prefix+"_GetAllData", getAllDataInServerFunc);
+        rpc->bind(func_prefix+"_MultiPut", multiPutFunc);
+        rpc->bind(func_prefix+"_MultiGet", multiGetFunc);
+        rpc->bind(func_prefix+"_MultiErase", multiEraseFunc);
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+        std::function<void(const tl::request &, KeyType &, tl::bulk &)> bulkPutFunc(
+            std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalBulkPut, this,
+                      std::placeholders::_1, std::placeholders::_2,
+                      std::placeholders::_3));
+        std::function<void(const tl::request &, KeyType &, tl::bulk &)> bulkGetFunc(
+            std::bind(&unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::ThalliumLocalBulkGet, this,
+                      std::placeholders::_1, std::placeholders::_2,
+                      std::placeholders::_3));
+        rpc->bind(func_prefix+"_BulkPut", bulkPutFunc);
+        rpc->bind(func_prefix+"_BulkGet", bulkGetFunc);
+#endif
 	break;
     }
 #endif
     }
+    bind_membership_functions();
+    bind_checkpoint_functions();
+}
+
+/**
+ * Asynchronous Put. The request is sent immediately and the returned future
+ * yields the same result as Put; a key owned by the local server is stored
+ * before returning and the future is already ready.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+std::future<bool>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::AsyncPut(KeyType key, MappedType data) {
+    if (cache != nullptr) cache->Invalidate(key);
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalPut(key, data));
+    } else {
+        return RPC_CALL_WRAPPER_ASYNC("_Put", key_int, bool, key, data);
+    }
+}
+
+/**
+ * Asynchronous Get; see AsyncPut.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+std::future<std::pair<bool, MappedType>>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::AsyncGet(KeyType &key) {
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local(key_int)) {
+        return ReadyFuture(LocalGet(key));
+    } else {
+        return RPC_CALL_WRAPPER_ASYNC("_Get", key_int, ret_type, key);
+    }
+}
+
+/**
+ * Asynchronous Erase; see AsyncPut.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+std::future<std::pair<bool, MappedType>>
+unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::AsyncErase(KeyType &key) {
+    if (cache != nullptr) cache->Invalidate(key);
+    typedef std::pair<bool, MappedType> ret_type;
+    size_t key_hash = keyHash(key);
+    uint16_t key_int = GetServer(key_hash);
+    if (is_local_write(key_int)) {
+        return ReadyFuture(LocalErase(key));
+    } else {
+        return RPC_CALL_WRAPPER_ASYNC("_Erase", key_int, ret_type, key);
+    }
+}
+
+/**
+ * Hit and miss counts of the client cache; all zero if it is disabled.
+ */
+template<typename KeyType, typename MappedType, typename Hash, typename Allocator ,typename SharedType>
+cache_stats unordered_map<KeyType, MappedType, Hash, Allocator, SharedType>::CacheStats() {
+    if (cache == nullptr) return cache_stats();
+    return cache->Stats();
 }
 
 #endif  // INCLUDE_HCL_UNORDERED_MAP_UNORDERED_MAP_CPP_
@@ -26,6 +26,7 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include <atomic>
 
 #include <hcl/communication/rpc_lib.h>
 #include <hcl/communication/rpc_factory.h>
@@ -52,6 +53,8 @@
 #include <boost/functional/hash.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/interprocess/managed_mapped_file.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
 #include <hcl/common/container.h>
 
 /** Namespaces Uses **/
@@ -76,25 +79,114 @@ class unordered_map:public container {
                                                                 std::equal_to<KeyType>,
                                                                 ShmemAllocator>
                                                                 MyHashMap;
+    /* An update sent to replicas: the key and, if still present, its value. */
+    typedef std::pair<KeyType, std::pair<bool, MappedType>> ReplicaOp;
+    /**
+     * A lock stripe: an independently locked sub-table of this server's
+     * partition. Stripes are constructed as one array in the segment so that
+     * co-located clients find both the tables and their count by name.
+     */
+    struct Stripe {
+        segment_mutex mutex;
+        MyHashMap map;
+        explicit Stripe(const ShmemAllocator &allocator)
+                : mutex(HCL_CONF->READ_WRITE_LOCK), map(128, Hash(), std::equal_to<KeyType>(), allocator) {}
+    };
     /** Class attributes**/
     Hash keyHash;
-    MyHashMap *myHashMap;
+    Stripe *stripes;
+    uint16_t num_stripes;
+
+    /* Picks the stripe for a key. The hash is remixed first since its low bits
+     * already decided the server. */
+    inline uint16_t GetStripeIndex(size_t key_hash) {
+        uint64_t mixed = static_cast<uint64_t>(key_hash) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<uint16_t>((mixed >> 32) % num_stripes);
+    }
+    inline Stripe &GetStripe(size_t key_hash) {
+        return stripes[GetStripeIndex(key_hash)];
+    }
+    /* Migration cursor: the stripe being moved and the next bucket in it.
+     * The scan restarts a stripe if it was rehashed since the last batch. */
+    uint16_t migrate_stripe;
+    size_t migrate_bucket, migrate_bucket_count;
+    /* Remote Get results, when HCL_CONF->CLIENT_CACHE_SIZE is set. */
+    std::unique_ptr<client_cache<KeyType, MappedType, Hash>> cache;
+    /* Copies of keys owned by other servers, and the updates this server
+     * still sends to its replicas; both null without replication. */
+    Stripe *replica_stripe;
+    std::unique_ptr<replication_queue<ReplicaOp>> replication;
+    static const bool journal_supported = journal_codec<KeyType>::supported && journal_codec<MappedType>::supported;
+    /* Hands an applied update to the journal and the replicas. Called with
+     * the key's stripe locked, so both see updates in order. */
+    void LogUpdate(size_t key_hash, const KeyType &key, bool present, const MappedType &data) {
+        NoteWrite(key_hash);
+        if constexpr (journal_supported) {
+            if (oplog != nullptr) {
+                journal_record record(present ? JOURNAL_PUT : JOURNAL_ERASE);
+                record << key;
+                if (present) record << data;
+                Journal(record);
+            }
+        }
+        if (replication != nullptr)
+            QueueReplicas(replication.get(), key_hash, ReplicaOp(key, std::pair<bool, MappedType>(present, data)));
+    }
+    void ReplayRecord(journal_reader &record) override {
+        if constexpr (journal_supported) {
+            uint8_t op = record.Op();
+            KeyType key;
+            MappedType data;
+            record >> key;
+            if (op == JOURNAL_PUT) record >> data;
+            if (!record.Valid()) return;
+            if (op == JOURNAL_PUT) LocalPut(key, data);
+            else if (op == JOURNAL_ERASE) LocalErase(key);
+        }
+    }
+    /* Groups item indices by the destination server of key_of(item). */
+    template<typename Item, typename KeyOf>
+    void GroupByServer(std::vector<Item> &items, KeyOf key_of, std::vector<std::vector<size_t>> &positions);
+    /* Groups key indices by destination server. */
+    void GroupByServer(std::vector<KeyType> &keys, std::vector<std::vector<size_t>> &positions);
+    bool MigrateStep() override;
+    std::pair<bool, MappedType> CachedGet(uint16_t key_int, KeyType &key);
+    /* Allocations happen under the stripe locks, not the container mutex. */
+    std::vector<segment_mutex *> AllocationLocks() override {
+        std::vector<segment_mutex *> locks;
+        for (uint16_t i = 0; i < num_stripes; ++i) locks.push_back(&stripes[i].mutex);
+        if (replica_stripe != nullptr) locks.push_back(&replica_stripe->mutex);
+        return locks;
+    }
   public:
-    really_long size_occupied;
+    std::atomic<really_long> size_occupied;
     ~unordered_map();
 
-    explicit unordered_map(CharStruct name_ = std::string("TEST_UNORDERED_MAP"), uint16_t port=HCL_CONF->RPC_PORT);
-    MyHashMap* data(){
-        if(server_on_node || is_server) return myHashMap;
+    explicit unordered_map(CharStruct name_ = std::string("TEST_UNORDERED_MAP"), uint16_t port=HCL_CONF->RPC_PORT,
+                           uint16_t num_stripes_=HCL_CONF->NUM_STRIPES);
+    MyHashMap* data(uint16_t stripe = 0){
+        if(server_on_node || is_server) return &stripes[stripe].map;
         else nullptr;
     }
+    uint16_t NumStripes(){ return num_stripes; }
 
     void construct_shared_memory() override{
-        /* Construct unordered_map in the shared memory space. */
-        myHashMap = segment.construct<MyHashMap>(name.c_str())(
-                128, Hash(), std::equal_to<KeyType>(),
+        /* Construct the stripes of the unordered_map in the shared memory space.
+         * A reopened segment keeps the stripe count it was created with. */
+        stripes = segment.find_or_construct<Stripe>(name.c_str())[num_stripes](
                 segment.get_allocator<ValueType>());
-
+        num_stripes = static_cast<uint16_t>(segment.find<Stripe>(name.c_str()).second);
+        ConstructLeases();
+        if (replication_factor > 1) {
+            replica_stripe = segment.find_or_construct<Stripe>((name + "_replicas").c_str())(
+                    segment.get_allocator<ValueType>());
+            replication = std::make_unique<replication_queue<ReplicaOp>>(num_servers,
+                    [this](uint16_t server, std::vector<ReplicaOp> &ops) {
+                        return RPC_CALL_WRAPPER("_Replicate", server, bool, ops);
+                    });
+        }
+        ResetLocks();
+        OpenJournal(journal_supported);
     }
 
     void open_shared_memory() override;
@@ -103,37 +195,49 @@ class unordered_map:public container {
 
     bool LocalPut(KeyType &key, MappedType &data);
     std::pair<bool, MappedType> LocalGet(KeyType &key);
+    std::pair<uint64_t, std::pair<bool, MappedType>> LocalLeasedGet(KeyType &key);
     std::pair<bool, MappedType> LocalErase(KeyType &key);
     std::vector<std::pair<KeyType, MappedType>> LocalGetAllDataInServer();
+    bool LocalMultiPut(std::vector<std::pair<KeyType, MappedType>> &entries);
+    std::vector<std::pair<bool, MappedType>> LocalMultiGet(std::vector<KeyType> &keys);
+    std::vector<std::pair<bool, MappedType>> LocalMultiErase(std::vector<KeyType> &keys);
+    bool LocalReplicate(std::vector<ReplicaOp> &ops);
+    std::pair<bool, MappedType> LocalReplicaGet(KeyType &key);
 
 #if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
     THALLIUM_DEFINE(LocalPut, (key,data) ,KeyType &key, MappedType &data)
 
-    // void ThalliumLocalPut(const tl::request &thallium_req, tl::bulk &bulk_handle, KeyType key) {
-    //     MappedType data = rpc->prep_rdma_server<MappedType>(thallium_req.get_endpoint(), bulk_handle);
-    //     thallium_req.respond(LocalPut(key, data));
-    // }
-
-    // void ThalliumLocalGet(const tl::request &thallium_req, KeyType key) {
-    //     auto retpair = LocalGet(key);
-    //     if (!retpair.first) {
-    //         printf("error\n");
-    //     }
-    //     MappedType data = retpair.second;
-    //     tl::bulk bulk_handle = rpc->prep_rdma_client<MappedType>(data);
-    //     thallium_req.respond(bulk_handle);
-    // }
-
+#ifdef HCL_ENABLE_THALLIUM_ROCE
+    /* Bulk variants of Put and Get; see container::UseBulk. */
+    void ThalliumLocalBulkPut(const tl::request &thallium_req, KeyType &key, tl::bulk &bulk_handle);
+    void ThalliumLocalBulkGet(const tl::request &thallium_req, KeyType &key, tl::bulk &bulk_handle);
+#endif
     THALLIUM_DEFINE(LocalGet, (key), KeyType &key)
+    THALLIUM_DEFINE(LocalLeasedGet, (key), KeyType &key)
     THALLIUM_DEFINE(LocalErase, (key), KeyType &key)
     THALLIUM_DEFINE1(LocalGetAllDataInServer)
+    THALLIUM_DEFINE(LocalMultiPut, (entries), std::vector<std::pair<KeyType, MappedType>> &entries)
+    THALLIUM_DEFINE(LocalMultiGet, (keys), std::vector<KeyType> &keys)
+    THALLIUM_DEFINE(LocalMultiErase, (keys), std::vector<KeyType> &keys)
+    THALLIUM_DEFINE(LocalReplicate, (ops), std::vector<ReplicaOp> &ops)
+    THALLIUM_DEFINE(LocalReplicaGet, (key), KeyType &key)
 #endif
 
     bool Put(KeyType key, MappedType data);
     std::pair<bool, MappedType> Get(KeyType &key);
+    value_view<MappedType> GetView(KeyType &key);
+    template<typename Visitor>
+    bool WithValue(KeyType &key, Visitor visitor);
     std::pair<bool, MappedType> Erase(KeyType &key);
+    std::future<bool> AsyncPut(KeyType key, MappedType data);
+    std::future<std::pair<bool, MappedType>> AsyncGet(KeyType &key);
+    std::future<std::pair<bool, MappedType>> AsyncErase(KeyType &key);
     std::vector<std::pair<KeyType, MappedType>> GetAllData();
     std::vector<std::pair<KeyType, MappedType>> GetAllDataInServer();
+    bool MultiPut(std::vector<std::pair<KeyType, MappedType>> &entries);
+    std::vector<std::pair<bool, MappedType>> MultiGet(std::vector<KeyType> &keys);
+    std::vector<std::pair<bool, MappedType>> MultiErase(std::vector<KeyType> &keys);
+    cache_stats CacheStats();
 };
 
 #include "unordered_map.cpp"
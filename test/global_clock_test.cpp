@@ -10,7 +10,9 @@
  * have access to the file, you may request a copy from help@hdfgroup.org.   *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+#include <cassert>
 #include <hcl/clock/global_clock.h>
+#include <hcl/clock/hybrid_clock.h>
 #include <iostream>
 #include <mpi.h>
 
@@ -49,6 +51,45 @@ int main(int argc, char **argv) {
     MPI_Barrier(MPI_COMM_WORLD);
   }
 
+  clock->SyncClocks();
+  for (uint16_t i = 0; i < size; i++) {
+    if (i == rank) {
+      for (uint16_t j = 0; j < num_servers; j++) {
+        auto offset = clock->GetOffset(j);
+        std::cout << "Offset of server " << j << " from rank " << rank << ": " <<
+            offset.offset << " +- " << offset.uncertainty << std::endl;
+      }
+      std::cout << "Global time rank " << rank << ": " << clock->GetGlobalTime() <<
+          std::endl;
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+
   delete clock;
+
+  /* Pass a hybrid timestamp around the ranks: each receive has to stamp
+   * later than the send it follows, and every local stamp later than the
+   * one before it. */
+  hcl::hybrid_clock *hybrid = new hcl::hybrid_clock();
+  hybrid->SyncClocks();
+  HTime stamp = 0;
+  if (rank > 0) {
+    MPI_Recv(&stamp, 1, MPI_UINT64_T, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    HTime received = hybrid->Update(stamp);
+    assert(received > stamp);
+    stamp = received;
+  }
+  for (int i = 0; i < 1000; i++) {
+    HTime later = hybrid->Now();
+    assert(later > stamp);
+    stamp = later;
+  }
+  HTime next = hybrid->Now();
+  assert(next > stamp);
+  if (rank + 1 < size) MPI_Send(&next, 1, MPI_UINT64_T, rank + 1, 0, MPI_COMM_WORLD);
+  std::cout << "Hybrid time rank " << rank << ": " << hcl::hlc::Physical(next) <<
+      "." << hcl::hlc::Logical(next) << std::endl;
+  MPI_Barrier(MPI_COMM_WORLD);
+  delete hybrid;
   MPI_Finalize();
 }
@@ -0,0 +1,159 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
+#include <mpi.h>
+#include <iostream>
+#include <hcl/common/data_structures.h>
+#include <hcl/sequencer/global_sequence.h>
+
+/*
+ * Takes num_request single ids and num_request ranges of range_size ids from
+ * sequence, checks that each client sees its single ids and its ranges
+ * increase, and checks on rank 0 that no id was handed out twice by the same
+ * server, across all clients. Every server counts on its own, so ids are
+ * compared per server.
+ */
+void TakeIds(hcl::global_sequence *sequence, bool is_server, int my_server,
+             int num_request, uint64_t range_size, const char *label) {
+    int comm_size, my_rank;
+    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+    std::vector<uint64_t> ids;
+    if (!is_server) {
+        Timer timer = Timer();
+        timer.resumeTime();
+        for (int i = 0; i < num_request; i++) {
+            ids.push_back(sequence->GetNextSequence());
+            uint64_t first = sequence->GetNextSequenceRange(range_size);
+            for (uint64_t id = first; id < first + range_size; id++) ids.push_back(id);
+        }
+        timer.pauseTime();
+        /* Singles may come from a lease taken before the ranges, so the two
+         * only increase among themselves. */
+        uint64_t stride = range_size + 1;
+        for (size_t i = stride; i < ids.size(); i += stride) {
+            assert(ids[i] > ids[i - stride]);
+            assert(ids[i + 1] >= ids[i + 1 - stride] + range_size);
+        }
+        if (my_rank == 0) {
+            printf("%s sequence throughput: %f ids/ms\n", label, ids.size() / timer.getElapsedTime());
+        }
+    }
+    /* Tag every id with its server for the comparison on rank 0. */
+    std::vector<uint64_t> tagged;
+    for (uint64_t id : ids) {
+        tagged.push_back((uint64_t)my_server);
+        tagged.push_back(id);
+    }
+    int count = (int)tagged.size();
+    std::vector<int> counts(comm_size), displacements(comm_size);
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    int total = 0;
+    for (int rank = 0; rank < comm_size; rank++) {
+        displacements[rank] = total;
+        total += counts[rank];
+    }
+    std::vector<uint64_t> all(my_rank == 0 ? total : 0);
+    MPI_Gatherv(tagged.data(), count, MPI_UINT64_T, all.data(), counts.data(), displacements.data(),
+                MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (my_rank == 0) {
+        std::vector<std::pair<uint64_t, uint64_t>> handed_out;
+        for (int i = 0; i < total; i += 2) handed_out.emplace_back(all[i], all[i + 1]);
+        std::sort(handed_out.begin(), handed_out.end());
+        bool unique = std::adjacent_find(handed_out.begin(), handed_out.end()) == handed_out.end();
+        printf("%s sequence: %zu ids, %s\n", label, handed_out.size(), unique ? "all unique" : "DUPLICATES");
+        assert(unique);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+int main (int argc,char* argv[])
+{
+    int provided;
+    MPI_Init_thread(&argc,&argv, MPI_THREAD_MULTIPLE, &provided);
+    if (provided < MPI_THREAD_MULTIPLE) {
+        printf("Didn't receive appropriate MPI threading specification\n");
+        exit(EXIT_FAILURE);
+    }
+    int comm_size,my_rank;
+    MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
+    MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+    int ranks_per_server=comm_size,num_request=100;
+    bool debug=false;
+    bool server_on_node=false;
+    if(argc > 1)    ranks_per_server = atoi(argv[1]);
+    if(argc > 2)    num_request = atoi(argv[2]);
+    if(argc > 4)    server_on_node = (bool)atoi(argv[4]);
+    if(argc > 5)    debug = (bool)atoi(argv[5]);
+
+    int len;
+    char processor_name[MPI_MAX_PROCESSOR_NAME];
+    MPI_Get_processor_name(processor_name, &len);
+    if (debug) {
+        printf("%s/%d: %d\n", processor_name, my_rank, getpid());
+    }
+
+    if(debug && my_rank==0){
+        printf("%d ready for attach\n", comm_size);
+        fflush(stdout);
+        getchar();
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    bool is_server=(my_rank+1) % ranks_per_server == 0;
+    int my_server=my_rank / ranks_per_server;
+    int num_servers=comm_size/ranks_per_server;
+
+    printf("rank %d, is_server %d, my_server %d, num_servers %d\n",my_rank,is_server,my_server,num_servers);
+
+    HCL_CONF->IS_SERVER = is_server;
+    HCL_CONF->MY_SERVER = my_server;
+    HCL_CONF->NUM_SERVERS = num_servers;
+    HCL_CONF->SERVER_ON_NODE = server_on_node || is_server;
+    HCL_CONF->SERVER_LIST_PATH = "./server_list";
+
+    /* Every id straight from the counter. */
+    hcl::global_sequence *sequence;
+    if (is_server) {
+        sequence = new hcl::global_sequence("TEST_GLOBAL_SEQUENCE", HCL_CONF->RPC_PORT, 0);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (!is_server) {
+        sequence = new hcl::global_sequence("TEST_GLOBAL_SEQUENCE", HCL_CONF->RPC_PORT, 0);
+    }
+    TakeIds(sequence, is_server, my_server, num_request, 8, "unleased");
+    delete(sequence);
+
+    /* Clients without a server on their node take single ids from leases,
+     * while ranges still come from the counter. */
+    HCL_CONF->SERVER_ON_NODE = is_server;
+    hcl::global_sequence *leased_sequence;
+    if (is_server) {
+        leased_sequence = new hcl::global_sequence("TEST_GLOBAL_SEQUENCE_LEASED", HCL_CONF->RPC_PORT, 16);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (!is_server) {
+        leased_sequence = new hcl::global_sequence("TEST_GLOBAL_SEQUENCE_LEASED", HCL_CONF->RPC_PORT, 16);
+    }
+    TakeIds(leased_sequence, is_server, my_server, num_request, 8, "leased");
+    delete(leased_sequence);
+    HCL_CONF->SERVER_ON_NODE = server_on_node || is_server;
+
+    MPI_Finalize();
+    exit(EXIT_SUCCESS);
+}
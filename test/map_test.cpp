@@ -20,6 +20,7 @@
 #include <signal.h>
 #include <execinfo.h>
 #include <chrono>
+#include <vector>
 #include <map>
 #include <hcl/common/data_structures.h>
 #include <hcl/map/map.h>
@@ -133,6 +134,7 @@ int main (int argc,char* argv[])
     HCL_CONF->NUM_SERVERS = num_servers;
     HCL_CONF->SERVER_ON_NODE = server_on_node || is_server;
     HCL_CONF->SERVER_LIST_PATH = "./server_list";
+    HCL_CONF->PARTITIONER = MODULO_PARTITIONER;
 
     hcl::map<KeyType,std::array<int, array_size>> *map;
     if (is_server) {
@@ -277,6 +279,54 @@ int main (int argc,char* argv[])
             printf("remote map throughput (put): %f\n",remote_put_tp_result);
             printf("remote map throughput (get): %f\n",remote_get_tp_result);
         }
+
+        MPI_Barrier(client_comm);
+
+        /*Batched map test: one MultiPut/MultiGet covering keys on every server*/
+        std::vector<std::pair<KeyType, std::array<int, array_size>>> batch_entries;
+        std::vector<KeyType> batch_keys;
+        for(int i=0;i<num_request;i++){
+            auto key=KeyType((size_t)my_rank*num_request+i);
+            batch_entries.emplace_back(key, my_vals);
+            batch_keys.push_back(key);
+        }
+        Timer batch_put_timer=Timer();
+        batch_put_timer.resumeTime();
+        bool batch_put_result = map->MultiPut(batch_entries);
+        batch_put_timer.pauseTime();
+        assert(batch_put_result);
+
+        Timer batch_get_timer=Timer();
+        batch_get_timer.resumeTime();
+        auto batch_results = map->MultiGet(batch_keys);
+        batch_get_timer.pauseTime();
+        assert(batch_results.size() == batch_keys.size());
+        for(auto &result : batch_results) assert(result.first);
+
+        auto erase_results = map->MultiErase(batch_keys);
+        for(auto &result : erase_results) assert(result.first);
+
+        double batch_put_throughput=num_request/batch_put_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+        double batch_get_throughput=num_request/batch_get_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+
+        double batch_put_tp_result, batch_get_tp_result;
+        if (client_comm_size > 1) {
+            MPI_Reduce(&batch_put_throughput, &batch_put_tp_result, 1,
+                       MPI_DOUBLE, MPI_SUM, 0, client_comm);
+            batch_put_tp_result /= client_comm_size;
+            MPI_Reduce(&batch_get_throughput, &batch_get_tp_result, 1,
+                       MPI_DOUBLE, MPI_SUM, 0, client_comm);
+            batch_get_tp_result /= client_comm_size;
+        }
+        else {
+            batch_put_tp_result = batch_put_throughput;
+            batch_get_tp_result = batch_get_throughput;
+        }
+
+        if(my_rank == 0) {
+            printf("batched map throughput (put): %f\n",batch_put_tp_result);
+            printf("batched map throughput (get): %f\n",batch_get_tp_result);
+        }
     }
     MPI_Barrier(MPI_COMM_WORLD);
     delete(map);
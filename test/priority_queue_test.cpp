@@ -282,6 +282,121 @@ int main (int argc,char* argv[])
             printf("remote priority_queue throughput (put): %f\n",remote_put_tp_result);
             printf("remote priority_queue throughput (get): %f\n",remote_get_tp_result);
         }
+
+        MPI_Barrier(client_comm);
+
+        /* The same requests in batches: one call and one lock per batch. */
+        const int batch_size = 64;
+        Timer remote_push_n_timer=Timer();
+        for(int i=0;i<num_request;i+=batch_size){
+            std::vector<KeyType> batch;
+            for(int j=i;j<num_request && j<i+batch_size;j++) batch.push_back(KeyType(j));
+            remote_push_n_timer.resumeTime();
+            priority_queue->PushN(batch, my_server_remote_key);
+            remote_push_n_timer.pauseTime();
+        }
+        MPI_Barrier(client_comm);
+        Timer remote_pop_n_timer=Timer();
+        size_t popped_n=0;
+        for(int i=0;i<num_request;i+=batch_size){
+            remote_pop_n_timer.resumeTime();
+            auto batch = priority_queue->PopN(batch_size, my_server_remote_key);
+            remote_pop_n_timer.pauseTime();
+            popped_n += batch.size();
+        }
+        double remote_push_n_throughput=num_request/remote_push_n_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+        double remote_pop_n_throughput=num_request/remote_pop_n_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+        if(my_rank == 0) {
+            printf("remote priority_queue throughput (batched put): %f\n", remote_push_n_throughput);
+            printf("remote priority_queue throughput (batched get): %f, popped %zu\n", remote_pop_n_throughput, popped_n);
+        }
+
+        MPI_Barrier(client_comm);
+
+        /* Global top-k: every server answers with its own top k in the same round trip. */
+        for(int i=0;i<num_request;i++){
+            auto key=KeyType(i);
+            priority_queue->Push(key, my_server_remote_key);
+        }
+        MPI_Barrier(client_comm);
+        const uint32_t top_k = 16;
+        Timer global_top_k_timer=Timer();
+        size_t peeked=0;
+        for(int i=0;i<num_request;i+=batch_size){
+            global_top_k_timer.resumeTime();
+            auto top = priority_queue->GlobalTopK(top_k);
+            global_top_k_timer.pauseTime();
+            peeked += top.size();
+        }
+        Timer global_pop_timer=Timer();
+        int global_popped=0;
+        for(int i=0;i<num_request;i++){
+            global_pop_timer.resumeTime();
+            auto result = priority_queue->GlobalPop();
+            global_pop_timer.pauseTime();
+            if (result.first) global_popped++;
+        }
+        if(my_rank == 0) {
+            printf("priority_queue global top-%u (ms per call): %f, peeked %zu\n", top_k,
+                   global_top_k_timer.getElapsedTime()/((num_request+batch_size-1)/batch_size), peeked);
+            printf("priority_queue global pop (ms per call): %f, popped %d of %d\n",
+                   global_pop_timer.getElapsedTime()/num_request, global_popped, num_request);
+        }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    {
+        /* Relaxed queue: four sub-queues per client of a server, popped concurrently. */
+        uint16_t sub_queues = 4 * std::max(ranks_per_server - 1, 1);
+        hcl::priority_queue<KeyType> *relaxed_queue;
+        if (is_server) {
+            relaxed_queue = new hcl::priority_queue<KeyType>("TEST_RELAXED_PRIORITY_QUEUE", HCL_CONF->RPC_PORT, sub_queues);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            relaxed_queue = new hcl::priority_queue<KeyType>("TEST_RELAXED_PRIORITY_QUEUE");
+            uint16_t my_server_key = my_server;
+            for(int i=0;i<num_request;i++){
+                auto key=KeyType((size_t)my_rank*num_request+i);
+                relaxed_queue->Push(key, my_server_key);
+            }
+            MPI_Barrier(client_comm);
+            Timer relaxed_pop_timer=Timer();
+            for(int i=0;i<num_request;i++){
+                relaxed_pop_timer.resumeTime();
+                relaxed_queue->Pop(my_server_key);
+                relaxed_pop_timer.pauseTime();
+            }
+            double relaxed_pop_throughput=num_request/relaxed_pop_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+            MPI_Barrier(client_comm);
+            /* Rank error of a lone consumer: how many better elements were still queued at each pop. */
+            double mean_rank_error = 0;
+            size_t max_rank_error = 0;
+            if (my_rank == 0) {
+                for(int i=0;i<num_request;i++){
+                    auto key=KeyType(i);
+                    relaxed_queue->Push(key, my_server_key);
+                }
+                std::vector<int> queued(num_request+1, 0);
+                for(int i=1;i<=num_request;i++){
+                    for(int j=i;j<=num_request;j+=j&-j) queued[j]++;
+                }
+                for(int popped=0;popped<num_request;popped++){
+                    auto result = relaxed_queue->Pop(my_server_key);
+                    if (!result.first) break;
+                    size_t not_above = 0;
+                    for(int j=result.second.a+1;j>0;j-=j&-j) not_above += queued[j];
+                    size_t rank_error = (num_request - popped) - not_above;
+                    mean_rank_error += rank_error;
+                    max_rank_error = std::max(max_rank_error, rank_error);
+                    for(int j=result.second.a+1;j<=num_request;j+=j&-j) queued[j]--;
+                }
+                mean_rank_error /= num_request;
+                printf("relaxed priority_queue throughput (get, %u sub-queues): %f\n", sub_queues, relaxed_pop_throughput);
+                printf("relaxed priority_queue rank error: mean %f, max %zu\n", mean_rank_error, max_rank_error);
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        delete(relaxed_queue);
     }
     MPI_Barrier(MPI_COMM_WORLD);
     delete(priority_queue);
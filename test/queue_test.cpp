@@ -13,6 +13,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <cassert>
 #include <functional>
 #include <utility>
 #include <mpi.h>
@@ -21,6 +22,7 @@
 #include <execinfo.h>
 #include <chrono>
 #include <queue>
+#include <thread>
 #include <hcl/common/data_structures.h>
 #include <hcl/queue/queue.h>
 
@@ -282,6 +284,123 @@ int main (int argc,char* argv[])
             printf("remote queue throughput (put): %f\n",remote_put_tp_result);
             printf("remote queue throughput (get): %f\n",remote_get_tp_result);
         }
+
+        MPI_Barrier(client_comm);
+
+        /* Blocking pops: elements are already there, then the queue is empty and the pop times out. */
+        for(int i=0;i<num_request;i++){
+            size_t val = my_server+1;
+            auto key=KeyType(val);
+            queue->Push(key, my_server_remote_key);
+        }
+        MPI_Barrier(client_comm);
+        Timer remote_blocking_pop_timer=Timer();
+        int popped=0;
+        for(int i=0;i<num_request;i++){
+            remote_blocking_pop_timer.resumeTime();
+            auto result = queue->BlockingPop(my_server_remote_key, 1000);
+            remote_blocking_pop_timer.pauseTime();
+            if (result.first) popped++;
+        }
+        double remote_blocking_pop_throughput=num_request/remote_blocking_pop_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+        MPI_Barrier(client_comm);
+        Timer blocking_pop_timeout_timer=Timer();
+        blocking_pop_timeout_timer.resumeTime();
+        auto timed_out = queue->BlockingPop(my_server_remote_key, 10);
+        blocking_pop_timeout_timer.pauseTime();
+        if(my_rank == 0) {
+            printf("remote queue throughput (blocking get): %f\n", remote_blocking_pop_throughput);
+            printf("remote queue blocking get popped %d of %d\n", popped, num_request);
+            printf("remote queue blocking get on empty queue (ms): %f, found %d\n",
+                   blocking_pop_timeout_timer.getElapsedTime(), timed_out.first);
+        }
+
+        MPI_Barrier(client_comm);
+
+        /* The same requests in batches: one call and one lock per batch. */
+        const int batch_size = 64;
+        Timer remote_push_n_timer=Timer();
+        for(int i=0;i<num_request;i+=batch_size){
+            std::vector<KeyType> batch;
+            for(int j=i;j<num_request && j<i+batch_size;j++) batch.push_back(KeyType(j));
+            remote_push_n_timer.resumeTime();
+            queue->PushN(batch, my_server_remote_key);
+            remote_push_n_timer.pauseTime();
+        }
+        MPI_Barrier(client_comm);
+        Timer remote_pop_n_timer=Timer();
+        size_t popped_n=0;
+        for(int i=0;i<num_request;i+=batch_size){
+            remote_pop_n_timer.resumeTime();
+            auto batch = queue->PopN(batch_size, my_server_remote_key);
+            remote_pop_n_timer.pauseTime();
+            popped_n += batch.size();
+        }
+        double remote_push_n_throughput=num_request/remote_push_n_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+        double remote_pop_n_throughput=num_request/remote_pop_n_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+        if(my_rank == 0) {
+            printf("remote queue throughput (batched put): %f\n", remote_push_n_throughput);
+            printf("remote queue throughput (batched get): %f, popped %zu\n", remote_pop_n_throughput, popped_n);
+        }
+
+        MPI_Barrier(client_comm);
+
+        /* Work stealing: all the work sits on the next server, so pops steal batches of it. */
+        for(int i=0;i<num_request;i++){
+            size_t val = my_server+1;
+            auto key=KeyType(val);
+            queue->Push(key, my_server_remote_key);
+        }
+        MPI_Barrier(client_comm);
+        Timer stealing_pop_timer=Timer();
+        int stolen=0;
+        std::vector<KeyType> unplaced;
+        for(int i=0;i<num_request;i++){
+            stealing_pop_timer.resumeTime();
+            auto result = queue->StealingPop(unplaced);
+            stealing_pop_timer.pauseTime();
+            if (result.first) stolen++;
+        }
+        assert(unplaced.empty());
+        double stealing_pop_throughput=num_request/stealing_pop_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+        if(my_rank == 0) {
+            printf("queue throughput (stealing get): %f, popped %d of %d\n", stealing_pop_throughput, stolen, num_request);
+        }
+
+        MPI_Barrier(client_comm);
+
+        /* Parked pop: the first client waits on an empty remote queue before the last client pushes to it. */
+        int client_rank;
+        MPI_Comm_rank(client_comm, &client_rank);
+        bool is_consumer = client_rank == 0, is_producer = client_rank == client_comm_size - 1;
+        uint16_t parked_key = my_server_remote_key;
+        MPI_Bcast(&parked_key, 1, MPI_UINT16_T, 0, client_comm);
+        const uint32_t parked_timeout_ms = 5000;
+        KeyType parked_value(num_request + 1);
+        std::pair<bool, KeyType> parked_result(false, KeyType());
+        std::thread consumer;
+        Timer parked_pop_timer=Timer();
+        if (is_consumer) {
+            while (queue->Pop(parked_key).first) {}
+            parked_pop_timer.resumeTime();
+            consumer = std::thread([&]() {
+                parked_result = queue->BlockingPop(parked_key, parked_timeout_ms);
+                parked_pop_timer.pauseTime();
+            });
+            /* Give the pop time to reach the server and park there. */
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        MPI_Barrier(client_comm);
+        if (is_producer) {
+            queue->Push(parked_value, parked_key);
+        }
+        if (is_consumer) {
+            consumer.join();
+            assert(parked_result.first);
+            assert(parked_result.second == parked_value);
+            assert(parked_pop_timer.getElapsedTime() < parked_timeout_ms);
+            printf("remote queue blocking get woken by a push after (ms): %f\n", parked_pop_timer.getElapsedTime());
+        }
     }
     MPI_Barrier(MPI_COMM_WORLD);
     delete(queue);
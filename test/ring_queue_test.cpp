@@ -0,0 +1,316 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <utility>
+#include <mpi.h>
+#include <iostream>
+#include <signal.h>
+#include <execinfo.h>
+#include <chrono>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <hcl/common/data_structures.h>
+#include <hcl/ring_queue/ring_queue.h>
+
+/* Ring elements are copied byte by byte, so KeyType stays trivially copyable. */
+struct KeyType{
+    size_t a;
+    KeyType():a(0){}
+    KeyType(size_t a_):a(a_){}
+#ifdef HCL_ENABLE_RPCLIB
+    MSGPACK_DEFINE(a);
+#endif
+    /* equal operator for comparing two Matrix. */
+    bool operator==(const KeyType &o) const {
+        return a == o.a;
+    }
+    bool operator<(const KeyType &o) const {
+        return a < o.a;
+    }
+    bool operator>(const KeyType &o) const {
+        return a > o.a;
+    }
+    bool Contains(const KeyType &o) const {
+        return a==o.a;
+    }
+};
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+template<typename A>
+void serialize(A &ar, KeyType &a) {
+    ar & a.a;
+}
+#endif
+/* Bigger than RING_INLINE_SIZE, so it is kept outside the slot. */
+struct LargeType{
+    uint64_t a;
+    uint64_t copies[15];
+    LargeType():a(0),copies(){}
+    LargeType(uint64_t a_):a(a_){
+        std::fill(copies, copies + 15, a_);
+    }
+#ifdef HCL_ENABLE_RPCLIB
+    MSGPACK_DEFINE(a, copies);
+#endif
+    bool Intact() const {
+        return std::all_of(copies, copies + 15, [this](uint64_t copy) { return copy == a; });
+    }
+};
+static_assert(sizeof(LargeType) > RING_INLINE_SIZE, "LargeType must take the out-of-line path");
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+template<typename A>
+void serialize(A &ar, LargeType &a) {
+    ar & a.a;
+    for (auto &copy : a.copies) ar & copy;
+}
+#endif
+namespace std {
+    template<>
+    struct hash<KeyType> {
+        size_t operator()(const KeyType &k) const {
+            return k.a;
+        }
+    };
+}
+
+
+int main (int argc,char* argv[])
+{
+    int provided;
+    MPI_Init_thread(&argc,&argv, MPI_THREAD_MULTIPLE, &provided);
+    if (provided < MPI_THREAD_MULTIPLE) {
+        printf("Didn't receive appropriate MPI threading specification\n");
+        exit(EXIT_FAILURE);
+    }
+    int comm_size,my_rank;
+    MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
+    MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+    int ranks_per_server=comm_size,num_request=100;
+    long size_of_request=1000;
+    bool debug=false;
+    bool server_on_node=false;
+    if(argc > 1)    ranks_per_server = atoi(argv[1]);
+    if(argc > 2)    num_request = atoi(argv[2]);
+    if(argc > 3)    size_of_request = (long)atol(argv[3]);
+    if(argc > 4)    server_on_node = (bool)atoi(argv[4]);
+    if(argc > 5)    debug = (bool)atoi(argv[5]);
+
+   /* if(comm_size/ranks_per_server < 2){
+        perror("comm_size/ranks_per_server should be atleast 2 for this test\n");
+        exit(-1);
+    }*/
+    int len;
+    char processor_name[MPI_MAX_PROCESSOR_NAME];
+    MPI_Get_processor_name(processor_name, &len);
+    if (debug) {
+        printf("%s/%d: %d\n", processor_name, my_rank, getpid());
+    }
+    
+    if(debug && my_rank==0){
+        printf("%d ready for attach\n", comm_size);
+        fflush(stdout);
+        getchar();
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    bool is_server=(my_rank+1) % ranks_per_server == 0;
+    int my_server=my_rank / ranks_per_server;
+    int num_servers=comm_size/ranks_per_server;
+
+    // The following is used to switch to 40g network on Ares.
+    // This is necessary when we use RoCE on Ares.
+    std::string proc_name = std::string(processor_name);
+    /*int split_loc = proc_name.find('.');
+    std::string node_name = proc_name.substr(0, split_loc);
+    std::string extra_info = proc_name.substr(split_loc+1, string::npos);
+    proc_name = node_name + "-40g." + extra_info;*/
+
+    size_t size_of_elem = sizeof(KeyType);
+
+    printf("rank %d, is_server %d, my_server %d, num_servers %d\n",my_rank,is_server,my_server,num_servers);
+
+    HCL_CONF->IS_SERVER = is_server;
+    HCL_CONF->MY_SERVER = my_server;
+    HCL_CONF->NUM_SERVERS = num_servers;
+    HCL_CONF->SERVER_ON_NODE = server_on_node || is_server;
+    HCL_CONF->SERVER_LIST_PATH = "./server_list";
+
+    /* Large enough to hold every request of all clients of a server. */
+    uint64_t capacity = (uint64_t)num_request * ranks_per_server;
+    /* Small enough that producers wrap around and find it full. */
+    const uint64_t large_capacity = 64;
+    hcl::ring_queue<KeyType> *queue;
+    hcl::ring_queue<LargeType> *large_queue;
+    if (is_server) {
+        queue = new hcl::ring_queue<KeyType>("TEST_RING_QUEUE", HCL_CONF->RPC_PORT, capacity);
+        large_queue = new hcl::ring_queue<LargeType>("TEST_RING_QUEUE_LARGE", HCL_CONF->RPC_PORT, large_capacity);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (!is_server) {
+        queue = new hcl::ring_queue<KeyType>("TEST_RING_QUEUE", HCL_CONF->RPC_PORT, capacity);
+        large_queue = new hcl::ring_queue<LargeType>("TEST_RING_QUEUE_LARGE", HCL_CONF->RPC_PORT, large_capacity);
+    }
+
+    std::queue<KeyType> lqueue=std::queue<KeyType>();
+
+    MPI_Comm client_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, !is_server, my_rank, &client_comm);
+    int client_comm_size;
+    MPI_Comm_size(client_comm, &client_comm_size);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (!is_server) {
+        Timer llocal_queue_timer=Timer();
+        /*Local std::queue test*/
+        for(int i=0;i<num_request;i++){
+            llocal_queue_timer.resumeTime();
+            lqueue.push(KeyType(i));
+            llocal_queue_timer.pauseTime();
+        }
+        double llocal_queue_throughput=num_request/llocal_queue_timer.getElapsedTime()*1000*size_of_elem/1024/1024;
+
+        Timer llocal_get_queue_timer=Timer();
+        for(int i=0;i<num_request;i++){
+            llocal_get_queue_timer.resumeTime();
+            auto result = lqueue.front();
+            lqueue.pop();
+            llocal_get_queue_timer.pauseTime();
+        }
+        double llocal_get_queue_throughput=num_request/llocal_get_queue_timer.getElapsedTime()*1000*size_of_elem/1024/1024;
+
+        if (my_rank == 0) {
+            printf("llocal_ring_queue_throughput put: %f\n",llocal_queue_throughput);
+            printf("llocal_ring_queue_throughput get: %f\n",llocal_get_queue_throughput);
+        }
+        MPI_Barrier(client_comm);
+
+        Timer local_queue_timer=Timer();
+        uint16_t my_server_key = my_server % num_servers;
+        /*Local ring queue test*/
+        int pushed=0;
+        for(int i=0;i<num_request;i++){
+            auto key=KeyType(i);
+            local_queue_timer.resumeTime();
+            if (queue->Push(key, my_server_key)) pushed++;
+            local_queue_timer.pauseTime();
+        }
+        double local_queue_throughput=num_request/local_queue_timer.getElapsedTime()*1000*size_of_elem/1024/1024;
+        MPI_Barrier(client_comm);
+
+        Timer local_get_queue_timer=Timer();
+        int popped=0;
+        for(int i=0;i<num_request;i++){
+            local_get_queue_timer.resumeTime();
+            auto result = queue->Pop(my_server_key);
+            local_get_queue_timer.pauseTime();
+            if (result.first) popped++;
+        }
+        double local_get_queue_throughput=num_request/local_get_queue_timer.getElapsedTime()*1000*size_of_elem/1024/1024;
+
+        double local_put_tp_result, local_get_tp_result;
+        int total_pushed, total_popped;
+        MPI_Reduce(&local_queue_throughput, &local_put_tp_result, 1, MPI_DOUBLE, MPI_SUM, 0, client_comm);
+        MPI_Reduce(&local_get_queue_throughput, &local_get_tp_result, 1, MPI_DOUBLE, MPI_SUM, 0, client_comm);
+        MPI_Reduce(&pushed, &total_pushed, 1, MPI_INT, MPI_SUM, 0, client_comm);
+        MPI_Reduce(&popped, &total_popped, 1, MPI_INT, MPI_SUM, 0, client_comm);
+        if (my_rank==0) {
+            printf("local_ring_queue_throughput put: %f\n", local_put_tp_result / client_comm_size);
+            printf("local_ring_queue_throughput get: %f\n", local_get_tp_result / client_comm_size);
+            printf("local_ring_queue pushed %d popped %d\n", total_pushed, total_popped);
+        }
+
+        MPI_Barrier(client_comm);
+
+        Timer remote_queue_timer=Timer();
+        /*Remote ring queue test*/
+        uint16_t my_server_remote_key = (my_server + 1) % num_servers;
+        for(int i=0;i<num_request;i++){
+            auto key=KeyType(i);
+            remote_queue_timer.resumeTime();
+            queue->Push(key, my_server_remote_key);
+            remote_queue_timer.pauseTime();
+        }
+        double remote_queue_throughput=num_request/remote_queue_timer.getElapsedTime()*1000*size_of_elem/1024/1024;
+
+        MPI_Barrier(client_comm);
+
+        Timer remote_get_queue_timer=Timer();
+        for(int i=0;i<num_request;i++){
+            remote_get_queue_timer.resumeTime();
+            queue->Pop(my_server_remote_key);
+            remote_get_queue_timer.pauseTime();
+        }
+        double remote_get_queue_throughput=num_request/remote_get_queue_timer.getElapsedTime()*1000*size_of_elem/1024/1024;
+
+        double remote_put_tp_result, remote_get_tp_result;
+        MPI_Reduce(&remote_queue_throughput, &remote_put_tp_result, 1, MPI_DOUBLE, MPI_SUM, 0, client_comm);
+        MPI_Reduce(&remote_get_queue_throughput, &remote_get_tp_result, 1, MPI_DOUBLE, MPI_SUM, 0, client_comm);
+        if(my_rank == 0) {
+            printf("remote ring queue throughput (put): %f\n",remote_put_tp_result / client_comm_size);
+            printf("remote ring queue throughput (get): %f\n",remote_get_tp_result / client_comm_size);
+        }
+
+        MPI_Barrier(client_comm);
+
+        /* Many producers and consumers of large elements on one ring: each
+         * client pushes num_request distinct values and pops as many, and
+         * together the clients must pop every value exactly once. */
+        int client_rank;
+        MPI_Comm_rank(client_comm, &client_rank);
+        const int threads_per_side = 2;
+        std::atomic<int> left_to_pop(num_request);
+        std::vector<std::vector<uint64_t>> popped_by(threads_per_side);
+        std::vector<std::thread> workers;
+        Timer mpmc_timer=Timer();
+        mpmc_timer.resumeTime();
+        for (int t = 0; t < threads_per_side; t++) {
+            workers.emplace_back([&, t]() {
+                for (int i = t; i < num_request; i += threads_per_side) {
+                    LargeType value((uint64_t)client_rank * num_request + i);
+                    while (!large_queue->Push(value, my_server_key)) std::this_thread::yield();
+                }
+            });
+            workers.emplace_back([&, t]() {
+                while (left_to_pop.fetch_sub(1) > 0) {
+                    std::pair<bool, LargeType> result;
+                    while (!(result = large_queue->Pop(my_server_key)).first) std::this_thread::yield();
+                    assert(result.second.Intact());
+                    popped_by[t].push_back(result.second.a);
+                }
+            });
+        }
+        for (auto &worker : workers) worker.join();
+        mpmc_timer.pauseTime();
+        std::vector<uint64_t> popped_values;
+        for (auto &values : popped_by) popped_values.insert(popped_values.end(), values.begin(), values.end());
+        assert(popped_values.size() == (size_t)num_request);
+        std::vector<uint64_t> all_popped(client_rank == 0 ? (size_t)num_request * client_comm_size : 0);
+        MPI_Gather(popped_values.data(), num_request, MPI_UINT64_T,
+                   all_popped.data(), num_request, MPI_UINT64_T, 0, client_comm);
+        if (client_rank == 0) {
+            std::sort(all_popped.begin(), all_popped.end());
+            for (size_t i = 0; i < all_popped.size(); i++) assert(all_popped[i] == i);
+            printf("large ring queue MPMC: %zu values popped once each in %f ms\n",
+                   all_popped.size(), mpmc_timer.getElapsedTime());
+        }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    delete(large_queue);
+    delete(queue);
+    MPI_Finalize();
+    exit(EXIT_SUCCESS);
+}
@@ -139,6 +139,7 @@ int main (int argc,char* argv[])
     HCL_CONF->NUM_SERVERS = num_servers;
     HCL_CONF->SERVER_ON_NODE = server_on_node || is_server;
     HCL_CONF->SERVER_LIST_PATH = "./server_list";
+    HCL_CONF->PARTITIONER = MODULO_PARTITIONER;
 
     hcl::set<KeyType> *set;
     if (is_server) {
@@ -123,6 +123,7 @@ int main (int argc,char* argv[])
     HCL_CONF->NUM_SERVERS = num_servers;
     HCL_CONF->SERVER_ON_NODE = server_on_node || is_server;
     HCL_CONF->SERVER_LIST_PATH = "./server_list";
+    HCL_CONF->PARTITIONER = MODULO_PARTITIONER;
 
     typedef boost::interprocess::allocator<char, boost::interprocess::managed_mapped_file::segment_manager> CharAllocator;
     typedef bip::basic_string<char, std::char_traits<char>, CharAllocator> MappedUnitString;
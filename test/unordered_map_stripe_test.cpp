@@ -0,0 +1,197 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <utility>
+#include <mpi.h>
+#include <iostream>
+#include <signal.h>
+#include <execinfo.h>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <hcl/common/data_structures.h>
+#include <hcl/unordered_map/unordered_map.h>
+
+struct KeyType{
+    size_t a;
+    KeyType():a(0){}
+    KeyType(size_t a_):a(a_){}
+#ifdef HCL_ENABLE_RPCLIB
+    MSGPACK_DEFINE(a);
+#endif
+    /* equal operator for comparing two Matrix. */
+    bool operator==(const KeyType &o) const {
+        return a == o.a;
+    }
+    KeyType& operator=( const KeyType& other ) {
+        a = other.a;
+        return *this;
+    }
+    bool operator<(const KeyType &o) const {
+        return a < o.a;
+    }
+    bool operator>(const KeyType &o) const {
+        return a > o.a;
+    }
+    bool Contains(const KeyType &o) const {
+        return a==o.a;
+    }
+
+};
+#if defined(HCL_ENABLE_THALLIUM_TCP) || defined(HCL_ENABLE_THALLIUM_ROCE)
+template<typename A>
+void serialize(A &ar, KeyType &a) {
+    ar & a.a;
+}
+#endif
+namespace std {
+    template<>
+    struct hash<KeyType> {
+        size_t operator()(const KeyType &k) const {
+            return k.a;
+        }
+    };
+}
+
+/*
+ * Mixed read/write load (90% Get, 10% Put) from several threads of every
+ * client, first against its own server and then against the next one,
+ * repeated for 1, 4 and 16 lock stripes.
+ */
+int main (int argc,char* argv[])
+{
+    int provided;
+    MPI_Init_thread(&argc,&argv, MPI_THREAD_MULTIPLE, &provided);
+    if (provided < MPI_THREAD_MULTIPLE) {
+        printf("Didn't receive appropriate MPI threading specification\n");
+        exit(EXIT_FAILURE);
+    }
+    int comm_size,my_rank;
+    MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
+    MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+    int ranks_per_server=comm_size,num_request=100;
+    bool debug=false;
+    bool server_on_node=false;
+    if(argc > 1)    ranks_per_server = atoi(argv[1]);
+    if(argc > 2)    num_request = atoi(argv[2]);
+    if(argc > 4)    server_on_node = (bool)atoi(argv[4]);
+    if(argc > 5)    debug = (bool)atoi(argv[5]);
+
+    int len;
+    char processor_name[MPI_MAX_PROCESSOR_NAME];
+    MPI_Get_processor_name(processor_name, &len);
+    if (debug) {
+        printf("%s/%d: %d\n", processor_name, my_rank, getpid());
+    }
+
+    if(debug && my_rank==0){
+        printf("%d ready for attach\n", comm_size);
+        fflush(stdout);
+        getchar();
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    bool is_server=(my_rank+1) % ranks_per_server == 0;
+    int my_server=my_rank / ranks_per_server;
+    int num_servers=comm_size/ranks_per_server;
+    const int num_threads=4;
+    const int num_keys=1024;
+
+    printf("rank %d, is_server %d, my_server %d, num_servers %d\n",my_rank,is_server,my_server,num_servers);
+
+    HCL_CONF->IS_SERVER = is_server;
+    HCL_CONF->MY_SERVER = my_server;
+    HCL_CONF->NUM_SERVERS = num_servers;
+    HCL_CONF->SERVER_ON_NODE = server_on_node || is_server;
+    HCL_CONF->SERVER_LIST_PATH = "./server_list";
+    HCL_CONF->PARTITIONER = MODULO_PARTITIONER;
+    /* One handler per client thread, so remote requests contend on the stripes rather than on the handlers. */
+    HCL_CONF->RPC_THREADS = std::max<uint16_t>(HCL_CONF->RPC_THREADS, num_threads * (ranks_per_server - 1));
+
+    MPI_Comm client_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, !is_server, my_rank, &client_comm);
+    int client_comm_size;
+    MPI_Comm_size(client_comm, &client_comm_size);
+
+    const uint16_t stripe_counts[] = {1, 4, 16};
+    for (uint16_t num_stripes : stripe_counts) {
+        std::string name = "TEST_UNORDERED_MAP_STRIPES_" + std::to_string(num_stripes);
+        hcl::unordered_map<KeyType, size_t> *map;
+        if (is_server) {
+            map = new hcl::unordered_map<KeyType, size_t>(name, HCL_CONF->RPC_PORT, num_stripes);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            map = new hcl::unordered_map<KeyType, size_t>(name);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            /* Keys are chosen so that they all hash to target_server. */
+            auto mixed_load = [&](int target_server) {
+                for (int i = 0; i < num_keys; i++) {
+                    auto key = KeyType(target_server + (size_t)i * num_servers);
+                    size_t val = i;
+                    map->Put(key, val);
+                }
+                MPI_Barrier(client_comm);
+                Timer mixed_timer = Timer();
+                mixed_timer.resumeTime();
+                std::vector<std::thread> workers;
+                for (int t = 0; t < num_threads; t++) {
+                    workers.emplace_back([&, t]() {
+                        std::mt19937 generator(my_rank * num_threads + t);
+                        std::uniform_int_distribution<int> key_dist(0, num_keys - 1);
+                        std::uniform_int_distribution<int> op_dist(0, 9);
+                        for (int i = 0; i < num_request; i++) {
+                            auto key = KeyType(target_server + (size_t)key_dist(generator) * num_servers);
+                            if (op_dist(generator) == 0) {
+                                size_t val = i;
+                                map->Put(key, val);
+                            } else {
+                                auto result = map->Get(key);
+                                assert(result.first);
+                            }
+                        }
+                    });
+                }
+                for (auto &worker : workers) worker.join();
+                mixed_timer.pauseTime();
+                double mixed_throughput = num_request * num_threads / mixed_timer.getElapsedTime() * 1000;
+                double mixed_tp_result;
+                if (client_comm_size > 1) {
+                    MPI_Reduce(&mixed_throughput, &mixed_tp_result, 1,
+                               MPI_DOUBLE, MPI_SUM, 0, client_comm);
+                } else {
+                    mixed_tp_result = mixed_throughput;
+                }
+                return mixed_tp_result;
+            };
+            double colocated_tp_result = mixed_load(my_server);
+            MPI_Barrier(client_comm);
+            double remote_tp_result = mixed_load((my_server + 1) % num_servers);
+            if (my_rank == 0) {
+                printf("stripes %d, co-located mixed 90/10 throughput (ops/sec): %f\n", num_stripes, colocated_tp_result);
+                printf("stripes %d, remote mixed 90/10 throughput (ops/sec): %f\n", num_stripes, remote_tp_result);
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        delete(map);
+    }
+    MPI_Finalize();
+    exit(EXIT_SUCCESS);
+}
@@ -20,7 +20,10 @@
 #include <signal.h>
 #include <execinfo.h>
 #include <chrono>
+#include <vector>
+#include <future>
 #include <map>
+#include <algorithm>
 #include <hcl/common/data_structures.h>
 #include <hcl/unordered_map/unordered_map.h>
 
@@ -64,6 +67,19 @@ namespace std {
         }
     };
 }
+namespace hcl {
+    /* KeyType has a user-defined assignment, so it needs its own journal codec. */
+    template<>
+    struct journal_codec<KeyType> {
+        static const bool supported = true;
+        static void Encode(std::vector<char> &out, const KeyType &k) {
+            journal_codec<size_t>::Encode(out, k.a);
+        }
+        static bool Decode(const char *&in, const char *end, KeyType &k) {
+            return journal_codec<size_t>::Decode(in, end, k.a);
+        }
+    };
+}
 
 
 int main (int argc,char* argv[])
@@ -122,6 +138,8 @@ int main (int argc,char* argv[])
     HCL_CONF->NUM_SERVERS = num_servers;
     HCL_CONF->SERVER_ON_NODE = server_on_node || is_server;
     HCL_CONF->SERVER_LIST_PATH = "./server_list";
+    /* The keys below are chosen to be local or remote under modulo placement. */
+    HCL_CONF->PARTITIONER = MODULO_PARTITIONER;
 
     hcl::unordered_map<KeyType,std::array<int, array_size>> *map;
     if (is_server) {
@@ -266,6 +284,437 @@ int main (int argc,char* argv[])
             printf("remote map throughput (put): %f\n",remote_put_tp_result);
             printf("remote map throughput (get): %f\n",remote_get_tp_result);
         }
+
+        MPI_Barrier(client_comm);
+
+        /*Batched map test: one MultiPut/MultiGet covering keys on every server*/
+        std::vector<std::pair<KeyType, std::array<int, array_size>>> batch_entries;
+        std::vector<KeyType> batch_keys;
+        for(int i=0;i<num_request;i++){
+            auto key=KeyType((size_t)my_rank*num_request+i);
+            batch_entries.emplace_back(key, my_vals);
+            batch_keys.push_back(key);
+        }
+        Timer batch_put_timer=Timer();
+        batch_put_timer.resumeTime();
+        bool batch_put_result = map->MultiPut(batch_entries);
+        batch_put_timer.pauseTime();
+        assert(batch_put_result);
+
+        Timer batch_get_timer=Timer();
+        batch_get_timer.resumeTime();
+        auto batch_results = map->MultiGet(batch_keys);
+        batch_get_timer.pauseTime();
+        assert(batch_results.size() == batch_keys.size());
+        for(auto &result : batch_results) assert(result.first);
+
+        auto erase_results = map->MultiErase(batch_keys);
+        for(auto &result : erase_results) assert(result.first);
+
+        double batch_put_throughput=num_request/batch_put_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+        double batch_get_throughput=num_request/batch_get_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+
+        double batch_put_tp_result, batch_get_tp_result;
+        if (client_comm_size > 1) {
+            MPI_Reduce(&batch_put_throughput, &batch_put_tp_result, 1,
+                       MPI_DOUBLE, MPI_SUM, 0, client_comm);
+            batch_put_tp_result /= client_comm_size;
+            MPI_Reduce(&batch_get_throughput, &batch_get_tp_result, 1,
+                       MPI_DOUBLE, MPI_SUM, 0, client_comm);
+            batch_get_tp_result /= client_comm_size;
+        }
+        else {
+            batch_put_tp_result = batch_put_throughput;
+            batch_get_tp_result = batch_get_throughput;
+        }
+
+        if(my_rank == 0) {
+            printf("batched map throughput (put): %f\n",batch_put_tp_result);
+            printf("batched map throughput (get): %f\n",batch_get_tp_result);
+        }
+
+        MPI_Barrier(client_comm);
+
+        /*Async map test: all requests in flight before waiting on any reply*/
+        Timer async_put_timer=Timer();
+        async_put_timer.resumeTime();
+        std::vector<std::future<bool>> put_futures;
+        for(int i=0;i<num_request;i++){
+            auto key=KeyType(my_server+1);
+            put_futures.push_back(map->AsyncPut(key, my_vals));
+        }
+        for(auto &put_future : put_futures) {
+            bool put = put_future.get();
+            assert(put);
+        }
+        async_put_timer.pauseTime();
+
+        Timer async_get_timer=Timer();
+        async_get_timer.resumeTime();
+        std::vector<std::future<std::pair<bool, std::array<int, array_size>>>> get_futures;
+        for(int i=0;i<num_request;i++){
+            auto key=KeyType(my_server+1);
+            get_futures.push_back(map->AsyncGet(key));
+        }
+        for(auto &get_future : get_futures) {
+            bool got = get_future.get().first;
+            assert(got);
+        }
+        async_get_timer.pauseTime();
+
+        double async_put_throughput=num_request/async_put_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+        double async_get_throughput=num_request/async_get_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+
+        double async_put_tp_result, async_get_tp_result;
+        if (client_comm_size > 1) {
+            MPI_Reduce(&async_put_throughput, &async_put_tp_result, 1,
+                       MPI_DOUBLE, MPI_SUM, 0, client_comm);
+            async_put_tp_result /= client_comm_size;
+            MPI_Reduce(&async_get_throughput, &async_get_tp_result, 1,
+                       MPI_DOUBLE, MPI_SUM, 0, client_comm);
+            async_get_tp_result /= client_comm_size;
+        }
+        else {
+            async_put_tp_result = async_put_throughput;
+            async_get_tp_result = async_get_throughput;
+        }
+
+        if(my_rank == 0) {
+            printf("async map throughput (put): %f\n",async_put_tp_result);
+            printf("async map throughput (get): %f\n",async_get_tp_result);
+        }
+
+        MPI_Barrier(client_comm);
+
+        /*Local view test: read the value in the segment without copying it out*/
+        Timer local_view_timer=Timer();
+        long checksum=0;
+        for(int i=0;i<num_request;i++){
+            auto key=KeyType(my_server);
+            local_view_timer.resumeTime();
+            bool found = map->WithValue(key, [&checksum](const std::array<int, array_size> &value) {
+                checksum += value[0];
+            });
+            local_view_timer.pauseTime();
+            assert(found);
+        }
+        double local_view_throughput=num_request/local_view_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+
+        double local_view_tp_result;
+        if (client_comm_size > 1) {
+            MPI_Reduce(&local_view_throughput, &local_view_tp_result, 1,
+                       MPI_DOUBLE, MPI_SUM, 0, client_comm);
+            local_view_tp_result /= client_comm_size;
+        }
+        else {
+            local_view_tp_result = local_view_throughput;
+        }
+
+        if(my_rank == 0) {
+            printf("local map throughput (view): %f\n",local_view_tp_result);
+        }
+    }
+    if (my_rank == 0) {
+        /* Consistent-hash placement of identity-hashed keys: balance across
+         * 16 servers and the share of keys that move when a 17th is added. */
+        const uint16_t ring_servers = 16;
+        const size_t ring_keys = 1 << 20;
+        auto before = hcl::CreatePartitioner(CONSISTENT_HASH_PARTITIONER, ring_servers, HCL_CONF->VIRTUAL_NODES);
+        auto after = hcl::CreatePartitioner(CONSISTENT_HASH_PARTITIONER, ring_servers + 1, HCL_CONF->VIRTUAL_NODES);
+        std::vector<size_t> load(ring_servers, 0);
+        size_t moved = 0;
+        for (size_t k = 0; k < ring_keys; k++) {
+            uint16_t owner = before->GetServer(std::hash<KeyType>()(KeyType(k)));
+            uint16_t new_owner = after->GetServer(std::hash<KeyType>()(KeyType(k)));
+            load[owner]++;
+            if (new_owner != owner) {
+                assert(new_owner == ring_servers);
+                moved++;
+            }
+        }
+        size_t max_load = *std::max_element(load.begin(), load.end());
+        printf("ring placement max/mean load: %f\n", (double)max_load * ring_servers / ring_keys);
+        printf("ring placement moved on add: %f (ideal %f)\n", (double)moved / ring_keys, 1.0 / (ring_servers + 1));
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    {
+        /* Repeated remote Gets of one key through a leased client cache. */
+        typedef hcl::unordered_map<KeyType,std::array<int,array_size>> CachedMap;
+        CachedMap *cached_map;
+        if (is_server) {
+            cached_map = new CachedMap("TEST_UNORDERED_MAP_CACHED");
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            HCL_CONF->CLIENT_CACHE_SIZE = 1024;
+            cached_map = new CachedMap("TEST_UNORDERED_MAP_CACHED");
+            cached_map->server_on_node = false;
+            auto key = KeyType(my_server+1);
+            cached_map->Put(key, my_vals);
+            Timer cached_get_timer=Timer();
+            for(int i=0;i<num_request;i++){
+                cached_get_timer.resumeTime();
+                auto result = cached_map->Get(key);
+                cached_get_timer.pauseTime();
+                assert(result.first);
+            }
+            double cached_get_throughput=num_request/cached_get_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+            hcl::cache_stats stats = cached_map->CacheStats();
+            if (my_rank == 0) {
+                printf("cached map throughput (get): %f\n", cached_get_throughput);
+                printf("cached map hits %lu misses %lu\n", (unsigned long)stats.hits, (unsigned long)stats.misses);
+            }
+            assert(stats.hits > 0);
+            /* A Put waits until the leases on its key have run out, so once
+             * it returns, other clients' cached copies are stale and their
+             * next Get fetches the new value. */
+            int client_rank, clients;
+            MPI_Comm_rank(client_comm, &client_rank);
+            MPI_Comm_size(client_comm, &clients);
+            auto own_key = KeyType(num_servers + 1 + client_rank);
+            auto other_key = KeyType(num_servers + 1 + (client_rank + 1) % clients);
+            std::array<int,array_size> new_vals = my_vals;
+            new_vals[0] = my_vals[0] + 1;
+            cached_map->Put(own_key, my_vals);
+            MPI_Barrier(client_comm);
+            for(int i=0;i<2;i++){
+                auto result = cached_map->Get(other_key);
+                assert(result.first && result.second[0] == my_vals[0]);
+            }
+            MPI_Barrier(client_comm);
+            cached_map->Put(own_key, new_vals);
+            MPI_Barrier(client_comm);
+            auto updated = cached_map->Get(other_key);
+            assert(updated.first && updated.second[0] == new_vals[0]);
+            HCL_CONF->CLIENT_CACHE_SIZE = 0;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        delete(cached_map);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    {
+        /* Gets spread over two copies of every key; a copy that lags the
+         * puts sends its misses to the owner, so every key is found. */
+        typedef hcl::unordered_map<KeyType,std::array<int,array_size>> ReplicatedMap;
+        HCL_CONF->REPLICATION_FACTOR = 2;
+        ReplicatedMap *replicated_map;
+        if (is_server) {
+            replicated_map = new ReplicatedMap("TEST_UNORDERED_MAP_REPLICATED");
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            replicated_map = new ReplicatedMap("TEST_UNORDERED_MAP_REPLICATED");
+            for(int i=0;i<num_request;i++){
+                auto key=KeyType((size_t)my_rank*num_request+i);
+                replicated_map->Put(key, my_vals);
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            Timer replicated_get_timer=Timer();
+            int found=0;
+            for(int i=0;i<num_request;i++){
+                auto key=KeyType((size_t)my_rank*num_request+i);
+                replicated_get_timer.resumeTime();
+                auto result = replicated_map->Get(key);
+                replicated_get_timer.pauseTime();
+                if (result.first) found++;
+            }
+            double replicated_get_throughput=num_request/replicated_get_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+            if (my_rank == 0) {
+                printf("replicated map throughput (get): %f\n", replicated_get_throughput);
+                printf("replicated map found %d of %d\n", found, num_request);
+            }
+            assert(found == num_request);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        delete(replicated_map);
+        HCL_CONF->REPLICATION_FACTOR = 1;
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (num_servers > 1) {
+        /* The last server joins while the other clients keep putting and
+         * getting. Clients here have no server on their node, so they pick
+         * up the new membership by asking their server. */
+        typedef hcl::unordered_map<KeyType,std::array<int,array_size>> ElasticMap;
+        HCL_CONF->PARTITIONER = CONSISTENT_HASH_PARTITIONER;
+        HCL_CONF->SERVER_ON_NODE = is_server;
+        bool joining = my_server == num_servers - 1;
+        HCL_CONF->NUM_SERVERS = is_server && joining ? num_servers : num_servers - 1;
+        ElasticMap *elastic_map;
+        if (is_server) {
+            elastic_map = new ElasticMap("TEST_UNORDERED_MAP_ELASTIC");
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            elastic_map = new ElasticMap("TEST_UNORDERED_MAP_ELASTIC");
+        }
+        /* Clients of the joining server only read once it has joined. */
+        bool writer = !is_server && !joining;
+        size_t first_key = (size_t)my_rank * 2 * num_request;
+        if (writer) {
+            for(int i=0;i<num_request;i++){
+                auto key=KeyType(first_key+i);
+                bool put = elastic_map->Put(key, my_vals);
+                assert(put);
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (writer) {
+            std::future<bool> resized;
+            if (my_rank == 0) {
+                resized = std::async(std::launch::async, [elastic_map, num_servers]() {
+                    return elastic_map->Resize(num_servers);
+                });
+            }
+            for(int i=0;i<num_request;i++){
+                auto key=KeyType(first_key+i);
+                bool got = elastic_map->Get(key).first;
+                assert(got);
+                auto new_key=KeyType(first_key+num_request+i);
+                bool put = elastic_map->Put(new_key, my_vals);
+                assert(put);
+            }
+            if (my_rank == 0) {
+                bool grown = resized.get();
+                assert(grown);
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        usleep((MEMBERSHIP_POLL_MS + 100) * 1000);
+        if (!is_server) {
+            int found=0, expected=0;
+            for(int rank=0;rank<comm_size;rank++){
+                bool rank_is_server = (rank+1) % ranks_per_server == 0;
+                if (rank_is_server || rank / ranks_per_server == num_servers - 1) continue;
+                for(int i=0;i<2*num_request;i++){
+                    auto key=KeyType((size_t)rank*2*num_request+i);
+                    if (elastic_map->Get(key).first) found++;
+                    expected++;
+                }
+            }
+            if (my_rank == 0) {
+                printf("elastic map found %d of %d after growing to %d servers\n", found, expected, num_servers);
+            }
+            assert(found == expected);
+            assert(elastic_map->Membership().num_servers == num_servers);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        delete(elastic_map);
+        HCL_CONF->NUM_SERVERS = num_servers;
+        HCL_CONF->SERVER_ON_NODE = server_on_node || is_server;
+        HCL_CONF->PARTITIONER = MODULO_PARTITIONER;
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    {
+        /* Checkpoint, restart the servers and read the data back without re-inserting it. */
+        typedef hcl::unordered_map<KeyType,std::array<int,array_size>> PersistentMap;
+        std::string persistent_name = "TEST_UNORDERED_MAP_PERSISTENT";
+        HCL_CONF->PERSISTENT = true;
+        PersistentMap *persistent_map;
+        if (is_server) {
+            persistent_map = new PersistentMap(persistent_name);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            persistent_map = new PersistentMap(persistent_name);
+            for(int i=0;i<num_request;i++){
+                auto key=KeyType((size_t)my_rank*num_request+i);
+                persistent_map->Put(key, my_vals);
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        Timer checkpoint_timer=Timer();
+        if (is_server && my_server == 0) {
+            checkpoint_timer.resumeTime();
+            bool written = persistent_map->Checkpoint();
+            checkpoint_timer.pauseTime();
+            assert(written);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        delete(persistent_map);
+        MPI_Barrier(MPI_COMM_WORLD);
+        Timer reopen_timer=Timer();
+        if (is_server) {
+            reopen_timer.resumeTime();
+            persistent_map = new PersistentMap(persistent_name);
+            reopen_timer.pauseTime();
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            persistent_map = new PersistentMap(persistent_name);
+            int found=0;
+            for(int i=0;i<num_request;i++){
+                auto key=KeyType((size_t)my_rank*num_request+i);
+                if (persistent_map->Get(key).first) found++;
+            }
+            assert(found == num_request);
+        }
+        if (is_server && my_server == 0) {
+            printf("persistent map checkpoint (ms): %f\n", checkpoint_timer.getElapsedTime());
+            printf("persistent map reopen (ms): %f\n", reopen_timer.getElapsedTime());
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        delete(persistent_map);
+        HCL_CONF->PERSISTENT = false;
+        if (is_server) {
+            boost::interprocess::file_mapping::remove((HCL_CONF->BACKED_FILE_DIR + "/" + persistent_name + "_" +
+                                                       std::to_string(my_server)).c_str());
+        }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    {
+        /* Journal every update, restart the servers and recover the data from the journal alone. */
+        typedef hcl::unordered_map<KeyType,std::array<int,array_size>> JournaledMap;
+        std::string journaled_name = "TEST_UNORDERED_MAP_JOURNALED";
+        HCL_CONF->JOURNAL_DIR = HCL_CONF->BACKED_FILE_DIR;
+        JournaledMap *journaled_map;
+        if (is_server) {
+            journaled_map = new JournaledMap(journaled_name);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            journaled_map = new JournaledMap(journaled_name);
+            Timer journaled_put_timer=Timer();
+            for(int i=0;i<num_request;i++){
+                auto key=KeyType((size_t)my_rank*num_request+i);
+                journaled_put_timer.resumeTime();
+                journaled_map->Put(key, my_vals);
+                journaled_put_timer.pauseTime();
+            }
+            double journaled_put_throughput=num_request/journaled_put_timer.getElapsedTime()*1000*size_of_elem*my_vals.size()/1024/1024;
+            if (my_rank == 0) {
+                printf("journaled map throughput (put): %f\n", journaled_put_throughput);
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        delete(journaled_map);
+        MPI_Barrier(MPI_COMM_WORLD);
+        Timer replay_timer=Timer();
+        if (is_server) {
+            replay_timer.resumeTime();
+            journaled_map = new JournaledMap(journaled_name);
+            replay_timer.pauseTime();
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (!is_server) {
+            journaled_map = new JournaledMap(journaled_name);
+            int found=0;
+            for(int i=0;i<num_request;i++){
+                auto key=KeyType((size_t)my_rank*num_request+i);
+                if (journaled_map->Get(key).first) found++;
+            }
+            assert(found == num_request);
+        }
+        if (is_server && my_server == 0) {
+            printf("journaled map replay (ms): %f\n", replay_timer.getElapsedTime());
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        delete(journaled_map);
+        if (is_server) {
+            remove((HCL_CONF->JOURNAL_DIR + "/" + journaled_name + "_" + std::to_string(my_server) + ".journal").c_str());
+        }
+        HCL_CONF->JOURNAL_DIR = "";
     }
     MPI_Barrier(MPI_COMM_WORLD);
     delete(map);